@@ -0,0 +1,554 @@
+/**********************************************************************/
+/** benchmark.cpp by Alex Koukoulas (C) 2017 All Rights Reserved     **/
+/** File Description: Implementation of the Ray tracing benchmarks   **/
+/**********************************************************************/
+
+// Local Headers
+#include "benchmark.h"
+#include "raytracer.h"
+#include "image.h"
+#include "threadpool.h"
+#include "spherekernels.h"
+#include "perfcounters.h"
+#include "bvh.h"
+#include "scene.h"
+#include "scenegenerator.h"
+#include "strutils.h"
+
+// Remote Headers
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchmarkTimings
+{
+    std::vector<f64> elapsedMs;
+    uint64 rayCount;
+    uint32 threadCount;
+};
+
+static bool imagesEqual(const Image& a, const Image& b)
+{
+    if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight()) return false;
+
+    for (auto y = 0; y < a.getHeight(); ++y)
+    {
+        if (memcmp(a[y], b[y], a.getWidth() * sizeof(vec3<f32>)) != 0) return false;
+    }
+    return true;
+}
+
+static void printTimings(const char* name, BenchmarkTimings& timings, std::ostream& output)
+{
+    std::sort(timings.elapsedMs.begin(), timings.elapsedMs.end());
+    const auto bestMs = timings.elapsedMs.front();
+    const auto medianMs = timings.elapsedMs[timings.elapsedMs.size() / 2];
+
+    output << name << ": best " << bestMs << " ms | median " << medianMs << " ms | "
+           << timings.rayCount / (bestMs / 1000.0) / 1e6 << " Mrays/s | " 
+           << bestMs * 1e6 * timings.threadCount / timings.rayCount << " ns/ray" << std::endl;
+}
+
+// Renders the current scene alternately with the baseline and the candidate options, and
+// reports how much faster the candidate is
+static bool compareRenders(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, 
+                           const char* baselineName, const RenderOptions& baselineOptions,
+                           const char* candidateName, const RenderOptions& candidateOptions, std::ostream& output)
+{
+    const auto renderStopFlag = false;
+
+    Image candidateImage(width, height);
+    Image baselineImage(width, height);
+    BenchmarkTimings candidateTimings = {};
+    BenchmarkTimings baselineTimings = {};
+
+    // An untimed warm up render, which also builds the BVH
+    renderImage(candidateImage, threadPool, renderStopFlag, nullptr, nullptr, 1, candidateOptions);
+
+    for (auto i = 0U; i < repetitions; ++i)
+    {
+        const auto candidateStats = renderImage(candidateImage, threadPool, renderStopFlag, nullptr, nullptr, 1, candidateOptions);
+        candidateTimings.elapsedMs.push_back(candidateStats.elapsedMs);
+        candidateTimings.rayCount = candidateStats.rayCount;
+        candidateTimings.threadCount = candidateStats.threadCount;
+
+        const auto baselineStats = renderImage(baselineImage, threadPool, renderStopFlag, nullptr, nullptr, 1, baselineOptions);
+        baselineTimings.elapsedMs.push_back(baselineStats.elapsedMs);
+        baselineTimings.rayCount = baselineStats.rayCount;
+        baselineTimings.threadCount = baselineStats.threadCount;
+    }
+
+    printTimings(baselineName, baselineTimings, output);
+    printTimings(candidateName, candidateTimings, output);
+    output << "Speedup: " << baselineTimings.elapsedMs.front() / candidateTimings.elapsedMs.front() << "x (best), "
+           << baselineTimings.elapsedMs[repetitions / 2] / candidateTimings.elapsedMs[repetitions / 2] << "x (median)" << std::endl;
+
+    const auto identical = imagesEqual(candidateImage, baselineImage) && candidateTimings.rayCount == baselineTimings.rayCount;
+    output << (identical ? "Images and ray counts are identical" : "Error: Images or ray counts differ") << std::endl;
+    return identical;
+}
+
+bool runPacketBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, std::ostream& output)
+{
+    RenderOptions packetOptions;
+    packetOptions.packetTracing = true;
+    RenderOptions singleRayOptions;
+    singleRayOptions.packetTracing = false;
+
+    output << "Packet benchmark at " << width << " x " << height << ", " << repetitions << " repetition(s), "
+           << threadPool.getThreadCount() << " worker(s), " << getSimdLevelName(getSimdLevel()) << " sphere kernels"
+           << (isPacketTracingSupported() ? "" : " (packets unsupported, single rays are traced instead)") << std::endl;
+
+    return compareRenders(threadPool, width, height, repetitions, "Single rays", singleRayOptions, "Packets    ", packetOptions, output);
+}
+
+bool runWavefrontBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, std::ostream& output)
+{
+    RenderOptions packetOptions;
+    packetOptions.packetTracing = true;
+    RenderOptions wavefrontOptions;
+    wavefrontOptions.packetTracing = true;
+    wavefrontOptions.wavefront = true;
+
+    output << "Wavefront benchmark at " << width << " x " << height << ", " << repetitions << " repetition(s), "
+           << threadPool.getThreadCount() << " worker(s), " << getSimdLevelName(getSimdLevel()) << " sphere kernels"
+           << (isPacketTracingSupported() ? "" : " (packets unsupported, single rays are traced instead)") << std::endl;
+
+    return compareRenders(threadPool, width, height, repetitions, "Packets  ", packetOptions, "Wavefront", wavefrontOptions, output);
+}
+
+bool runTileOrderBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, const RenderOptions& options, std::ostream& output)
+{
+    const auto renderStopFlag = false;
+    CacheMissCounters cacheMissCounters(threadPool);
+
+    output << "Tile order benchmark at " << width << " x " << height << ", " << repetitions << " repetition(s), "
+           << threadPool.getThreadCount() << " worker(s), " << options.tileSize << " pixel tiles, "
+           << (options.wavefront ? "wavefront " : "") << (options.packetTracing && isPacketTracingSupported() ? "packet" : "single ray") << " tracing"
+           << (cacheMissCounters.isAvailable() ? "" : " (cache miss counters unavailable)") << std::endl;
+
+    std::vector<Image> images;
+    std::vector<BenchmarkTimings> timings(TILE_ORDER_COUNT);
+    std::vector<CacheMisses> cacheMisses(TILE_ORDER_COUNT);
+    std::vector<RenderOptions> orderOptions(TILE_ORDER_COUNT, options);
+    for (auto order = 0U; order < TILE_ORDER_COUNT; ++order)
+    {
+        images.emplace_back(width, height);
+        orderOptions[order].tileOrder = static_cast<TileOrder>(order);
+        cacheMisses[order] = CacheMisses();
+    }
+
+    // An untimed warm up render, which also builds the BVH
+    renderImage(images[0], threadPool, renderStopFlag, nullptr, nullptr, 1, options);
+
+    for (auto i = 0U; i < repetitions; ++i)
+    {
+        for (auto order = 0U; order < TILE_ORDER_COUNT; ++order)
+        {
+            cacheMissCounters.reset();
+            const auto stats = renderImage(images[order], threadPool, renderStopFlag, nullptr, nullptr, 1, orderOptions[order]);
+            const auto misses = cacheMissCounters.read();
+
+            timings[order].elapsedMs.push_back(stats.elapsedMs);
+            timings[order].rayCount = stats.rayCount;
+            timings[order].threadCount = stats.threadCount;
+            cacheMisses[order].l1dReadMisses += misses.l1dReadMisses;
+            cacheMisses[order].lastLevelMisses += misses.lastLevelMisses;
+        }
+    }
+
+    auto identical = true;
+    for (auto order = 0U; order < TILE_ORDER_COUNT; ++order)
+    {
+        const auto name = getTileOrderName(static_cast<TileOrder>(order));
+        printTimings(name, timings[order], output);
+
+        if (cacheMissCounters.isAvailable())
+        {
+            const auto tracedRays = static_cast<f64>(timings[order].rayCount) * repetitions;
+            output << "  L1D read misses " << cacheMisses[order].l1dReadMisses / tracedRays << " / ray | last level misses "
+                   << cacheMisses[order].lastLevelMisses / tracedRays << " / ray" << std::endl;
+        }
+
+        if (order > 0)
+        {
+            output << "  Speedup over " << getTileOrderName(TILE_ORDER_SCANLINE) << ": " << timings[0].elapsedMs.front() / timings[order].elapsedMs.front() << "x (best), "
+                   << timings[0].elapsedMs[repetitions / 2] / timings[order].elapsedMs[repetitions / 2] << "x (median)" << std::endl;
+            identical &= imagesEqual(images[0], images[order]) && timings[0].rayCount == timings[order].rayCount;
+        }
+    }
+
+    output << (identical ? "Images and ray counts are identical" : "Error: Images or ray counts differ") << std::endl;
+    return identical;
+}
+
+// Whether both trees have the same structure, bounds and sphere order. Their nodes may be laid out
+// differently, as the subtrees of parallel builds are stored in the order they are deferred in.
+static bool bvhsEqual(const BVH& a, const BVH& b)
+{
+    if (a.getNodeCount() != b.getNodeCount() || a.getSphereCount() != b.getSphereCount() ||
+        memcmp(a.getSphereIndices(), b.getSphereIndices(), a.getSphereCount() * sizeof(uint32)) != 0)
+    {
+        return false;
+    }
+
+    if (a.getNodeCount() == 0) return true;
+
+    const auto* nodesA = a.getNodes();
+    const auto* nodesB = b.getNodes();
+    std::vector<std::pair<uint32, uint32>> pairs;
+    pairs.push_back(std::make_pair(0U, 0U));
+    while (!pairs.empty())
+    {
+        const auto& nodeA = nodesA[pairs.back().first];
+        const auto& nodeB = nodesB[pairs.back().second];
+        pairs.pop_back();
+
+        if (memcmp(&nodeA.boundsMin, &nodeB.boundsMin, sizeof(nodeA.boundsMin)) != 0 ||
+            memcmp(&nodeA.boundsMax, &nodeB.boundsMax, sizeof(nodeA.boundsMax)) != 0 ||
+            nodeA.primCount != nodeB.primCount)
+        {
+            return false;
+        }
+
+        if (nodeA.isLeaf())
+        {
+            if (nodeA.leftFirst != nodeB.leftFirst) return false;
+            continue;
+        }
+
+        pairs.push_back(std::make_pair(nodeA.leftFirst, nodeB.leftFirst));
+        pairs.push_back(std::make_pair(nodeA.leftFirst + 1, nodeB.leftFirst + 1));
+    }
+    return true;
+}
+
+bool runBVHBenchmark(const uint32 maxThreadCount, const uint32 repetitions, std::ostream& output)
+{
+    const auto snapshot = Scene::get().getSnapshot();
+    const auto& spheres = snapshot->getSpheres();
+
+    std::vector<uint32> threadCounts;
+    for (auto threadCount = 1U; threadCount < maxThreadCount; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreadCount);
+
+    output << "BVH benchmark over " << spheres.size() << " sphere(s), " << repetitions << " repetition(s), up to " 
+           << maxThreadCount << " worker(s)" << std::endl;
+
+    auto identical = true;
+    for (auto builder = 0U; builder < BVH_BUILDER_COUNT; ++builder)
+    {
+        const auto bvhBuilder = static_cast<BVHBuilder>(builder);
+        output << getBVHBuilderName(bvhBuilder) << ":" << std::endl;
+
+        BVH referenceBVH;
+        auto singleWorkerMs = 0.0;
+        for (const auto threadCount: threadCounts)
+        {
+            ThreadPool threadPool(threadCount);
+            BVH bvh;
+            std::vector<f64> elapsedMs;
+            for (auto i = 0U; i < repetitions; ++i)
+            {
+                const auto buildStart = std::chrono::steady_clock::now();
+                bvh.build(spheres, bvhBuilder, &threadPool);
+                elapsedMs.push_back(std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - buildStart).count());
+            }
+
+            std::sort(elapsedMs.begin(), elapsedMs.end());
+            const auto bestMs = elapsedMs.front();
+            if (threadCount == 1)
+            {
+                singleWorkerMs = bestMs;
+                referenceBVH = bvh;
+            }
+
+            const auto sameTree = bvhsEqual(bvh, referenceBVH);
+            identical &= sameTree;
+
+            const auto speedup = bestMs > 0.0 ? singleWorkerMs / bestMs : 0.0;
+            output << "  " << threadCount << " worker(s): best " << bestMs << " ms | median " << elapsedMs[elapsedMs.size() / 2] << " ms | "
+                   << bvh.getNodeCount() << " nodes | SAH cost " << bvh.getSAHCost() << " | speedup " << speedup << "x, efficiency " 
+                   << 100.0 * speedup / threadCount << "%" << (sameTree ? "" : " | Error: the tree differs from the single worker one") << std::endl;
+        }
+    }
+
+    output << (identical ? "Trees are identical for every worker count" : "Error: Trees differ across worker counts") << std::endl;
+    return identical;
+}
+
+bool runEditBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, const RenderOptions& options, std::ostream& output)
+{
+    const auto renderStopFlag = false;
+    auto& scene = Scene::get();
+    const auto sphereCount = scene.getSphereCount();
+    if (sphereCount == 0)
+    {
+        output << "Error: The scene has no spheres to edit" << std::endl;
+        return false;
+    }
+
+    output << "Edit benchmark at " << width << " x " << height << ", " << repetitions << " edit(s) of a single sphere out of "
+           << sphereCount << ", " << threadPool.getThreadCount() << " worker(s), " << getBVHBuilderName(options.bvhBuilder) << " BVH" << std::endl;
+
+    Image image(width, height);
+
+    // What every edit would cost without refitting
+    std::vector<f64> rebuildMs;
+    for (auto i = 0U; i < repetitions; ++i)
+    {
+        BVH bvh;
+        const auto buildStart = std::chrono::steady_clock::now();
+        bvh.build(scene.getSnapshot()->getSpheres(), options.bvhBuilder, &threadPool);
+        rebuildMs.push_back(std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - buildStart).count());
+    }
+    std::sort(rebuildMs.begin(), rebuildMs.end());
+
+    // An untimed warm up render, which also builds the BVH the edits are refit from
+    const auto builtSAHCost = renderImage(image, threadPool, renderStopFlag, nullptr, nullptr, 1, options).bvhSAHCost;
+
+    // Drags a sphere in the middle of the scene along x, a slider step at a time
+    const auto sphereIndex = sphereCount / 2;
+    BenchmarkTimings editTimings = {};
+    BenchmarkTimings bvhTimings = {};
+    BenchmarkTimings compileTimings = {};
+    BenchmarkTimings renderTimings = {};
+    f32 sahCost = builtSAHCost;
+    for (auto i = 0U; i < repetitions; ++i)
+    {
+        const auto editStart = std::chrono::steady_clock::now();
+        scene.editSphere(sphereIndex, [](Sphere& sphere) { sphere.center.x += 0.2f; });
+        editTimings.elapsedMs.push_back(std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - editStart).count());
+
+        const auto stats = renderImage(image, threadPool, renderStopFlag, nullptr, nullptr, 1, options);
+        bvhTimings.elapsedMs.push_back(stats.bvhBuildMs);
+        compileTimings.elapsedMs.push_back(stats.sceneCompileMs);
+        renderTimings.elapsedMs.push_back(stats.elapsedMs);
+        sahCost = stats.bvhSAHCost;
+    }
+
+    const auto printEditTimings = [repetitions, &output](const char* name, BenchmarkTimings& timings)
+    {
+        std::sort(timings.elapsedMs.begin(), timings.elapsedMs.end());
+        output << name << ": best " << timings.elapsedMs.front() << " ms | median " << timings.elapsedMs[repetitions / 2] << " ms" << std::endl;
+    };
+
+    output << "BVH rebuild   : best " << rebuildMs.front() << " ms | median " << rebuildMs[repetitions / 2] << " ms" << std::endl;
+    printEditTimings("Sphere edit   ", editTimings);
+    printEditTimings("BVH update    ", bvhTimings);
+    printEditTimings("Scene compile ", compileTimings);
+    printEditTimings("Render        ", renderTimings);
+    output << "SAH cost " << builtSAHCost << " after the build, " << sahCost << " after the last edit" << std::endl;
+
+    // The refit BVH has to find the same hits as a freshly built one, which a builder
+    // that hasn't built a BVH over any snapshot yet (and hence has nothing to refit) provides
+    auto builtOptions = options;
+    builtOptions.bvhBuilder = options.bvhBuilder == BVH_BUILDER_SWEEP_SAH ? BVH_BUILDER_BINNED_SAH : BVH_BUILDER_SWEEP_SAH;
+    Image builtImage(width, height);
+    renderImage(builtImage, threadPool, renderStopFlag, nullptr, nullptr, 1, builtOptions);
+
+    const auto identical = imagesEqual(image, builtImage);
+    output << (identical ? "Images are identical to ones rendered with a rebuilt BVH" : "Error: Images differ from ones rendered with a rebuilt BVH") << std::endl;
+    return identical;
+}
+
+struct SceneBenchmarkRun
+{
+    std::string sceneName;
+    size_t sphereCount;
+    sint32 width, height;
+    uint32 threadCount;
+    f64 bestMs;
+    f64 medianMs;
+    RenderStats stats;
+    uint64 peakResidentSetSize;
+    f64 scalingEfficiency;
+};
+
+static bool writeSceneBenchmarkJson(const std::string& jsonFilePath, const uint32 repetitions, const RenderOptions& options, const std::vector<SceneBenchmarkRun>& runs)
+{
+    std::ofstream file(jsonFilePath);
+    if (!file) return false;
+
+    file << std::setprecision(12);
+    file << "{\n"
+         << "  \"suite\": \"scenes\",\n"
+         << "  \"repetitions\": " << repetitions << ",\n"
+         << "  \"hardwareThreads\": " << getDefaultThreadCount() << ",\n"
+         << "  \"sphereKernels\": " << strutils::toJsonString(getSimdLevelName(getSimdLevel())) << ",\n"
+         << "  \"packetTracing\": " << (options.packetTracing && isPacketTracingSupported() ? "true" : "false") << ",\n"
+         << "  \"wavefront\": " << (options.wavefront ? "true" : "false") << ",\n"
+         << "  \"tileSize\": " << options.tileSize << ",\n"
+         << "  \"tileOrder\": " << strutils::toJsonString(getTileOrderName(options.tileOrder)) << ",\n"
+         << "  \"bvhBuilder\": " << strutils::toJsonString(getBVHBuilderName(options.bvhBuilder)) << ",\n"
+         << "  \"runs\": [\n";
+
+    for (auto i = 0U; i < runs.size(); ++i)
+    {
+        const auto& run = runs[i];
+        file << "    { \"scene\": " << strutils::toJsonString(run.sceneName)
+             << ", \"spheres\": " << run.sphereCount
+             << ", \"width\": " << run.width
+             << ", \"height\": " << run.height
+             << ", \"threads\": " << run.threadCount
+             << ", \"bestMs\": " << run.bestMs
+             << ", \"medianMs\": " << run.medianMs
+             << ", \"raysPerSecond\": " << run.stats.rayCount / (run.bestMs / 1000.0)
+             << ", \"rays\": " << run.stats.rayCount
+             << ", \"primaryRays\": " << run.stats.primaryRayCount
+             << ", \"secondaryRays\": " << run.stats.secondaryRayCount
+             << ", \"shadowRays\": " << run.stats.shadowRayCount
+             << ", \"peakRssBytes\": " << run.peakResidentSetSize
+             << ", \"scalingEfficiency\": " << run.scalingEfficiency
+             << " }" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+bool runSceneBenchmark(const std::vector<std::string>& sceneFilePaths, const uint32 maxThreadCount, const sint32 width, const sint32 height, const uint32 repetitions,
+                       const RenderOptions& options, const uint64 seed, const std::string& jsonFilePath, std::ostream& output)
+{
+    const auto renderStopFlag = false;
+
+    // The given scenes, followed by generated ones of growing sphere counts and then of growing depths
+    std::vector<std::pair<std::string, std::function<bool()>>> scenes;
+    for (const auto& sceneFilePath: sceneFilePaths)
+    {
+        scenes.push_back(std::make_pair(sceneFilePath, [sceneFilePath]() { return Scene::get().loadFromFile(sceneFilePath); }));
+    }
+
+    // Sphere count, reflection and refraction depth and distribution of every generated scene
+    struct GeneratedScene
+    {
+        uint32 sphereCount;
+        uint32 depth;
+        SceneDistribution distribution;
+    };
+
+    const GeneratedScene generatedScenes[] =
+    {
+        { 1000, 2, SCENE_DISTRIBUTION_UNIFORM },
+        { 10000, 2, SCENE_DISTRIBUTION_UNIFORM },
+        { 100000, 2, SCENE_DISTRIBUTION_UNIFORM },
+        { 10000, 0, SCENE_DISTRIBUTION_UNIFORM },
+        { 10000, 6, SCENE_DISTRIBUTION_UNIFORM },
+        { 10000, 2, SCENE_DISTRIBUTION_CLUSTERED },
+        { 1000, 2, SCENE_DISTRIBUTION_OVERLAPPING },
+        { 10000, 2, SCENE_DISTRIBUTION_THIN }
+    };
+
+    for (const auto& generatedScene: generatedScenes)
+    {
+        SceneGeneratorSettings settings;
+        settings.distribution = generatedScene.distribution;
+        settings.sphereCount = generatedScene.sphereCount;
+        settings.reflectionCount = generatedScene.depth;
+        settings.refractionCount = generatedScene.depth;
+        settings.seed = seed;
+
+        const auto name = std::string("generated ") + getSceneDistributionName(settings.distribution) + " " + std::to_string(settings.sphereCount) + " spheres, depth " + std::to_string(generatedScene.depth);
+        scenes.push_back(std::make_pair(name, [settings]()
+        {
+            Scene::get().constructFromContents(generateScene(settings));
+            return true;
+        }));
+    }
+
+    // The given resolution, along with its half and its quarter
+    std::vector<std::pair<sint32, sint32>> resolutions;
+    for (auto divisor = 4; divisor >= 1; divisor /= 2)
+    {
+        if (width / divisor > 0 && height / divisor > 0) resolutions.push_back(std::make_pair(width / divisor, height / divisor));
+    }
+
+    std::vector<uint32> threadCounts;
+    for (auto threadCount = 1U; threadCount < maxThreadCount; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreadCount);
+
+    output << "Scene benchmark of " << scenes.size() << " scene(s), " << repetitions << " repetition(s), up to " << maxThreadCount << " worker(s), "
+           << (options.wavefront ? "wavefront " : "") << (options.packetTracing && isPacketTracingSupported() ? "packet" : "single ray") << " tracing, "
+           << getBVHBuilderName(options.bvhBuilder) << " BVH" << std::endl;
+
+    std::vector<SceneBenchmarkRun> runs;
+    auto loaded = true;
+    for (const auto& scene: scenes)
+    {
+        if (!scene.second())
+        {
+            output << "Error: Could not load scene " << scene.first << std::endl;
+            loaded = false;
+            continue;
+        }
+
+        // Peaks cover the scene from its load onwards, where they can be reset (otherwise the whole run so far)
+        resetPeakResidentSetSize();
+        const auto sphereCount = Scene::get().getSphereCount();
+        output << scene.first << " (" << sphereCount << " sphere(s)):" << std::endl;
+
+        for (const auto& resolution: resolutions)
+        {
+            Image image(resolution.first, resolution.second);
+            auto singleWorkerMs = 0.0;
+            for (const auto threadCount: threadCounts)
+            {
+                ThreadPool threadPool(threadCount);
+
+                // An untimed warm up render, which also builds the BVH
+                renderImage(image, threadPool, renderStopFlag, nullptr, nullptr, 1, options);
+
+                SceneBenchmarkRun run;
+                std::vector<f64> elapsedMs;
+                for (auto i = 0U; i < repetitions; ++i)
+                {
+                    run.stats = renderImage(image, threadPool, renderStopFlag, nullptr, nullptr, 1, options);
+                    elapsedMs.push_back(run.stats.elapsedMs);
+                }
+
+                std::sort(elapsedMs.begin(), elapsedMs.end());
+                run.sceneName = scene.first;
+                run.sphereCount = sphereCount;
+                run.width = resolution.first;
+                run.height = resolution.second;
+                run.threadCount = threadCount;
+                run.bestMs = elapsedMs.front();
+                run.medianMs = elapsedMs[elapsedMs.size() / 2];
+                run.peakResidentSetSize = getPeakResidentSetSize();
+
+                // Strong scaling, i.e. the same render spread over more workers
+                if (threadCount == 1) singleWorkerMs = run.bestMs;
+                run.scalingEfficiency = singleWorkerMs / (run.bestMs * threadCount);
+
+                output << "  " << run.width << " x " << run.height << ", " << threadCount << " worker(s): best " << run.bestMs << " ms | median " << run.medianMs << " ms | "
+                       << run.stats.rayCount / (run.bestMs / 1000.0) / 1e6 << " Mrays/s | " << run.stats.primaryRayCount << " primary, "
+                       << run.stats.secondaryRayCount << " secondary, " << run.stats.shadowRayCount << " shadow rays | peak RSS "
+                       << run.peakResidentSetSize / (1024.0 * 1024.0) << " MB | efficiency " << 100.0 * run.scalingEfficiency << "%" << std::endl;
+                runs.push_back(run);
+            }
+        }
+    }
+
+    if (jsonFilePath.empty()) return loaded;
+
+    if (!writeSceneBenchmarkJson(jsonFilePath, repetitions, options, runs))
+    {
+        output << "Error: Could not write " << jsonFilePath << std::endl;
+        return false;
+    }
+
+    output << "Results written to " << jsonFilePath << std::endl;
+    return loaded;
+}
@@ -0,0 +1,56 @@
+/**********************************************************************/
+/** benchmark.h by Alex Koukoulas (C) 2017 All Rights Reserved       **/
+/** File Description: Interface to the benchmarks comparing the      **/
+/** alternative Ray tracing paths against each other                 **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "raytracer.h"
+
+// Remote Headers
+#include <ostream>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Renders the current scene repeatedly with packet tracing and with single ray tracing,
+// alternating between the two so that both are equally affected by any background noise.
+// Reports the best and median render time, throughput and ns/ray of each, and checks
+// that both produce identical images. Returns false if they don't.
+bool runPacketBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, std::ostream& output);
+
+// Renders the current scene repeatedly as a wavefront and with packet tracing, in the same
+// way and with the same checks as runPacketBenchmark.
+bool runWavefrontBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, std::ostream& output);
+
+// Renders the current scene repeatedly in every tile order, otherwise with the given options,
+// alternating between the orders. Reports the render times and, where the hardware counters
+// are available, the L1D and last level cache misses per ray of each, and checks that every
+// order produces the same image. Returns false if they don't.
+bool runTileOrderBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, const RenderOptions& options, std::ostream& output);
+
+// Builds the BVH over the current scene's spheres repeatedly with every builder, on pools of
+// 1, 2, 4 ... up to maxThreadCount workers. Reports the best and median build time, the SAH
+// cost and the scaling efficiency of each, and checks that every worker count builds
+// the same tree. Returns false if any doesn't.
+bool runBVHBenchmark(const uint32 maxThreadCount, const uint32 repetitions, std::ostream& output);
+
+// Drags a sphere of the current scene around, a step per repetition, rendering the scene with
+// the given options after every step, as the sphere edit dialog's sliders do. Reports the time
+// each edit spends on the edit itself, refitting the BVH, compiling the scene and rendering, against
+// rebuilding the BVH, and checks that the final image matches one rendered with a freshly built
+// BVH. Returns false if it doesn't.
+bool runEditBenchmark(ThreadPool& threadPool, const sint32 width, const sint32 height, const uint32 repetitions, const RenderOptions& options, std::ostream& output);
+
+// Renders every given scene file, followed by generated scenes (from the given seed) of 10^3 up to
+// 10^5 spheres, of reflection and refraction depths 0 up to 6 and of the clustered, overlapping and
+// thin distributions, with the given options. Each scene is rendered at the given resolution, its
+// half and its quarter, on pools of 1, 2, 4 ... up to maxThreadCount workers. Reports the best and
+// median render time, throughput, primary, secondary and shadow ray counts, peak resident set size
+// and strong scaling efficiency of each, and writes them as JSON to jsonFilePath too, unless empty. Returns false if a scene or the JSON couldn't be written.
+bool runSceneBenchmark(const std::vector<std::string>& sceneFilePaths, const uint32 maxThreadCount, const sint32 width, const sint32 height, const uint32 repetitions,
+                       const RenderOptions& options, const uint64 seed, const std::string& jsonFilePath, std::ostream& output);
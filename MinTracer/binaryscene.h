@@ -0,0 +1,69 @@
+/**********************************************************************/
+/** binaryscene.h by Alex Koukoulas (C) 2017 All Rights Reserved     **/
+/** File Description: Layout of the versioned binary scene format    **/
+/** (.scnb), loadable by memory mapping the file                     **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "bvh.h"
+
+// Remote Headers
+#include <string>
+#include <type_traits>
+
+// The file starts with a BinarySceneHeader, followed by packed arrays of
+// materials, lights, spheres and planes, and optionally the BVH nodes and
+// BVH ordered sphere indices. Every array starts on a cache line aligned
+// offset, so it can be used in place once the file is mapped.
+// Everything is stored in the (little endian) in-memory layout.
+const char BINARY_SCENE_MAGIC[4] = { 'M', 'T', 'S', 'B' };
+const uint32 BINARY_SCENE_VERSION = 1;
+const uint32 BINARY_SCENE_SECTION_ALIGNMENT = 64;
+const std::string BINARY_SCENE_EXTENSION = ".scnb";
+
+// Header flags
+const uint32 BINARY_SCENE_HAS_BVH = 1 << 0;
+
+enum BinarySceneSection
+{
+    MATERIAL_SECTION, LIGHT_SECTION, SPHERE_SECTION, PLANE_SECTION, BVH_NODE_SECTION, BVH_SPHERE_INDEX_SECTION, SECTION_COUNT
+};
+
+struct BinarySceneHeader
+{
+    char magic[4];
+    uint32 version;
+    uint32 flags;
+    uint32 reflectionCount;
+    uint32 refractionCount;
+    f32 fresnelPower;
+    uint64 sectionOffsets[SECTION_COUNT];
+    uint64 sectionCounts[SECTION_COUNT];
+};
+
+// Lights are polymorphic in memory, so they are flattened on disk
+struct BinaryLight
+{
+    vec3<f32> position;
+    vec3<f32> color;
+    f32 radius;
+    uint32 lightType;
+};
+
+static_assert(std::is_trivially_copyable<Material>::value && sizeof(Material) == 48, "Unexpected Material layout");
+static_assert(std::is_trivially_copyable<Sphere>::value && sizeof(Sphere) == 20, "Unexpected Sphere layout");
+static_assert(std::is_trivially_copyable<Plane>::value && sizeof(Plane) == 20, "Unexpected Plane layout");
+static_assert(std::is_trivially_copyable<BVHNode>::value && sizeof(BVHNode) == 32, "Unexpected BVHNode layout");
+static_assert(sizeof(BinaryLight) == 32, "Unexpected BinaryLight layout");
+
+// Checks whether a file path has the binary scene extension
+inline bool hasBinarySceneExtension(const std::string& filePath)
+{
+    return filePath.size() >= BINARY_SCENE_EXTENSION.size() &&
+           filePath.compare(filePath.size() - BINARY_SCENE_EXTENSION.size(), BINARY_SCENE_EXTENSION.size(), BINARY_SCENE_EXTENSION) == 0;
+}
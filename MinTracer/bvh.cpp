@@ -0,0 +1,974 @@
+/**********************************************************************/
+/** bvh.cpp by Alex Koukoulas (C) 2017 All Rights Reserved           **/
+/** File Description: Implementation of the parallel BVH builders    **/
+/**********************************************************************/
+
+// Local Headers
+#include "bvh.h"
+#include "threadpool.h"
+
+// Remote Headers
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+// Relative costs of traversing a node and intersecting a primitive, used by the SAH
+static const f32 TRAVERSAL_COST = 1.0f;
+static const f32 INTERSECTION_COST = 1.0f;
+
+// Spheres are intersected in SIMD blocks of (at least) this many, so the SAH costs a
+// leaf by its number of blocks, i.e. a leaf of 4 spheres costs as much as one of 1
+static const uint32 INTERSECTION_BLOCK_SIZE = 4;
+
+static inline f32 getIntersectionCost(const uint32 primCount)
+{
+    return ((primCount + INTERSECTION_BLOCK_SIZE - 1) / INTERSECTION_BLOCK_SIZE) * INTERSECTION_COST;
+}
+
+// Leaves are never larger than this, regardless of what the SAH suggests
+static const uint32 MAX_LEAF_SIZE = 8;
+
+// Past this depth nodes are split at the median, which bounds the tree depth
+// (and hence the traversal stack) even for pathological primitive distributions
+static const uint32 MAX_SAH_DEPTH = 64;
+
+// Bins spread evenly over a node's centroid bounds, inbetween which the binned builder evaluates the SAH
+static const uint32 SAH_BIN_COUNT = 16;
+
+// LBVH leaves are split down to a single SIMD block of spheres, as there is no SAH to stop them earlier
+static const uint32 LBVH_LEAF_SIZE = INTERSECTION_BLOCK_SIZE;
+
+// Morton codes interleave this many bits of every axis, filling 30 of their bits,
+// which are sorted this many bits (i.e. radix sort passes) at a time
+static const uint32 MORTON_BITS_PER_AXIS = 10;
+static const uint32 RADIX_BITS = 10;
+
+// Once nodes get small enough, each is built as a subtree by a single worker. Aiming for
+// several subtrees per worker balances the load, since subtrees vary in size and depth.
+static const uint32 SUBTREES_PER_WORKER = 8;
+static const uint32 MIN_SUBTREE_SIZE = 256;
+
+// Nodes above the subtree size still have their bounds, bins and partitions 
+// computed by every worker, once they are at least this large
+static const uint32 MIN_PARALLEL_NODE_SIZE = 16384;
+
+// Refits growing the tree's surface area cost past this factor of the last build's are rejected
+static const f64 REFIT_MAX_COST_GROWTH = 1.25;
+
+// Refits of more than this fraction of the spheres are rejected, as a rebuild makes for a better tree
+static const uint32 REFIT_MAX_EDITED_FRACTION = 8;
+
+// Sphere bounds are slightly enlarged, so that floating point error in the
+// slab test can never cull a ray grazing the sphere
+static const f32 BOUNDS_PADDING = 1e-4f;
+
+static AABB computeSphereBounds(const Sphere& sphere)
+{
+    const auto extent = vec3<f32>(sphere.radius + BOUNDS_PADDING * (1.0f + sphere.radius));
+    return AABB(sphere.center - extent, sphere.center + extent);
+}
+
+// Whether the node's bounds enclose the given ones. Comparisons with NaN bounds fail.
+static bool containsBounds(const BVHNode& node, const AABB& bounds)
+{
+    return node.boundsMin.x <= bounds.boundsMin.x && node.boundsMin.y <= bounds.boundsMin.y && node.boundsMin.z <= bounds.boundsMin.z &&
+           node.boundsMax.x >= bounds.boundsMax.x && node.boundsMax.y >= bounds.boundsMax.y && node.boundsMax.z >= bounds.boundsMax.z;
+}
+
+static f32 getAxis(const vec3<f32>& vec, const uint32 axis)
+{
+    return axis == 0 ? vec.x : (axis == 1 ? vec.y : vec.z);
+}
+
+// Calls rangeJob(workerIndex, begin, end) with a contiguous share of [0, count) for 
+// every worker of the pool, and waits for all of them. Runs inline without a pool.
+template<typename RangeJob>
+static void parallelFor(ThreadPool* threadPool, const uint32 count, RangeJob rangeJob)
+{
+    const auto workerCount = threadPool ? threadPool->getThreadCount() : 1U;
+    if (workerCount == 1)
+    {
+        rangeJob(0U, 0U, count);
+        return;
+    }
+
+    threadPool->dispatch([&rangeJob, count, workerCount](const uint32 workerIndex)
+    {
+        const auto begin = static_cast<uint32>((static_cast<uint64>(count) * workerIndex) / workerCount);
+        const auto end = static_cast<uint32>((static_cast<uint64>(count) * (workerIndex + 1)) / workerCount);
+        rangeJob(workerIndex, begin, end);
+    });
+    threadPool->wait();
+}
+
+// Spreads the 10 low bits of v, so that there are two zero bits inbetween each of them
+static inline uint32 expandBits(uint32 v)
+{
+    v = (v * 0x00010001U) & 0xFF0000FFU;
+    v = (v * 0x00000101U) & 0x0F00F00FU;
+    v = (v * 0x00000011U) & 0xC30C30C3U;
+    v = (v * 0x00000005U) & 0x49249249U;
+    return v;
+}
+
+struct BuildState
+{
+    BVHBuilder builder;
+    std::vector<AABB> primBounds;
+    std::vector<vec3<f32>> centroids;
+    std::vector<uint32>& sphereIndices;
+
+    // Sorted Morton codes, in the order of sphereIndices (LBVH only)
+    std::vector<uint32> mortonCodes;
+
+    // Storage the parallel partitions scatter into
+    std::vector<uint32> partitionScratch;
+
+    explicit BuildState(std::vector<uint32>& sphereIndices)
+        : sphereIndices(sphereIndices)
+    {
+    }
+};
+
+// Per worker storage, reused by every node the worker splits
+struct BuildScratch
+{
+    std::vector<f32> rightAreas;
+    std::vector<uint32> rightIndices;
+};
+
+struct BuildTask
+{
+    uint32 nodeIndex;
+    uint32 depth;
+};
+
+struct SAHBin
+{
+    AABB bounds;
+    uint32 count;
+};
+
+struct SAHBins
+{
+    SAHBin bins[3][SAH_BIN_COUNT];
+};
+
+static void computeNodeBounds(const BuildState& state, const uint32 first, const uint32 count, ThreadPool* threadPool, AABB& nodeBounds, AABB& centroidBounds)
+{
+    const auto workerCount = threadPool ? threadPool->getThreadCount() : 1U;
+    std::vector<AABB> workerNodeBounds(workerCount), workerCentroidBounds(workerCount);
+
+    parallelFor(threadPool, count, [&state, &workerNodeBounds, &workerCentroidBounds, first](const uint32 workerIndex, const uint32 begin, const uint32 end)
+    {
+        for (auto i = first + begin; i < first + end; ++i)
+        {
+            workerNodeBounds[workerIndex].grow(state.primBounds[state.sphereIndices[i]]);
+            workerCentroidBounds[workerIndex].grow(state.centroids[state.sphereIndices[i]]);
+        }
+    });
+
+    // Growing bounds is exact, hence the result doesn't depend on the worker count
+    for (auto i = 0U; i < workerCount; ++i)
+    {
+        nodeBounds.grow(workerNodeBounds[i]);
+        centroidBounds.grow(workerCentroidBounds[i]);
+    }
+}
+
+static inline uint32 getBinIndex(const vec3<f32>& centroid, const uint32 axis, const AABB& centroidBounds, const f32 binScale)
+{
+    const auto bin = static_cast<uint32>((getAxis(centroid, axis) - getAxis(centroidBounds.boundsMin, axis)) * binScale);
+    return minu(bin, SAH_BIN_COUNT - 1);
+}
+
+// Splits at the median along the largest centroid extent, for when the SAH finds no split
+static uint32 splitAtMedian(BuildState& state, const uint32 first, const uint32 count, const AABB& centroidBounds)
+{
+    const auto extent = centroidBounds.boundsMax - centroidBounds.boundsMin;
+    const auto axis = extent.x > extent.y && extent.x > extent.z ? 0U : (extent.y > extent.z ? 1U : 2U);
+    const auto& centroids = state.centroids;
+    std::nth_element(state.sphereIndices.begin() + first, state.sphereIndices.begin() + first + count / 2, state.sphereIndices.begin() + first + count, [&centroids, axis](const uint32 a, const uint32 b)
+    {
+        return getAxis(centroids[a], axis) < getAxis(centroids[b], axis);
+    });
+    return count / 2;
+}
+
+// The original builder, sorting the primitives along every axis and evaluating the SAH between each of them
+static bool splitSweepSAH(BuildState& state, const uint32 first, const uint32 count, const uint32 depth, const AABB& nodeBounds, const AABB& centroidBounds, BuildScratch& scratch, uint32& split)
+{
+    auto& sphereIndices = state.sphereIndices;
+    const auto& centroids = state.centroids;
+    const auto& primBounds = state.primBounds;
+    auto& rightAreas = scratch.rightAreas;
+    rightAreas.resize(count);
+
+    // Find the cheapest split by sweeping over the centroid sorted primitives of each axis
+    auto bestCost = getIntersectionCost(count);
+    auto bestAxis = -1;
+    auto bestSplit = count / 2;
+
+    const auto nodeArea = nodeBounds.surfaceArea();
+    const auto centroidExtent = centroidBounds.boundsMax - centroidBounds.boundsMin;
+    for (auto axis = 0U; axis < 3 && depth < MAX_SAH_DEPTH && nodeArea > 0.0f; ++axis)
+    {
+        if (getAxis(centroidExtent, axis) <= 0.0f) continue;
+
+        std::sort(sphereIndices.begin() + first, sphereIndices.begin() + first + count, [&centroids, axis](const uint32 a, const uint32 b)
+        {
+            return getAxis(centroids[a], axis) < getAxis(centroids[b], axis);
+        });
+
+        AABB rightBounds;
+        for (auto i = count - 1; i > 0; --i)
+        {
+            rightBounds.grow(primBounds[sphereIndices[first + i]]);
+            rightAreas[i] = rightBounds.surfaceArea();
+        }
+
+        AABB leftBounds;
+        for (auto i = 1U; i < count; ++i)
+        {
+            leftBounds.grow(primBounds[sphereIndices[first + i - 1]]);
+            const auto cost = TRAVERSAL_COST + (leftBounds.surfaceArea() * getIntersectionCost(i) + rightAreas[i] * getIntersectionCost(count - i)) / nodeArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    // Creating a leaf is cheaper than any split
+    if (bestAxis == -1 && count <= MAX_LEAF_SIZE) return false;
+
+    if (bestAxis == -1)
+    {
+        split = splitAtMedian(state, first, count, centroidBounds);
+        return true;
+    }
+    
+    if (bestAxis != 2)
+    {
+        // The primitives are currently sorted along the last axis swept
+        std::sort(sphereIndices.begin() + first, sphereIndices.begin() + first + count, [&centroids, bestAxis](const uint32 a, const uint32 b)
+        {
+            return getAxis(centroids[a], bestAxis) < getAxis(centroids[b], bestAxis);
+        });
+    }
+
+    split = bestSplit;
+    return true;
+}
+
+static bool splitBinnedSAH(BuildState& state, const uint32 first, const uint32 count, const uint32 depth, const AABB& nodeBounds, const AABB& centroidBounds, ThreadPool* threadPool, BuildScratch& scratch, uint32& split)
+{
+    const auto nodeArea = nodeBounds.surfaceArea();
+    const auto centroidExtent = centroidBounds.boundsMax - centroidBounds.boundsMin;
+    if (depth >= MAX_SAH_DEPTH || nodeArea <= 0.0f || (centroidExtent.x <= 0.0f && centroidExtent.y <= 0.0f && centroidExtent.z <= 0.0f))
+    {
+        if (count <= MAX_LEAF_SIZE) return false;
+        split = splitAtMedian(state, first, count, centroidBounds);
+        return true;
+    }
+
+    f32 binScales[3];
+    for (auto axis = 0U; axis < 3; ++axis)
+    {
+        const auto extent = getAxis(centroidExtent, axis);
+        binScales[axis] = extent > 0.0f ? SAH_BIN_COUNT / extent : 0.0f;
+    }
+
+    // Every worker bins its share of the primitives, and the bins are merged after
+    const auto workerCount = threadPool ? threadPool->getThreadCount() : 1U;
+    std::vector<SAHBins> workerBins(workerCount);
+    parallelFor(threadPool, count, [&state, &workerBins, &centroidBounds, &binScales, first](const uint32 workerIndex, const uint32 begin, const uint32 end)
+    {
+        auto& bins = workerBins[workerIndex];
+        for (auto axis = 0U; axis < 3; ++axis)
+        {
+            for (auto bin = 0U; bin < SAH_BIN_COUNT; ++bin)
+            {
+                bins.bins[axis][bin].count = 0;
+            }
+        }
+
+        for (auto i = first + begin; i < first + end; ++i)
+        {
+            const auto sphereIndex = state.sphereIndices[i];
+            for (auto axis = 0U; axis < 3; ++axis)
+            {
+                auto& bin = bins.bins[axis][getBinIndex(state.centroids[sphereIndex], axis, centroidBounds, binScales[axis])];
+                bin.bounds.grow(state.primBounds[sphereIndex]);
+                bin.count++;
+            }
+        }
+    });
+
+    for (auto worker = 1U; worker < workerCount; ++worker)
+    {
+        for (auto axis = 0U; axis < 3; ++axis)
+        {
+            for (auto bin = 0U; bin < SAH_BIN_COUNT; ++bin)
+            {
+                workerBins[0].bins[axis][bin].bounds.grow(workerBins[worker].bins[axis][bin].bounds);
+                workerBins[0].bins[axis][bin].count += workerBins[worker].bins[axis][bin].count;
+            }
+        }
+    }
+
+    // Sweep over the bins of every axis, evaluating the SAH inbetween them
+    auto bestCost = getIntersectionCost(count);
+    auto bestAxis = -1;
+    auto bestBin = 0U;
+    for (auto axis = 0U; axis < 3; ++axis)
+    {
+        if (binScales[axis] <= 0.0f) continue;
+
+        const auto& bins = workerBins[0].bins[axis];
+        f32 rightAreas[SAH_BIN_COUNT];
+        uint32 rightCounts[SAH_BIN_COUNT];
+        AABB rightBounds;
+        auto rightCount = 0U;
+        for (auto bin = SAH_BIN_COUNT - 1; bin > 0; --bin)
+        {
+            rightBounds.grow(bins[bin].bounds);
+            rightCount += bins[bin].count;
+            rightAreas[bin] = rightBounds.surfaceArea();
+            rightCounts[bin] = rightCount;
+        }
+
+        AABB leftBounds;
+        auto leftCount = 0U;
+        for (auto bin = 1U; bin < SAH_BIN_COUNT; ++bin)
+        {
+            leftBounds.grow(bins[bin - 1].bounds);
+            leftCount += bins[bin - 1].count;
+            if (leftCount == 0 || rightCounts[bin] == 0) continue;
+
+            const auto cost = TRAVERSAL_COST + (leftBounds.surfaceArea() * getIntersectionCost(leftCount) + rightAreas[bin] * getIntersectionCost(rightCounts[bin])) / nodeArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestAxis == -1)
+    {
+        if (count <= MAX_LEAF_SIZE) return false;
+        split = splitAtMedian(state, first, count, centroidBounds);
+        return true;
+    }
+
+    // Stable partition into the bins left and right of the split, which keeps the order
+    // (and hence the tree) the same whether it is partitioned by one worker or many
+    const auto axis = static_cast<uint32>(bestAxis);
+    const auto binScale = binScales[axis];
+    const auto goesLeft = [&state, &centroidBounds, axis, binScale, bestBin](const uint32 sphereIndex)
+    {
+        return getBinIndex(state.centroids[sphereIndex], axis, centroidBounds, binScale) < bestBin;
+    };
+
+    if (workerCount == 1)
+    {
+        auto& rightIndices = scratch.rightIndices;
+        rightIndices.clear();
+
+        auto leftCount = 0U;
+        for (auto i = first; i < first + count; ++i)
+        {
+            const auto sphereIndex = state.sphereIndices[i];
+            if (goesLeft(sphereIndex)) state.sphereIndices[first + leftCount++] = sphereIndex;
+            else rightIndices.push_back(sphereIndex);
+        }
+
+        std::copy(rightIndices.begin(), rightIndices.end(), state.sphereIndices.begin() + first + leftCount);
+        split = leftCount;
+        return true;
+    }
+
+    std::vector<uint32> workerLeftCounts(workerCount);
+    parallelFor(threadPool, count, [&state, &workerLeftCounts, &goesLeft, first](const uint32 workerIndex, const uint32 begin, const uint32 end)
+    {
+        auto leftCount = 0U;
+        for (auto i = first + begin; i < first + end; ++i)
+        {
+            leftCount += goesLeft(state.sphereIndices[i]) ? 1 : 0;
+        }
+        workerLeftCounts[workerIndex] = leftCount;
+    });
+
+    auto totalLeftCount = 0U;
+    for (const auto leftCount: workerLeftCounts)
+    {
+        totalLeftCount += leftCount;
+    }
+
+    state.partitionScratch.resize(count);
+    parallelFor(threadPool, count, [&state, &workerLeftCounts, &goesLeft, first, totalLeftCount](const uint32 workerIndex, const uint32 begin, const uint32 end)
+    {
+        // Every worker's share goes after the shares of the workers before it, on either side
+        auto leftOffset = 0U;
+        for (auto worker = 0U; worker < workerIndex; ++worker)
+        {
+            leftOffset += workerLeftCounts[worker];
+        }
+        auto rightOffset = totalLeftCount + begin - leftOffset;
+
+        for (auto i = first + begin; i < first + end; ++i)
+        {
+            const auto sphereIndex = state.sphereIndices[i];
+            state.partitionScratch[goesLeft(sphereIndex) ? leftOffset++ : rightOffset++] = sphereIndex;
+        }
+    });
+
+    parallelFor(threadPool, count, [&state, first](const uint32, const uint32 begin, const uint32 end)
+    {
+        std::copy(state.partitionScratch.begin() + begin, state.partitionScratch.begin() + end, state.sphereIndices.begin() + first + begin);
+    });
+
+    split = totalLeftCount;
+    return true;
+}
+
+// The spheres are sorted by Morton code, so the children are the ranges on either side of
+// the highest bit the codes differ in. Needs no bounds, which are computed after the split.
+static bool splitLBVH(const BuildState& state, const uint32 first, const uint32 count, uint32& split)
+{
+    if (count <= LBVH_LEAF_SIZE) return false;
+
+    const auto firstCode = state.mortonCodes[first];
+    const auto lastCode = state.mortonCodes[first + count - 1];
+
+    // Spheres sharing a code can only be split arbitrarily
+    if (firstCode == lastCode)
+    {
+        if (count <= MAX_LEAF_SIZE) return false;
+        split = count / 2;
+        return true;
+    }
+
+    auto highestBit = 31U;
+    while (((firstCode ^ lastCode) >> highestBit) == 0) --highestBit;
+
+    const auto bitMask = 1U << highestBit;
+    const auto codesBegin = state.mortonCodes.begin() + first;
+    split = static_cast<uint32>(std::partition_point(codesBegin, codesBegin + count, [bitMask](const uint32 code) { return (code & bitMask) == 0; }) - codesBegin);
+    return true;
+}
+
+// Subdivides the node at rootIndex (holding a range of sphereIndices) down to its leaves. Nodes with no more
+// than deferredSize spheres are left as leaves instead, and recorded in deferred to be built as subtrees later.
+static void subdivide(BuildState& state, std::vector<BVHNode>& nodes, const BuildTask& root, ThreadPool* threadPool, BuildScratch& scratch, const uint32 deferredSize, std::vector<BuildTask>* deferred)
+{
+    // Iterative subdivision, since deep trees would overflow the call stack
+    std::vector<BuildTask> tasks;
+    tasks.push_back(root);
+
+    while (!tasks.empty())
+    {
+        const auto task = tasks.back();
+        tasks.pop_back();
+
+        const auto first = nodes[task.nodeIndex].leftFirst;
+        const auto count = nodes[task.nodeIndex].primCount;
+
+        if (count <= deferredSize)
+        {
+            deferred->push_back(task);
+            continue;
+        }
+
+        auto* nodeThreadPool = count >= MIN_PARALLEL_NODE_SIZE ? threadPool : nullptr;
+        auto split = 0U;
+        auto splitNode = false;
+        if (state.builder == BVH_BUILDER_LBVH)
+        {
+            splitNode = splitLBVH(state, first, count, split);
+        }
+        else
+        {
+            AABB nodeBounds, centroidBounds;
+            computeNodeBounds(state, first, count, nodeThreadPool, nodeBounds, centroidBounds);
+            nodes[task.nodeIndex].boundsMin = nodeBounds.boundsMin;
+            nodes[task.nodeIndex].boundsMax = nodeBounds.boundsMax;
+
+            if (count > 1)
+            {
+                splitNode = state.builder == BVH_BUILDER_SWEEP_SAH ?
+                    splitSweepSAH(state, first, count, task.depth, nodeBounds, centroidBounds, scratch, split) :
+                    splitBinnedSAH(state, first, count, task.depth, nodeBounds, centroidBounds, nodeThreadPool, scratch, split);
+            }
+        }
+
+        if (!splitNode) continue;
+
+        const auto leftChildIndex = static_cast<uint32>(nodes.size());
+        nodes.push_back(BVHNode());
+        nodes.push_back(BVHNode());
+
+        nodes[leftChildIndex].leftFirst = first;
+        nodes[leftChildIndex].primCount = split;
+        nodes[leftChildIndex + 1].leftFirst = first + split;
+        nodes[leftChildIndex + 1].primCount = count - split;
+
+        nodes[task.nodeIndex].leftFirst = leftChildIndex;
+        nodes[task.nodeIndex].primCount = 0;
+
+        tasks.push_back({ leftChildIndex + 1, task.depth + 1 });
+        tasks.push_back({ leftChildIndex, task.depth + 1 });
+    }
+}
+
+// Computes the bounds of the first nodeCount nodes from their children's or spheres' bounds.
+// Children are always stored after their parents, so walking backwards visits them first.
+static void computeBoundsBottomUp(const BuildState& state, BVHNode* nodes, const uint32 nodeCount)
+{
+    for (auto i = nodeCount; i-- > 0;)
+    {
+        auto& node = nodes[i];
+        AABB bounds;
+        if (node.isLeaf())
+        {
+            for (auto sphere = node.leftFirst; sphere < node.leftFirst + node.primCount; ++sphere)
+            {
+                bounds.grow(state.primBounds[state.sphereIndices[sphere]]);
+            }
+        }
+        else
+        {
+            bounds = AABB(nodes[node.leftFirst].boundsMin, nodes[node.leftFirst].boundsMax);
+            bounds.grow(AABB(nodes[node.leftFirst + 1].boundsMin, nodes[node.leftFirst + 1].boundsMax));
+        }
+
+        node.boundsMin = bounds.boundsMin;
+        node.boundsMax = bounds.boundsMax;
+    }
+}
+
+// Sorts the spheres by the Morton code of their centroid, within the centroid bounds of the whole scene
+static void sortByMortonCode(BuildState& state, ThreadPool* threadPool)
+{
+    const auto sphereCount = static_cast<uint32>(state.centroids.size());
+    const auto workerCount = threadPool ? threadPool->getThreadCount() : 1U;
+
+    AABB sceneBounds, centroidBounds;
+    computeNodeBounds(state, 0U, sphereCount, threadPool, sceneBounds, centroidBounds);
+
+    const auto cellCount = static_cast<f32>(1U << MORTON_BITS_PER_AXIS);
+    const auto extent = centroidBounds.boundsMax - centroidBounds.boundsMin;
+    const vec3<f32> cellScale(extent.x > 0.0f ? cellCount / extent.x : 0.0f, 
+                              extent.y > 0.0f ? cellCount / extent.y : 0.0f, 
+                              extent.z > 0.0f ? cellCount / extent.z : 0.0f);
+
+    std::vector<uint32> codes(sphereCount);
+    parallelFor(threadPool, sphereCount, [&state, &codes, &centroidBounds, &cellScale](const uint32, const uint32 begin, const uint32 end)
+    {
+        const auto maxCell = (1U << MORTON_BITS_PER_AXIS) - 1;
+        for (auto i = begin; i < end; ++i)
+        {
+            const auto cell = (state.centroids[i] - centroidBounds.boundsMin) * cellScale;
+            const auto x = minu(static_cast<uint32>(cell.x), maxCell);
+            const auto y = minu(static_cast<uint32>(cell.y), maxCell);
+            const auto z = minu(static_cast<uint32>(cell.z), maxCell);
+            codes[i] = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+        }
+    });
+
+    // Least significant digit first radix sort of the (code, sphere index) pairs. Every pass
+    // is stable, so spheres sharing a code end up in scene order, whatever the worker count.
+    const auto bucketCount = 1U << RADIX_BITS;
+    std::vector<uint32> sortedCodes(sphereCount), sortedIndices(sphereCount);
+    std::vector<uint32> bucketOffsets(workerCount * bucketCount);
+    auto& indices = state.sphereIndices;
+
+    for (auto shift = 0U; shift < 3 * MORTON_BITS_PER_AXIS; shift += RADIX_BITS)
+    {
+        std::fill(bucketOffsets.begin(), bucketOffsets.end(), 0U);
+        parallelFor(threadPool, sphereCount, [&codes, &bucketOffsets, bucketCount, shift](const uint32 workerIndex, const uint32 begin, const uint32 end)
+        {
+            auto* histogram = &bucketOffsets[workerIndex * bucketCount];
+            for (auto i = begin; i < end; ++i)
+            {
+                histogram[(codes[i] >> shift) & (bucketCount - 1)]++;
+            }
+        });
+
+        // Every worker scatters its share after the shares of the workers before it, bucket by bucket
+        auto offset = 0U;
+        for (auto bucket = 0U; bucket < bucketCount; ++bucket)
+        {
+            for (auto worker = 0U; worker < workerCount; ++worker)
+            {
+                const auto bucketSize = bucketOffsets[worker * bucketCount + bucket];
+                bucketOffsets[worker * bucketCount + bucket] = offset;
+                offset += bucketSize;
+            }
+        }
+
+        parallelFor(threadPool, sphereCount, [&codes, &indices, &sortedCodes, &sortedIndices, &bucketOffsets, bucketCount, shift](const uint32 workerIndex, const uint32 begin, const uint32 end)
+        {
+            auto* offsets = &bucketOffsets[workerIndex * bucketCount];
+            for (auto i = begin; i < end; ++i)
+            {
+                const auto target = offsets[(codes[i] >> shift) & (bucketCount - 1)]++;
+                sortedCodes[target] = codes[i];
+                sortedIndices[target] = indices[i];
+            }
+        });
+
+        codes.swap(sortedCodes);
+        indices.swap(sortedIndices);
+    }
+
+    state.mortonCodes = std::move(codes);
+}
+
+BVH::BVH()
+    : _sahCost(0.0f)
+    , _builtSurfaceAreaCost(0.0)
+{
+}
+
+void BVH::build(const std::vector<Sphere>& spheres, const BVHBuilder builder, ThreadPool* threadPool)
+{
+    _nodes.clear();
+    _spheres.clear();
+    _sphereIndices.clear();
+    _parentIndices.clear();
+    _sphereLeaves.clear();
+    _spherePositions.clear();
+    _sahCost = 0.0f;
+    _builtSurfaceAreaCost = 0.0;
+
+    if (spheres.empty()) return;
+
+    const auto sphereCount = static_cast<uint32>(spheres.size());
+    const auto workerCount = threadPool ? threadPool->getThreadCount() : 1U;
+
+    BuildState state(_sphereIndices);
+    state.builder = builder;
+    state.primBounds.resize(sphereCount);
+    state.centroids.resize(sphereCount);
+    _sphereIndices.resize(sphereCount);
+    parallelFor(threadPool, sphereCount, [this, &state, &spheres](const uint32, const uint32 begin, const uint32 end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            state.primBounds[i] = computeSphereBounds(spheres[i]);
+            state.centroids[i] = spheres[i].center;
+            _sphereIndices[i] = i;
+        }
+    });
+
+    if (builder == BVH_BUILDER_LBVH)
+    {
+        sortByMortonCode(state, threadPool);
+    }
+
+    // A binary tree with N leaves has at most 2N - 1 nodes. Reserving upfront
+    // keeps node references valid while children are being appended.
+    _nodes.reserve(2 * sphereCount);
+    _nodes.push_back(BVHNode());
+    _nodes[0].leftFirst = 0;
+    _nodes[0].primCount = sphereCount;
+
+    // The top of the tree is split with every worker working on each node, until the nodes
+    // are small enough to be handed out as a subtree per worker. Single workers build it all at once.
+    std::vector<BuildScratch> workerScratch(workerCount);
+    std::vector<BuildTask> subtrees;
+    const auto subtreeSize = workerCount > 1 ? maxu(MIN_SUBTREE_SIZE, sphereCount / (workerCount * SUBTREES_PER_WORKER)) : 0U;
+    subdivide(state, _nodes, { 0U, 0U }, threadPool, workerScratch[0], subtreeSize, &subtrees);
+    const auto topNodeCount = static_cast<uint32>(_nodes.size());
+
+    // Workers pick the subtrees up one at a time, each into nodes of its own
+    std::vector<std::vector<BVHNode>> subtreeNodes(subtrees.size());
+    std::atomic<uint32> nextSubtree(0);
+    parallelFor(threadPool, workerCount, [this, &state, &subtrees, &subtreeNodes, &nextSubtree, &workerScratch](const uint32 workerIndex, const uint32, const uint32)
+    {
+        for (auto subtree = nextSubtree++; subtree < subtrees.size(); subtree = nextSubtree++)
+        {
+            auto& nodes = subtreeNodes[subtree];
+            const auto& root = _nodes[subtrees[subtree].nodeIndex];
+            nodes.reserve(2 * root.primCount);
+            nodes.push_back(root);
+            subdivide(state, nodes, { 0U, subtrees[subtree].depth }, nullptr, workerScratch[workerIndex], 0U, nullptr);
+
+            if (state.builder == BVH_BUILDER_LBVH)
+            {
+                computeBoundsBottomUp(state, nodes.data(), static_cast<uint32>(nodes.size()));
+            }
+        }
+    });
+
+    // Subtrees are appended in the order they were deferred in, with their root taking the place of
+    // the node they were deferred as. That keeps the tree independent of which worker built what.
+    std::vector<uint32> subtreeOffsets(subtrees.size());
+    auto nodeCount = topNodeCount;
+    for (auto subtree = 0U; subtree < subtrees.size(); ++subtree)
+    {
+        subtreeOffsets[subtree] = nodeCount - 1;
+        nodeCount += static_cast<uint32>(subtreeNodes[subtree].size()) - 1;
+    }
+
+    _nodes.resize(nodeCount);
+    parallelFor(threadPool, static_cast<uint32>(subtrees.size()), [this, &subtrees, &subtreeNodes, &subtreeOffsets](const uint32, const uint32 begin, const uint32 end)
+    {
+        for (auto subtree = begin; subtree < end; ++subtree)
+        {
+            const auto& nodes = subtreeNodes[subtree];
+            const auto offset = subtreeOffsets[subtree];
+            for (auto i = 0U; i < nodes.size(); ++i)
+            {
+                auto node = nodes[i];
+                if (!node.isLeaf()) node.leftFirst += offset;
+                _nodes[i == 0 ? subtrees[subtree].nodeIndex : offset + i] = node;
+            }
+        }
+    });
+
+    if (builder == BVH_BUILDER_LBVH)
+    {
+        computeBoundsBottomUp(state, _nodes.data(), topNodeCount);
+    }
+
+    // Store the spheres in BVH order
+    _spheres.resize(sphereCount);
+    for (auto i = 0U; i < sphereCount; ++i)
+    {
+        _spheres[i] = spheres[_sphereIndices[i]];
+    }
+
+    _builtSurfaceAreaCost = computeSurfaceAreaCost();
+    _sahCost = computeSAHCost(_builtSurfaceAreaCost);
+}
+
+void BVH::prepareRefit()
+{
+    if (!_parentIndices.empty() || _nodes.empty()) return;
+
+    _parentIndices.assign(_nodes.size(), 0U);
+    _sphereLeaves.resize(_spheres.size());
+    _spherePositions.resize(_spheres.size());
+    for (auto i = 0U; i < _nodes.size(); ++i)
+    {
+        const auto& node = _nodes[i];
+        if (node.isLeaf())
+        {
+            for (auto sphere = node.leftFirst; sphere < node.leftFirst + node.primCount; ++sphere)
+            {
+                _sphereLeaves[sphere] = i;
+            }
+        }
+        else
+        {
+            _parentIndices[node.leftFirst] = i;
+            _parentIndices[node.leftFirst + 1] = i;
+        }
+    }
+
+    for (auto i = 0U; i < _sphereIndices.size(); ++i)
+    {
+        _spherePositions[_sphereIndices[i]] = i;
+    }
+}
+
+bool BVH::refit(const std::vector<Sphere>& spheres, const std::vector<uint32>& editedSpheres)
+{
+    if (spheres.size() != _spheres.size() || editedSpheres.size() > _spheres.size() / REFIT_MAX_EDITED_FRACTION) return false;
+
+    prepareRefit();
+
+    // Kept around for undoing the refit, should it be rejected
+    std::vector<std::pair<uint32, BVHNode>> previousNodes;
+    std::vector<std::pair<uint32, Sphere>> previousSpheres;
+
+    for (const auto sphereIndex: editedSpheres)
+    {
+        const auto position = _spherePositions[sphereIndex];
+        previousSpheres.push_back(std::make_pair(position, _spheres[position]));
+        _spheres[position] = spheres[sphereIndex];
+
+        // Walk up from the sphere's leaf, for as long as the bounds keep changing
+        auto nodeIndex = _sphereLeaves[position];
+        while (true)
+        {
+            auto& node = _nodes[nodeIndex];
+            AABB bounds;
+            if (node.isLeaf())
+            {
+                for (auto sphere = node.leftFirst; sphere < node.leftFirst + node.primCount; ++sphere)
+                {
+                    bounds.grow(computeSphereBounds(_spheres[sphere]));
+                }
+            }
+            else
+            {
+                bounds = AABB(_nodes[node.leftFirst].boundsMin, _nodes[node.leftFirst].boundsMax);
+                bounds.grow(AABB(_nodes[node.leftFirst + 1].boundsMin, _nodes[node.leftFirst + 1].boundsMax));
+            }
+
+            if (memcmp(&bounds.boundsMin, &node.boundsMin, sizeof(bounds.boundsMin)) == 0 &&
+                memcmp(&bounds.boundsMax, &node.boundsMax, sizeof(bounds.boundsMax)) == 0)
+            {
+                break;
+            }
+
+            previousNodes.push_back(std::make_pair(nodeIndex, node));
+            node.boundsMin = bounds.boundsMin;
+            node.boundsMax = bounds.boundsMax;
+
+            if (nodeIndex == 0) break;
+            nodeIndex = _parentIndices[nodeIndex];
+        }
+    }
+
+    // Measured before normalizing, since spheres moving outwards grow the root (and hence lower the SAH cost)
+    const auto surfaceAreaCost = computeSurfaceAreaCost();
+    if (surfaceAreaCost > _builtSurfaceAreaCost * REFIT_MAX_COST_GROWTH)
+    {
+        // Undone in reverse, so that nodes updated more than once end up with their original bounds
+        for (auto i = previousNodes.size(); i-- > 0;)
+        {
+            _nodes[previousNodes[i].first] = previousNodes[i].second;
+        }
+        for (auto i = previousSpheres.size(); i-- > 0;)
+        {
+            _spheres[previousSpheres[i].first] = previousSpheres[i].second;
+        }
+        return false;
+    }
+
+    _sahCost = computeSAHCost(surfaceAreaCost);
+    return true;
+}
+
+f64 BVH::computeSurfaceAreaCost() const
+{
+    // Accumulated in double precision, as a million nodes can add up to quite some error in floats
+    auto cost = 0.0;
+    for (const auto& node: _nodes)
+    {
+        const auto area = AABB(node.boundsMin, node.boundsMax).surfaceArea();
+        cost += static_cast<f64>(area) * (node.isLeaf() ? getIntersectionCost(node.primCount) : TRAVERSAL_COST);
+    }
+    return cost;
+}
+
+f32 BVH::computeSAHCost(const f64 surfaceAreaCost) const
+{
+    if (_nodes.empty()) return 0.0f;
+
+    const auto rootArea = AABB(_nodes[0].boundsMin, _nodes[0].boundsMax).surfaceArea();
+    if (rootArea <= 0.0f) return getIntersectionCost(_nodes[0].primCount);
+
+    return static_cast<f32>(surfaceAreaCost / rootArea);
+}
+
+bool BVH::restore(const BVHNode* nodes, const size_t nodeCount, const uint32* sphereIndices, const std::vector<Sphere>& spheres)
+{
+    _nodes.assign(nodes, nodes + nodeCount);
+    _sphereIndices.assign(sphereIndices, sphereIndices + spheres.size());
+    _spheres.resize(spheres.size());
+
+    // Each sphere has to appear exactly once
+    auto valid = spheres.empty() ? nodeCount == 0 : nodeCount > 0;
+    std::vector<bool> referenced(spheres.size(), false);
+    for (auto i = 0U; valid && i < spheres.size(); ++i)
+    {
+        const auto sphereIndex = _sphereIndices[i];
+        valid = sphereIndex < spheres.size() && !referenced[sphereIndex];
+        
+        if (valid)
+        {
+            referenced[sphereIndex] = true;
+            _spheres[i] = spheres[sphereIndex];
+        }
+    }
+
+    // Every node has to reference existing children or spheres, and bound them. Children stored
+    // after their parent rule out cycles, and children with a single parent make the nodes a tree,
+    // whose depths are then final by the time each node is reached. The depth has to fit the
+    // traversal stack, and the leaves have to cover every sphere exactly once.
+    std::vector<uint32> nodeDepths(nodeCount, 0);
+    std::vector<bool> hasParent(nodeCount, false);
+    std::vector<bool> covered(spheres.size(), false);
+    for (auto i = 0U; valid && i < nodeCount; ++i)
+    {
+        const auto& node = _nodes[i];
+        if (i > 0 && !hasParent[i])
+        {
+            valid = false;
+        }
+        else if (node.isLeaf())
+        {
+            valid = static_cast<uint64>(node.leftFirst) + node.primCount <= spheres.size();
+            for (auto j = node.leftFirst; valid && j < node.leftFirst + node.primCount; ++j)
+            {
+                valid = !covered[j] && containsBounds(node, computeSphereBounds(_spheres[j]));
+                covered[j] = true;
+            }
+        }
+        else
+        {
+            valid = node.leftFirst > i && static_cast<uint64>(node.leftFirst) + 1 < nodeCount && nodeDepths[i] + 1 < BVH_STACK_SIZE &&
+                    !hasParent[node.leftFirst] && !hasParent[node.leftFirst + 1];
+            if (valid)
+            {
+                const auto& left = _nodes[node.leftFirst];
+                const auto& right = _nodes[node.leftFirst + 1];
+                valid = containsBounds(node, AABB(left.boundsMin, left.boundsMax)) && containsBounds(node, AABB(right.boundsMin, right.boundsMax));
+
+                hasParent[node.leftFirst] = true;
+                hasParent[node.leftFirst + 1] = true;
+                nodeDepths[node.leftFirst] = nodeDepths[i] + 1;
+                nodeDepths[node.leftFirst + 1] = nodeDepths[i] + 1;
+            }
+        }
+    }
+
+    valid = valid && std::find(covered.begin(), covered.end(), false) == covered.end();
+
+    if (!valid)
+    {
+        _nodes.clear();
+        _spheres.clear();
+        _sphereIndices.clear();
+    }
+
+    _builtSurfaceAreaCost = computeSurfaceAreaCost();
+    _sahCost = computeSAHCost(_builtSurfaceAreaCost);
+    _parentIndices.clear();
+    _sphereLeaves.clear();
+    _spherePositions.clear();
+    return valid;
+}
+
+bool BVH::isBuiltFrom(const std::vector<Sphere>& spheres) const
+{
+    if (spheres.size() != _spheres.size()) return false;
+
+    const auto sphereCount = static_cast<uint32>(spheres.size());
+    for (auto i = 0U; i < sphereCount; ++i)
+    {
+        const auto& source = spheres[_sphereIndices[i]];
+        const auto& built = _spheres[i];
+
+        if (source.radius != built.radius ||
+            source.center.x != built.center.x ||
+            source.center.y != built.center.y ||
+            source.center.z != built.center.z ||
+            source.matIndex != built.matIndex)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
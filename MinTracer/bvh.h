@@ -0,0 +1,222 @@
+/**********************************************************************/
+/** bvh.h by Alex Koukoulas (C) 2017 All Rights Reserved             **/
+/** File Description: Interface to the Bounding Volume Hierarchy     **/
+/** built over the bounded primitives (spheres) of the scene         **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "instrumentation.h"
+
+// Remote Headers
+#include <vector>
+
+class ThreadPool;
+
+// Upper bound of the tree depth, also used as the traversal stack size.
+// The builder falls back to median splits well before reaching it.
+const uint32 BVH_STACK_SIZE = 128;
+
+struct AABB
+{
+    vec3<f32> boundsMin;
+    vec3<f32> boundsMax;
+
+    AABB()
+        : boundsMin(1e30f)
+        , boundsMax(-1e30f)
+    {
+    }
+
+    AABB(const vec3<f32>& boundsMin, const vec3<f32>& boundsMax)
+        : boundsMin(boundsMin)
+        , boundsMax(boundsMax)
+    {
+    }
+
+    inline void grow(const vec3<f32>& point)
+    {
+        boundsMin = vec3<f32>(minf(boundsMin.x, point.x), minf(boundsMin.y, point.y), minf(boundsMin.z, point.z));
+        boundsMax = vec3<f32>(maxf(boundsMax.x, point.x), maxf(boundsMax.y, point.y), maxf(boundsMax.z, point.z));
+    }
+
+    inline void grow(const AABB& other)
+    {
+        grow(other.boundsMin);
+        grow(other.boundsMax);
+    }
+
+    inline f32 surfaceArea() const
+    {
+        const auto extent = boundsMax - boundsMin;
+        return extent.x < 0.0f ? 0.0f : 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
+
+// 32 byte node. Leaves have a non zero primCount, with leftFirst pointing
+// to their first primitive. Interior nodes have their children stored
+// next to each other, at leftFirst and leftFirst + 1.
+struct BVHNode
+{
+    vec3<f32> boundsMin;
+    uint32 leftFirst;
+    vec3<f32> boundsMax;
+    uint32 primCount;
+
+    inline bool isLeaf() const { return primCount > 0; }
+};
+
+class BVH final
+{
+public:
+    BVH();
+
+    // Builds the hierarchy with the given builder, spreading the work over the pool's workers
+    // if one is given. The hierarchy is identical regardless of the number of workers.
+    void build(const std::vector<Sphere>& spheres, const BVHBuilder builder = BVH_BUILDER_BINNED_SAH, ThreadPool* threadPool = nullptr);
+
+    // Adopts a previously built hierarchy (e.g. loaded from a binary scene), 
+    // given its nodes and BVH ordered sphere indices. Returns false, leaving 
+    // the hierarchy empty, if they don't form a valid BVH over the spheres.
+    bool restore(const BVHNode* nodes, const size_t nodeCount, const uint32* sphereIndices, const std::vector<Sphere>& spheres);
+
+    // Updates the hierarchy for the given spheres, which differ from the ones it was built from only
+    // in the edited ones (by scene index). Only those spheres and the bounds above them are updated,
+    // keeping the topology as is, which loosens the tree as spheres move away. Returns false, leaving
+    // the hierarchy untouched, if it would degrade too much (or too many spheres were edited to bother),
+    // in which case it should be rebuilt instead.
+    bool refit(const std::vector<Sphere>& spheres, const std::vector<uint32>& editedSpheres);
+
+    // Checks whether the hierarchy is still valid for the given spheres,
+    // i.e. it was built from an identical sphere list
+    bool isBuiltFrom(const std::vector<Sphere>& spheres) const;
+
+    // Spheres are stored in BVH order, so that leaves are contiguous in memory.
+    // getSphereIndex maps a BVH ordered sphere back to its index in the scene.
+    inline const Sphere& getSphere(const uint32 index) const { return _spheres[index]; }
+    inline uint32 getSphereIndex(const uint32 index) const { return _sphereIndices[index]; }
+
+    inline const BVHNode* getNodes() const { return _nodes.data(); }
+    inline const uint32* getSphereIndices() const { return _sphereIndices.data(); }
+    inline size_t getNodeCount() const { return _nodes.size(); }
+    inline size_t getSphereCount() const { return _spheres.size(); }
+
+    // Tree quality, as the Surface Area Heuristic cost of tracing a ray that hits the root's
+    // bounds (with the relative costs the builders use). Lower is better, 0 for empty trees.
+    inline f32 getSAHCost() const { return _sahCost; }
+
+    // Visits, nearest first, every leaf whose bounds are hit by the ray before maxT.
+    // The visitor is called with the leaf's BVH ordered sphere range and may shrink
+    // maxT to prune the remaining nodes, or return true to terminate the traversal.
+    template<typename LeafVisitor>
+    void traverse(const Ray& ray, f32& maxT, LeafVisitor visitLeaf) const;
+
+private:
+    struct StackEntry
+    {
+        uint32 nodeIndex;
+        f32 tEntry;
+    };
+
+    static bool intersectBounds(const BVHNode& node, const vec3<f32>& origin, const vec3<f32>& invDirection, const f32 maxT, f32& tEntry);
+
+    // Sum of every node's surface area times its cost, i.e. the SAH cost before it is normalized by the root's area
+    f64 computeSurfaceAreaCost() const;
+    f32 computeSAHCost(const f64 surfaceAreaCost) const;
+
+    // Computes the tables refit looks the edited spheres' ancestors up in, unless already computed
+    void prepareRefit();
+
+private:
+    std::vector<BVHNode> _nodes;
+    std::vector<Sphere> _spheres;
+    std::vector<uint32> _sphereIndices;
+    f32 _sahCost;
+
+    // Surface area cost right after the last (re)build, which refits are measured against
+    f64 _builtSurfaceAreaCost;
+
+    // Refit tables, only computed once the hierarchy is first refit: the parent of every node,
+    // the leaf of every BVH ordered sphere and the BVH order position of every scene sphere
+    std::vector<uint32> _parentIndices;
+    std::vector<uint32> _sphereLeaves;
+    std::vector<uint32> _spherePositions;
+};
+
+inline bool BVH::intersectBounds(const BVHNode& node, const vec3<f32>& origin, const vec3<f32>& invDirection, const f32 maxT, f32& tEntry)
+{
+    const auto tx1 = (node.boundsMin.x - origin.x) * invDirection.x;
+    const auto tx2 = (node.boundsMax.x - origin.x) * invDirection.x;
+    const auto ty1 = (node.boundsMin.y - origin.y) * invDirection.y;
+    const auto ty2 = (node.boundsMax.y - origin.y) * invDirection.y;
+    const auto tz1 = (node.boundsMin.z - origin.z) * invDirection.z;
+    const auto tz2 = (node.boundsMax.z - origin.z) * invDirection.z;
+
+    const auto tMin = maxf(maxf(minf(tx1, tx2), minf(ty1, ty2)), minf(tz1, tz2));
+    const auto tMax = minf(minf(maxf(tx1, tx2), maxf(ty1, ty2)), maxf(tz1, tz2));
+
+    tEntry = tMin;
+    return tMax >= maxf(tMin, 0.0f) && tMin <= maxT;
+}
+
+template<typename LeafVisitor>
+void BVH::traverse(const Ray& ray, f32& maxT, LeafVisitor visitLeaf) const
+{
+    if (_nodes.empty()) return;
+
+    const vec3<f32> invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+    StackEntry stack[BVH_STACK_SIZE];
+    auto stackSize = 0U;
+
+    f32 tEntry;
+    if (!intersectBounds(_nodes[0], ray.origin, invDirection, maxT, tEntry)) return;
+    stack[stackSize++] = { 0U, tEntry };
+
+    while (stackSize > 0)
+    {
+        const auto entry = stack[--stackSize];
+
+        // maxT might have shrunk since this node was pushed
+        if (entry.tEntry > maxT) continue;
+
+        INSTRUMENT_COUNT(COUNTER_BVH_NODES_VISITED, 1);
+        const auto& node = _nodes[entry.nodeIndex];
+        if (node.isLeaf())
+        {
+            if (visitLeaf(node.leftFirst, node.primCount)) return;
+            continue;
+        }
+
+        f32 tLeft, tRight;
+        const auto hitLeft = intersectBounds(_nodes[node.leftFirst], ray.origin, invDirection, maxT, tLeft);
+        const auto hitRight = intersectBounds(_nodes[node.leftFirst + 1], ray.origin, invDirection, maxT, tRight);
+
+        // Push the farthest child first, so that the nearest one is visited next
+        if (hitLeft && hitRight)
+        {
+            if (tLeft <= tRight)
+            {
+                stack[stackSize++] = { node.leftFirst + 1, tRight };
+                stack[stackSize++] = { node.leftFirst, tLeft };
+            }
+            else
+            {
+                stack[stackSize++] = { node.leftFirst, tLeft };
+                stack[stackSize++] = { node.leftFirst + 1, tRight };
+            }
+        }
+        else if (hitLeft)
+        {
+            stack[stackSize++] = { node.leftFirst, tLeft };
+        }
+        else if (hitRight)
+        {
+            stack[stackSize++] = { node.leftFirst + 1, tRight };
+        }
+    }
+}
@@ -0,0 +1,454 @@
+/**********************************************************************/
+/** headless.cpp by Alex Koukoulas (C) 2017 All Rights Reserved      **/
+/** File Description: Portable command-line entry point, rendering  **/
+/** a scene file without any GUI and reporting render throughput     **/
+/**********************************************************************/
+
+// Local Headers
+#include "raytracer.h"
+#include "scene.h"
+#include "image.h"
+#include "threadpool.h"
+#include "spherekernels.h"
+#include "benchmark.h"
+#include "microbenchmark.h"
+#include "restorecheck.h"
+#include "scenegenerator.h"
+#include "instrumentation.h"
+
+// Remote Headers
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+static void printUsage(const char* executableName)
+{
+    cout << "Usage: " << executableName << " [scene.scn ...] [options]" << endl
+         << "  -w <width>     Render width in pixels (default 842)" << endl
+         << "  -h <height>    Render height in pixels (default 683)" << endl
+         << "  -t <threads>   Worker thread count (default hardware concurrency)" << endl
+         << "  -p <passes>    Progressive refinement passes, each doubling the resolution" << endl
+         << "                 of the previous one and ending at the render resolution (default 1)." << endl
+         << "                 The width and height are rounded down to a multiple of 2^(passes - 1)," << endl
+         << "                 with a warning, for every pass to be exactly half the next one" << endl
+         << "  -o <file.bmp>  Output image path (default headless_rendering.bmp)" << endl
+         << "  -l <order>     Tile and pixel order, one of scanline, morton or hilbert (default hilbert)" << endl
+         << "  -z <size>      Tile size in pixels (default 16)" << endl
+         << "  -a <builder>   BVH builder, one of sweep, binned or lbvh (default binned)" << endl
+         << "  -s <kernels>   Sphere kernels to use, one of scalar, sse or avx (default widest supported)" << endl
+         << "  -r <rays>      Ray tracing, either packets, single or wavefront (default packets)" << endl
+         << "  -b <name>      Run a benchmark on the scene instead of rendering it. Available: packets," << endl
+         << "                 comparing packet tracing against single ray tracing, and wavefront," << endl
+         << "                 comparing wavefront tracing against packet tracing, and tileorder, comparing" << endl
+         << "                 the tile orders, including their cache misses where counters are available," << endl
+         << "                 and bvh, comparing the BVH builders' build times and quality at 1 up to" << endl
+         << "                 -t workers, edit, timing sphere edits with the BVH being refit, micro," << endl
+         << "                 timing the individual kernels over seeded inputs, and scenes, rendering" << endl
+         << "                 every given scene along with generated ones at several resolutions on 1 up" << endl
+         << "                 to -t workers. Also available is restore, checking rather than timing that" << endl
+         << "                 corrupted BVHs stored in binary scenes are rebuilt when loaded" << endl
+         << "  -n <count>     Benchmark repetitions (default 5)" << endl
+         << "  -e <seed>      Seed of the inputs randomly generated by benchmarks (default 1)" << endl
+         << "  -j <file.json> Also write the benchmark results as JSON to the given file (micro and scenes)" << endl
+         << "  -c <file>      Convert the scene to the given file instead of rendering it. Files with" << endl
+         << "                 the .scnb extension get the binary scene format (including the BVH)," << endl
+         << "                 any other extension gets the text format" << endl
+         << "  -g <spheres>   Generate a scene of the given sphere count from the -e seed instead of" << endl
+         << "                 loading one, to be rendered, benchmarked or saved with -c" << endl
+         << "  -d <spread>    Distribution of the generated spheres, one of uniform, clustered," << endl
+         << "                 overlapping or thin (default uniform)" << endl
+         << "  -m <lights>    Light count of the generated scene (default 1)" << endl
+         << "  -f <r>,<t>     Shares of reflective and refractive generated spheres (default 0.2,0.1)" << endl
+         << "  -i <file.json> Write a Chrome trace (chrome://tracing or Perfetto) of the render's stages" << endl
+         << "                 per worker. Requires a build with MINTRACER_INSTRUMENTATION defined" << endl
+         << "  -x <metric>    Also write a heatmap of each pixel's cost next to the output image, as" << endl
+         << "                 <output>_heatmap.bmp. The cost is one of time (cycles), tests (ray" << endl
+         << "                 primitive tests) or nodes (BVH nodes visited), the latter two requiring" << endl
+         << "                 MINTRACER_INSTRUMENTATION. Pixels are then traced one by one" << endl
+         << "When no scene file is given the built-in default scene is rendered, and when several are" << endl
+         << "given all but the first are only used by the scenes benchmark." << endl
+         << "Scene files can be either in the text or the binary scene format." << endl;
+}
+
+// Counters and the stages that took place, where instrumentation is compiled in
+static void printInstrumentation(const InstrumentationTotals& totals)
+{
+    if (!isInstrumentationEnabled()) return;
+
+    for (auto i = 0U; i < COUNTER_COUNT; ++i)
+    {
+        if (totals.counters[i] == 0) continue;
+        cout << "  " << totals.counters[i] << " " << getInstrumentationCounterName(static_cast<InstrumentationCounter>(i)) << endl;
+    }
+
+    // Summed over every worker, and including the stages nested within
+    for (auto i = 0U; i < STAGE_COUNT; ++i)
+    {
+        if (totals.stageCalls[i] == 0) continue;
+        cout << "  " << getInstrumentationStageName(static_cast<InstrumentationStage>(i)) << ": " << totals.stageNs[i] / 1e6 << " ms over "
+             << totals.stageCalls[i] << " call(s)" << endl;
+    }
+}
+
+static void printRenderStats(const RenderStats& stats)
+{
+    const auto raysPerSecond = stats.elapsedMs > 0.0 ? stats.rayCount / (stats.elapsedMs / 1000.0) : 0.0;
+    // Cost of a single ray on a single worker, comparable across thread counts
+    const auto nsPerRay = stats.rayCount > 0 ? stats.elapsedMs * 1e6 * stats.threadCount / stats.rayCount : 0.0;
+    cout << "BVH (" << getBVHBuilderName(stats.bvhBuilder) << ") build took " << stats.bvhBuildMs << " ms (" << Scene::get().getSphereCount() << " sphere(s)), SAH cost " 
+         << stats.bvhSAHCost << ", scene compile took " << stats.sceneCompileMs << " ms" << endl;
+    cout << "Ray Trace finished - " << stats.elapsedMs << " ms elapsed | " << stats.threadCount << " worker(s) | "
+         << stats.rayCount << " rays | " << raysPerSecond / 1e6 << " Mrays/s | " << nsPerRay << " ns/ray" << endl;
+    cout << "  " << stats.primaryRayCount << " primary, " << stats.secondaryRayCount << " secondary and " 
+         << stats.shadowRayCount << " shadow rays" << endl;
+
+    for (auto i = 0U; i < stats.workerStats.size(); ++i)
+    {
+        const auto& workerStats = stats.workerStats[i];
+        cout << "  Worker " << i << ": " << workerStats.busyMs << " ms busy (" 
+             << (stats.elapsedMs > 0.0 ? 100.0 * workerStats.busyMs / stats.elapsedMs : 0.0) << "%) | "
+             << workerStats.tileCount << " tile(s), " << workerStats.stealCount << " stolen | " 
+             << workerStats.rayCount << " rays" << endl;
+    }
+
+    printInstrumentation(stats.instrumentation);
+}
+
+int main(int argc, char** argv)
+{
+    vector<string> sceneFilePaths;
+    string outputFilePath = "headless_rendering.bmp";
+    string convertedSceneFilePath;
+    auto renderWidth = 842;
+    auto renderHeight = 683;
+    auto threadCount = getDefaultThreadCount();
+    auto passCount = 1U;
+    auto benchmarkRepetitions = 5U;
+    auto seed = 1ULL;
+    string jsonFilePath;
+    string traceFilePath;
+    string benchmarkName;
+    RenderOptions renderOptions;
+    SceneGeneratorSettings generatorSettings;
+    auto generateSceneFlag = false;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "-w" && hasValue) renderWidth = stoi(argv[++i]);
+        else if (arg == "-h" && hasValue) renderHeight = stoi(argv[++i]);
+        else if (arg == "-t" && hasValue) threadCount = maxu(1U, static_cast<uint32>(stoi(argv[++i])));
+        else if (arg == "-p" && hasValue) passCount = minu(16U, maxu(1U, static_cast<uint32>(stoi(argv[++i]))));
+        else if (arg == "-o" && hasValue) outputFilePath = argv[++i];
+        else if (arg == "-c" && hasValue) convertedSceneFilePath = argv[++i];
+        else if (arg == "-n" && hasValue) benchmarkRepetitions = maxu(1U, static_cast<uint32>(stoi(argv[++i])));
+        else if (arg == "-b" && hasValue) benchmarkName = argv[++i];
+        else if (arg == "-e" && hasValue) seed = stoull(argv[++i]);
+        else if (arg == "-j" && hasValue) jsonFilePath = argv[++i];
+        else if (arg == "-i" && hasValue) traceFilePath = argv[++i];
+        else if (arg == "-g" && hasValue)
+        {
+            generatorSettings.sphereCount = static_cast<uint32>(stoul(argv[++i]));
+            generateSceneFlag = true;
+        }
+        else if (arg == "-m" && hasValue) generatorSettings.lightCount = maxu(1U, static_cast<uint32>(stoi(argv[++i])));
+        else if (arg == "-f" && hasValue)
+        {
+            const string shares = argv[++i];
+            const auto separator = shares.find(',');
+            if (separator == string::npos)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            generatorSettings.reflectiveShare = stof(shares.substr(0, separator));
+            generatorSettings.refractiveShare = stof(shares.substr(separator + 1));
+        }
+        else if (arg == "-d" && hasValue)
+        {
+            const string distribution = argv[++i];
+            if (distribution == "uniform") generatorSettings.distribution = SCENE_DISTRIBUTION_UNIFORM;
+            else if (distribution == "clustered") generatorSettings.distribution = SCENE_DISTRIBUTION_CLUSTERED;
+            else if (distribution == "overlapping") generatorSettings.distribution = SCENE_DISTRIBUTION_OVERLAPPING;
+            else if (distribution == "thin") generatorSettings.distribution = SCENE_DISTRIBUTION_THIN;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-z" && hasValue) renderOptions.tileSize = maxu(1U, static_cast<uint32>(stoi(argv[++i])));
+        else if (arg == "-a" && hasValue)
+        {
+            const string builder = argv[++i];
+            if (builder == "sweep") renderOptions.bvhBuilder = BVH_BUILDER_SWEEP_SAH;
+            else if (builder == "binned") renderOptions.bvhBuilder = BVH_BUILDER_BINNED_SAH;
+            else if (builder == "lbvh") renderOptions.bvhBuilder = BVH_BUILDER_LBVH;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-l" && hasValue)
+        {
+            const string order = argv[++i];
+            if (order == "scanline") renderOptions.tileOrder = TILE_ORDER_SCANLINE;
+            else if (order == "morton") renderOptions.tileOrder = TILE_ORDER_MORTON;
+            else if (order == "hilbert") renderOptions.tileOrder = TILE_ORDER_HILBERT;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-r" && hasValue)
+        {
+            const string rays = argv[++i];
+            if (rays == "packets") renderOptions.packetTracing = true;
+            else if (rays == "single") renderOptions.packetTracing = false;
+            else if (rays == "wavefront") renderOptions.wavefront = true;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-s" && hasValue)
+        {
+            const string kernels = argv[++i];
+            if (kernels == "scalar") setSimdLevel(SIMD_SCALAR);
+            else if (kernels == "sse") setSimdLevel(SIMD_SSE);
+            else if (kernels == "avx") setSimdLevel(SIMD_AVX);
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-x" && hasValue)
+        {
+            const string metric = argv[++i];
+            if (metric == "time") renderOptions.costMetric = COST_METRIC_CYCLES;
+            else if (metric == "tests") renderOptions.costMetric = COST_METRIC_INTERSECTION_TESTS;
+            else if (metric == "nodes") renderOptions.costMetric = COST_METRIC_BVH_NODES;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg[0] != '-') sceneFilePaths.push_back(arg);
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // The final pass has to be an exact multiple of the first one
+    const auto finalScale = 1 << (passCount - 1);
+    const auto requestedWidth = renderWidth;
+    const auto requestedHeight = renderHeight;
+    renderWidth = (renderWidth / finalScale) * finalScale;
+    renderHeight = (renderHeight / finalScale) * finalScale;
+
+    if (renderWidth != requestedWidth || renderHeight != requestedHeight)
+    {
+        cerr << "Warning: " << requestedWidth << " x " << requestedHeight << " isn't a multiple of " << finalScale << " for " << passCount
+             << " passes, rendering at " << renderWidth << " x " << renderHeight << " instead" << endl;
+    }
+
+    if (renderWidth <= 0 || renderHeight <= 0)
+    {
+        cerr << "Error: Invalid render resolution " << renderWidth << " x " << renderHeight << endl;
+        return 1;
+    }
+
+    if (!traceFilePath.empty())
+    {
+        if (!isInstrumentationEnabled())
+        {
+            cerr << "Error: Tracing requires a build with MINTRACER_INSTRUMENTATION defined" << endl;
+            return 1;
+        }
+
+        INSTRUMENT_THREAD_NAME("Main");
+        setInstrumentationTracing(true);
+    }
+
+    if (!isCostMetricSupported(renderOptions.costMetric))
+    {
+        cerr << "Error: The " << getCostMetricName(renderOptions.costMetric) << " heatmap requires a build with MINTRACER_INSTRUMENTATION defined" << endl;
+        return 1;
+    }
+
+    // Checks a scene generated from the seed, without loading any
+    if (benchmarkName == "restore")
+    {
+        return runBVHRestoreCheck(seed, cout) ? 0 : 1;
+    }
+
+    // Loads its scenes itself, each one in turn
+    if (benchmarkName == "scenes")
+    {
+        return runSceneBenchmark(sceneFilePaths, threadCount, renderWidth, renderHeight, benchmarkRepetitions, renderOptions, seed, jsonFilePath, cout) ? 0 : 1;
+    }
+
+    const auto sceneFilePath = sceneFilePaths.empty() ? string() : sceneFilePaths.front();
+    auto sceneName = sceneFilePath.empty() ? string("default scene") : sceneFilePath;
+
+    if (generateSceneFlag)
+    {
+        const auto generateStart = chrono::steady_clock::now();
+
+        generatorSettings.seed = seed;
+        Scene::get().constructFromContents(generateScene(generatorSettings));
+        sceneName = string(getSceneDistributionName(generatorSettings.distribution)) + " scene of " + to_string(generatorSettings.sphereCount) + " sphere(s)";
+
+        const auto generateMs = chrono::duration<f64, milli>(chrono::steady_clock::now() - generateStart).count();
+        cout << "Generated " << sceneName << " with seed " << seed << " in " << generateMs << " ms" << endl;
+    }
+    // Load Scene synchronously, as there is nothing else to do until it is ready
+    else if (!sceneFilePath.empty())
+    {
+        const auto loadStart = chrono::steady_clock::now();
+
+        if (!Scene::get().loadFromFile(sceneFilePath))
+        {
+            cerr << "Error: Could not load scene " << sceneFilePath << endl;
+            return 1;
+        }
+
+        const auto loadMs = chrono::duration<f64, milli>(chrono::steady_clock::now() - loadStart).count();
+        cout << "Loaded " << sceneFilePath << " in " << loadMs << " ms" << endl;
+    }
+
+    if (!convertedSceneFilePath.empty())
+    {
+        if (!Scene::get().saveToFile(convertedSceneFilePath))
+        {
+            cerr << "Error: Could not save scene " << convertedSceneFilePath << endl;
+            return 1;
+        }
+
+        cout << "Finished converting scene to " << convertedSceneFilePath << endl;
+        return 0;
+    }
+
+    if (!benchmarkName.empty())
+    {
+        if (benchmarkName != "packets" && benchmarkName != "wavefront" && benchmarkName != "tileorder" && benchmarkName != "bvh" && benchmarkName != "edit" && benchmarkName != "micro")
+        {
+            cerr << "Error: Unknown benchmark " << benchmarkName << endl;
+            return 1;
+        }
+
+        cout << "Benchmarking " << sceneName << endl;
+        if (benchmarkName == "bvh") return runBVHBenchmark(threadCount, benchmarkRepetitions, cout) ? 0 : 1;
+        if (benchmarkName == "micro") return runMicroBenchmarks(renderWidth, renderHeight, benchmarkRepetitions, seed, jsonFilePath, cout) ? 0 : 1;
+
+        ThreadPool threadPool(threadCount);
+        auto passed = false;
+        if (benchmarkName == "packets") passed = runPacketBenchmark(threadPool, renderWidth, renderHeight, benchmarkRepetitions, cout);
+        else if (benchmarkName == "wavefront") passed = runWavefrontBenchmark(threadPool, renderWidth, renderHeight, benchmarkRepetitions, cout);
+        else if (benchmarkName == "edit") passed = runEditBenchmark(threadPool, renderWidth, renderHeight, benchmarkRepetitions, renderOptions, cout);
+        else passed = runTileOrderBenchmark(threadPool, renderWidth, renderHeight, benchmarkRepetitions, renderOptions, cout);
+        return passed ? 0 : 1;
+    }
+
+    // Wavefronts trace their stage queues in packets as well, unless packets are off or unsupported
+    const auto packets = renderOptions.packetTracing && isPacketTracingSupported();
+    const auto tracingName = renderOptions.wavefront ? (packets ? "wavefront tracing (queues in packets)" : "wavefront tracing (queues ray by ray)")
+                                                     : (packets ? "packet tracing" : "single ray tracing");
+
+    cout << "Rendering " << sceneName << " at "
+         << renderWidth << " x " << renderHeight << " with " << threadCount << " worker(s), "
+         << getSimdLevelName(getSimdLevel()) << " sphere kernels, " << tracingName << ", "
+         << renderOptions.tileSize << " pixel tiles in " << getTileOrderName(renderOptions.tileOrder) << " order" << endl;
+    if (renderOptions.costMetric != COST_METRIC_NONE)
+    {
+        cout << "Measuring " << getCostMetricName(renderOptions.costMetric) << " per pixel, the final pass being traced ray by ray" << endl;
+    }
+
+    // Never set, as the headless renderer always runs to completion
+    const auto renderStopFlag = false;
+
+    ThreadPool threadPool(threadCount);
+    Image previousPass;
+    Image costImage;
+    auto totalElapsedMs = 0.0;
+    auto totalRayCount = 0ULL;
+
+    for (auto pass = 0U; pass < passCount; ++pass)
+    {
+        const auto passScale = finalScale >> pass;
+        Image resultImage(renderWidth / passScale, renderHeight / passScale);
+
+        const auto stats = renderImage(resultImage, threadPool, renderStopFlag, [](const RenderProgress& progress)
+        {
+            cout << "Ray Tracing " << 100 * progress.tilesCompleted / progress.tileCount << "% complete | " 
+                 << progress.tilesCompleted << "/" << progress.tileCount << " tiles | " 
+                 << progress.raysPerSecond / 1e6 << " Mrays/s | ETA " << progress.etaMs / 1000.0 << " s" << endl;
+        }, pass > 0 ? &previousPass : nullptr, passScale, renderOptions, pass + 1 == passCount ? &costImage : nullptr);
+
+        if (passCount > 1)
+        {
+            cout << "Pass " << pass << " (" << resultImage.getWidth() << " x " << resultImage.getHeight() << ")" << endl;
+        }
+        printRenderStats(stats);
+
+        totalElapsedMs += stats.elapsedMs;
+        totalRayCount += stats.rayCount;
+        previousPass = move(resultImage);
+    }
+
+    if (passCount > 1)
+    {
+        cout << "All passes finished - " << totalElapsedMs << " ms elapsed | " << totalRayCount << " rays" << endl;
+    }
+
+    // The last pass rendered is the final one
+    const auto instrumentationBeforeWrite = collectInstrumentation();
+    const auto writeStart = chrono::steady_clock::now();
+    if (!previousPass.writeToBMP(outputFilePath, &threadPool))
+    {
+        cerr << "Error: Could not write " << outputFilePath << endl;
+        return 1;
+    }
+    const auto writeMs = chrono::duration<f64, milli>(chrono::steady_clock::now() - writeStart).count();
+    cout << "Finished writing output to " << outputFilePath << " (" << writeMs << " ms)" << endl;
+    printInstrumentation(collectInstrumentation() - instrumentationBeforeWrite);
+
+    if (renderOptions.costMetric != COST_METRIC_NONE)
+    {
+        const auto extensionIndex = outputFilePath.rfind(".bmp");
+        const auto heatmapFilePath = outputFilePath.substr(0, extensionIndex) + "_heatmap.bmp";
+        const auto whiteCost = costImage.toHeatmap();
+        if (!costImage.writeToBMP(heatmapFilePath, &threadPool))
+        {
+            cerr << "Error: Could not write " << heatmapFilePath << endl;
+            return 1;
+        }
+        cout << "Finished writing the " << getCostMetricName(renderOptions.costMetric) << " heatmap to " << heatmapFilePath
+             << " (white at " << whiteCost << " per pixel and above)" << endl;
+    }
+
+    if (!traceFilePath.empty())
+    {
+        if (!writeChromeTrace(traceFilePath))
+        {
+            cerr << "Error: Could not write " << traceFilePath << endl;
+            return 1;
+        }
+
+        cout << "Trace written to " << traceFilePath << endl;
+    }
+
+    return 0;
+}
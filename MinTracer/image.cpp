@@ -7,9 +7,16 @@
 
 // Local Headers
 #include "image.h"
+#include "threadpool.h"
+#include "instrumentation.h"
 
 // Remote Headers
 #include <fstream>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 #pragma pack(push, 1)
 struct BitmapHeader
@@ -34,33 +41,71 @@ struct BitmapHeader
 #pragma pack(pop)
 
 
+// Rows are padded to a whole number of cache lines
+static const sint32 CACHE_LINE_SIZE = 64;
+static const sint32 ROW_ALIGNMENT_IN_PIXELS = 16; // lcm(CACHE_LINE_SIZE, sizeof(vec3<f32>)) / sizeof(vec3<f32>)
+
 Image::Image()
+    : _pixels(nullptr)
+    , _width(0)
+    , _height(0)
+    , _stride(0)
 {
 }
 
 Image::Image(const sint32 width, const sint32 height)
-    : _width(width)
-    , _height(height)
+    : Image()
+{
+    resize(width, height);
+}
+
+Image::Image(Image&& other)
+    : Image()
+{
+    *this = std::move(other);
+}
+
+Image& Image::operator = (Image&& other)
 {
-    resize(_width, _height);
+    _storage = std::move(other._storage);
+    _pixels = other._pixels;
+    _width = other._width;
+    _height = other._height;
+    _stride = other._stride;
+
+    other._pixels = nullptr;
+    other._width = 0;
+    other._height = 0;
+    other._stride = 0;
+
+    return *this;
 }
 
 void Image::resize(const sint32 width, const sint32 height)
 {
-    _data.resize(height, std::vector<vec3<f32>>(width, 0.0f)); 
     _width = width; 
     _height = height;
+    _stride = ((width + ROW_ALIGNMENT_IN_PIXELS - 1) / ROW_ALIGNMENT_IN_PIXELS) * ROW_ALIGNMENT_IN_PIXELS;
+
+    // Over-allocate, so that the pixels can start on a cache line. 
+    // Zeroed bytes are black pixels, so no per pixel construction is needed.
+    const auto pixelBytes = sizeof(vec3<f32>) * _stride * _height;
+    _storage.reset(new uint8[pixelBytes + CACHE_LINE_SIZE]());
+
+    const auto storageAddress = reinterpret_cast<uintptr_t>(_storage.get());
+    const auto alignedAddress = (storageAddress + CACHE_LINE_SIZE - 1) & ~static_cast<uintptr_t>(CACHE_LINE_SIZE - 1);
+    _pixels = reinterpret_cast<vec3<f32>*>(alignedAddress);
 }
 
-f32 Image::scale(const f32 scaleFactor)
+f32 Image::scale(const f32 scaleFactor, Image& result) const
 {    
+    INSTRUMENT_TRACED_STAGE(STAGE_IMAGE_SCALE);
     const auto roundedScaleFactor = scaleFactor > 1.0f ? roundf(scaleFactor) : (scaleFactor > 0.4f ? 0.5f : 0.25f);
     
     // Determine the target dimensions of the scaled image, be it upscaled or downscaleed
-    std::vector<std::vector<vec3<f32>>> resultData;
     const auto resultWidth = static_cast<sint32>(_width * roundedScaleFactor);
     const auto resultHeight = static_cast<sint32>(_height * roundedScaleFactor);
-    resultData.resize(resultHeight, std::vector<vec3<f32>>(resultWidth, 0.0f));    
+    result.resize(resultWidth, resultHeight);
     
     const auto invScaleFactor = 1.0f / roundedScaleFactor;
 
@@ -72,13 +117,17 @@ f32 Image::scale(const f32 scaleFactor)
 
         for (auto y = step - 1; y < _height; y += step)
         {
+            auto* resultRow = result[y / step];
+
             for (auto x = step - 1; x < _width; x += step)
             {
                 for (auto j = -step + 1; j < 1; ++j)
                 {
+                    const auto* row = (*this)[y + j];
+
                     for (auto i = -step + 1; i < 1; ++i)
                     {
-                        resultData[y / step][x / step] += _data[y + j][x + i] * weight;
+                        resultRow[x / step] += row[x + i] * weight;
                     }
                 }
             }
@@ -87,26 +136,77 @@ f32 Image::scale(const f32 scaleFactor)
     // Upscaling (Nearest Neighbour)
     else
     {        
-        
+        const auto step = static_cast<uint32>(roundedScaleFactor);
+
         for (auto y = 0; y < resultHeight; ++y)
         {
+            const auto* row = (*this)[minu(_height - 1, y / step)];
+            auto* resultRow = result[y];
+
             for (auto x = 0; x < resultWidth; ++x)
             {                                
-                resultData[y][x] = _data[minu(_height - 1, y / static_cast<uint32>(roundedScaleFactor))]
-                                        [minu(_width - 1, x / static_cast<uint32>(roundedScaleFactor))];
+                resultRow[x] = row[minu(_width - 1, x / step)];
             }
         }
     }
 
-    _data = resultData;
-    _width = resultWidth;
-    _height = resultHeight;
+    return roundedScaleFactor;
+}
 
+f32 Image::scale(const f32 scaleFactor)
+{
+    Image result;
+    const auto roundedScaleFactor = scale(scaleFactor, result);
+    *this = std::move(result);
     return roundedScaleFactor;
 }
 
+f32 Image::toHeatmap()
+{
+    std::vector<f32> costs;
+    costs.reserve(static_cast<size_t>(_width) * _height);
+    for (auto y = 0; y < _height; ++y)
+    {
+        const auto* row = (*this)[y];
+        for (auto x = 0; x < _width; ++x)
+        {
+            costs.push_back(row[x].x);
+        }
+    }
+
+    if (costs.empty()) return 0.0f;
+
+    const auto percentile = costs.begin() + (costs.size() - 1) * 99 / 100;
+    std::nth_element(costs.begin(), percentile, costs.end());
+    const auto whiteCost = *percentile;
+    const auto invWhiteCost = whiteCost > 0.0f ? 1.0f / whiteCost : 0.0f;
+
+    static const vec3<f32> RAMP[] = 
+    {
+        vec3<f32>(0.0f, 0.0f, 0.0f),
+        vec3<f32>(0.0f, 0.0f, 1.0f),
+        vec3<f32>(1.0f, 0.0f, 0.0f),
+        vec3<f32>(1.0f, 1.0f, 0.0f),
+        vec3<f32>(1.0f, 1.0f, 1.0f)
+    };
+    const auto rampSegments = static_cast<f32>(sizeof(RAMP) / sizeof(RAMP[0]) - 1);
+
+    for (auto y = 0; y < _height; ++y)
+    {
+        auto* row = (*this)[y];
+        for (auto x = 0; x < _width; ++x)
+        {
+            const auto position = minf(1.0f, row[x].x * invWhiteCost) * rampSegments;
+            const auto segment = minu(static_cast<uint32>(position), static_cast<uint32>(rampSegments) - 1);
+            const auto weight = position - segment;
+            row[x] = RAMP[segment] * (1.0f - weight) + RAMP[segment + 1] * weight;
+        }
+    }
 
-void Image::writeToBMP(const std::string& fileName)
+    return whiteCost;
+}
+
+bool Image::writeToBMP(const std::string& fileName, ThreadPool* threadPool) const
 {    
     const auto outputPixelsSize = sizeof(uint32) * _width * _height;
 
@@ -125,17 +225,47 @@ void Image::writeToBMP(const std::string& fileName)
 
     if (outputFile.good())
     {
-        outputFile.write(reinterpret_cast<char*>(&bmh), sizeof(BitmapHeader));
+        // The whole file is assembled in memory first
+        std::unique_ptr<uint8[]> fileContents(new uint8[sizeof(BitmapHeader) + outputPixelsSize]);
+        memcpy(fileContents.get(), &bmh, sizeof(BitmapHeader));
 
-        for (auto y = 0; y < _height; ++y)
+        auto* outputPixels = reinterpret_cast<uint32*>(fileContents.get() + sizeof(BitmapHeader));
+        auto convertRows = [this, outputPixels](const sint32 y0, const sint32 y1)
         {
-            for (auto x = 0; x < _width; ++x)
+            INSTRUMENT_TRACED_STAGE(STAGE_BITMAP_CONVERSION);
+            for (auto y = y0; y < y1; ++y)
             {
-                auto val = vec3toARGB(_data[y][x]);
-                outputFile.write(reinterpret_cast<char*>(&val), sizeof(uint32));
+                const auto* row = (*this)[y];
+                auto* outputRow = outputPixels + static_cast<size_t>(y) * _width;
+
+                for (auto x = 0; x < _width; ++x)
+                {
+                    outputRow[x] = vec3toARGB(row[x]);
+                }
             }
+        };
+
+        // Each worker converts a contiguous band of rows
+        if (threadPool)
+        {
+            const auto workerCount = threadPool->getThreadCount();
+            threadPool->dispatch([this, &convertRows, workerCount](const uint32 i)
+            {
+                convertRows(static_cast<sint32>((static_cast<uint64>(_height) * i) / workerCount),
+                            static_cast<sint32>((static_cast<uint64>(_height) * (i + 1)) / workerCount));
+            });
+            threadPool->wait();
         }
+        else
+        {
+            convertRows(0, _height);
+        }
+
+        INSTRUMENT_TRACED_STAGE(STAGE_BMP_WRITE);
+        outputFile.write(reinterpret_cast<char*>(fileContents.get()), sizeof(BitmapHeader) + outputPixelsSize);
     }
 
+    // Closing flushes the file, which can fail as well
     outputFile.close();
+    return !outputFile.fail();
 }
\ No newline at end of file
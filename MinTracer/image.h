@@ -11,27 +11,83 @@
 #include "math.h"
 
 // Remote Headers
-#include <vector>
+#include <string>
+#include <memory>
 
+class ThreadPool;
+
+// Non-owning view of a rectangular region of an Image, e.g. a render tile.
+// Pixels are addressed relative to the region's top left corner.
+class ImageView
+{
+public:
+    ImageView(vec3<f32>* pixels, const sint32 width, const sint32 height, const sint32 stride)
+        : _pixels(pixels)
+        , _width(width)
+        , _height(height)
+        , _stride(stride)
+    {
+    }
+
+    inline vec3<f32>* operator[] (const size_t y) const { return _pixels + y * _stride; }
+
+    inline sint32 getWidth() const { return _width; }
+    inline sint32 getHeight() const { return _height; }
+
+private:
+    vec3<f32>* _pixels;
+    sint32 _width, _height;
+    sint32 _stride;
+};
+
+// Images are backed by a single contiguous buffer, with every row starting 
+// on a cache line. Being hundreds of MBs at the higher resolutions, they 
+// can only be moved around and are never implicitly copied.
 class Image
 {
 public:    
     Image();
     Image(const sint32 width, const sint32 height);
+
+    Image(Image&& other);
+    Image& operator = (Image&& other);
     
-    inline const std::vector<vec3<f32>>& operator[] (const size_t i) const { return _data[i]; }
-    inline std::vector<vec3<f32>>& operator[] (const size_t i) { return _data[i]; }
+    Image(const Image&) = delete;
+    Image& operator = (const Image&) = delete;
+    
+    // Row views
+    inline const vec3<f32>* operator[] (const size_t y) const { return _pixels + y * _stride; }
+    inline vec3<f32>* operator[] (const size_t y) { return _pixels + y * _stride; }
 
     inline sint32 getWidth() const { return _width; }
     inline sint32 getHeight() const { return _height; }
-    inline vec3<f32> getPixel(const uint32 x, const uint32 y) const { return _data[y][x]; }
-    inline void setPixel(const uint32 x, const uint32 y, const f32& val) { _data[y][x] = val; }
+    inline sint32 getStride() const { return _stride; }
+    inline vec3<f32> getPixel(const uint32 x, const uint32 y) const { return (*this)[y][x]; }
+    inline void setPixel(const uint32 x, const uint32 y, const f32& val) { (*this)[y][x] = val; }
+
+    // View of the [x0, x1) x [y0, y1) region
+    inline ImageView getView(const sint32 x0, const sint32 y0, const sint32 x1, const sint32 y1) { return ImageView((*this)[y0] + x0, x1 - x0, y1 - y0, _stride); }
     
+    // Reallocates the image, discarding its contents
     void resize(const sint32 width, const sint32 height);
+
+    // Scales the image into result, returning the scale factor actually applied
+    f32 scale(const f32 scaleFactor, Image& result) const;
     f32 scale(const f32 scaleFactor);
-    void writeToBMP(const std::string& fileName);
+
+    // Turns costs stored in the first channel (e.g. by renderImage) into a heatmap, ramping from
+    // black through blue, red and yellow to white. The ramp is scaled so that the 99th percentile
+    // cost reaches white, which keeps a few outliers from washing out the rest. Returns that cost.
+    f32 toHeatmap();
+
+    // Writes a 32bpp top-down BMP. The pixel conversion is split amongst
+    // the workers of threadPool, if given, and the file is written at once.
+    // Returns false if the file couldn't be written.
+    bool writeToBMP(const std::string& fileName, ThreadPool* threadPool = nullptr) const;
 
 private:
-    std::vector<std::vector<vec3<f32>>> _data;
+    std::unique_ptr<uint8[]> _storage;
+    vec3<f32>* _pixels;
     sint32 _width, _height;
-};
+    sint32 _stride;
+};
\ No newline at end of file
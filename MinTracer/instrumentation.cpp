@@ -0,0 +1,166 @@
+/*************************************************************************/
+/** instrumentation.cpp by Alex Koukoulas (C) 2017 All Rights Reserved **/
+/** File Description: Implementation of the instrumentation registry   **/
+/** and of its Chrome trace export                                     **/
+/*************************************************************************/
+
+// Local Headers
+#include "instrumentation.h"
+#include "strutils.h"
+
+// Remote Headers
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+// Every thread instrumented so far, in the order they were first instrumented in
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<ThreadInstrumentation>> registeredThreads;
+
+static std::atomic<bool> tracing(false);
+
+const char* getInstrumentationCounterName(const InstrumentationCounter counter)
+{
+    switch (counter)
+    {
+        case COUNTER_SPHERE_TESTS: return "sphere tests";
+        case COUNTER_PLANE_TESTS: return "plane tests";
+        case COUNTER_BVH_NODES_VISITED: return "BVH nodes visited";
+        default: return "unknown";
+    }
+}
+
+const char* getInstrumentationStageName(const InstrumentationStage stage)
+{
+    switch (stage)
+    {
+        case STAGE_BVH_BUILD: return "BVH build";
+        case STAGE_TILE: return "tile";
+        case STAGE_PRIMARY_INTERSECTION: return "primary intersection";
+        case STAGE_SHADOW_RAYS: return "shadow rays";
+        case STAGE_REFLECTION: return "reflection";
+        case STAGE_REFRACTION: return "refraction";
+        case STAGE_IMAGE_SCALE: return "Image::scale";
+        case STAGE_BITMAP_CONVERSION: return "bitmap conversion";
+        case STAGE_BMP_WRITE: return "BMP write";
+        default: return "unknown";
+    }
+}
+
+InstrumentationTotals operator - (const InstrumentationTotals& a, const InstrumentationTotals& b)
+{
+    InstrumentationTotals result;
+    for (auto i = 0U; i < COUNTER_COUNT; ++i)
+    {
+        result.counters[i] = a.counters[i] - b.counters[i];
+    }
+
+    for (auto i = 0U; i < STAGE_COUNT; ++i)
+    {
+        result.stageNs[i] = a.stageNs[i] - b.stageNs[i];
+        result.stageCalls[i] = a.stageCalls[i] - b.stageCalls[i];
+    }
+    return result;
+}
+
+bool isInstrumentationEnabled()
+{
+#if defined(MINTRACER_INSTRUMENTATION)
+    return true;
+#else
+    return false;
+#endif
+}
+
+InstrumentationTotals collectInstrumentation()
+{
+    InstrumentationTotals result;
+    if (!isInstrumentationEnabled()) return result;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& threadInstrumentation: registeredThreads)
+    {
+        const auto& totals = threadInstrumentation->totals;
+        for (auto i = 0U; i < COUNTER_COUNT; ++i)
+        {
+            result.counters[i] += totals.counters[i];
+        }
+
+        for (auto i = 0U; i < STAGE_COUNT; ++i)
+        {
+            result.stageNs[i] += totals.stageNs[i];
+            result.stageCalls[i] += totals.stageCalls[i];
+        }
+    }
+    return result;
+}
+
+void setInstrumentationTracing(const bool tracingEnabled)
+{
+    tracing.store(tracingEnabled, std::memory_order_relaxed);
+}
+
+bool isInstrumentationTracing()
+{
+    return tracing.load(std::memory_order_relaxed);
+}
+
+void nameInstrumentationThread(const std::string& name)
+{
+    auto& threadInstrumentation = getThreadInstrumentation();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    threadInstrumentation.name = name;
+}
+
+std::shared_ptr<ThreadInstrumentation> registerThreadInstrumentation()
+{
+    auto threadInstrumentation = std::make_shared<ThreadInstrumentation>();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registeredThreads.push_back(threadInstrumentation);
+    return threadInstrumentation;
+}
+
+bool writeChromeTrace(const std::string& filePath)
+{
+    std::ofstream file(filePath);
+    if (!file) return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // Timestamps are relative to the earliest event, in microseconds as the format has them
+    auto firstStartNs = ~0ULL;
+    for (const auto& threadInstrumentation: registeredThreads)
+    {
+        for (const auto& event: threadInstrumentation->events)
+        {
+            firstStartNs = std::min<uint64>(firstStartNs, event.startNs);
+        }
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    auto firstEvent = true;
+    for (auto thread = 0U; thread < registeredThreads.size(); ++thread)
+    {
+        const auto& threadInstrumentation = *registeredThreads[thread];
+        if (threadInstrumentation.events.empty()) continue;
+
+        const auto name = threadInstrumentation.name.empty() ? "Thread " + std::to_string(thread) : threadInstrumentation.name;
+        file << (firstEvent ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+             << ",\"args\":{\"name\":" << strutils::toJsonString(name) << "}}";
+        firstEvent = false;
+
+        for (const auto& event: threadInstrumentation.events)
+        {
+            file << ",\n{\"name\":" << strutils::toJsonString(getInstrumentationStageName(static_cast<InstrumentationStage>(event.stage)))
+                 << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+                 << ",\"ts\":" << (event.startNs - firstStartNs) / 1000.0
+                 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    return static_cast<bool>(file);
+}
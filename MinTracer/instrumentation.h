@@ -0,0 +1,167 @@
+/**********************************************************************/
+/** instrumentation.h by Alex Koukoulas (C) 2017 All Rights Reserved **/
+/** File Description: Interface to the compile time switchable hot   **/
+/** path counters and stage timers, and their Chrome trace export    **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Instrumentation is only compiled in when MINTRACER_INSTRUMENTATION is defined (in the project's
+// preprocessor definitions, or -DMINTRACER_INSTRUMENTATION). Otherwise the INSTRUMENT_ macros
+// expand to nothing, without even evaluating their arguments, and the hot paths are exactly as
+// they would be without them. Every thread counts into its own counters, which are only summed
+// up once collected, so instrumented threads never contend with each other.
+
+enum InstrumentationCounter
+{
+    COUNTER_SPHERE_TESTS,       // Ray sphere tests, a packet test counting once per lane tested
+    COUNTER_PLANE_TESTS,        // Ray plane tests, likewise
+    COUNTER_BVH_NODES_VISITED,  // BVH nodes popped off a traversal stack, a packet's counting once
+    COUNTER_COUNT
+};
+
+// Stages of the render and of the image output. Stages nest, and each one's time includes the
+// stages within it, e.g. the shadow rays of reflected hits are part of the reflection stage too.
+enum InstrumentationStage
+{
+    STAGE_BVH_BUILD,
+    STAGE_TILE,
+    STAGE_PRIMARY_INTERSECTION,
+    STAGE_SHADOW_RAYS,
+    STAGE_REFLECTION,
+    STAGE_REFRACTION,
+    STAGE_IMAGE_SCALE,
+    STAGE_BITMAP_CONVERSION,
+    STAGE_BMP_WRITE,
+    STAGE_COUNT
+};
+
+const char* getInstrumentationCounterName(const InstrumentationCounter counter);
+const char* getInstrumentationStageName(const InstrumentationStage stage);
+
+// Counters and stage times, of a single thread or summed over all of them
+struct InstrumentationTotals
+{
+    uint64 counters[COUNTER_COUNT];
+    uint64 stageNs[STAGE_COUNT];
+    uint64 stageCalls[STAGE_COUNT];
+
+    InstrumentationTotals()
+        : counters()
+        , stageNs()
+        , stageCalls()
+    {
+    }
+};
+
+InstrumentationTotals operator - (const InstrumentationTotals& a, const InstrumentationTotals& b);
+
+// True if built with MINTRACER_INSTRUMENTATION, in which case everything below is recorded
+bool isInstrumentationEnabled();
+
+// Totals of every thread instrumented so far. Only exact while no instrumented work is running,
+// e.g. in between renders. Always zero when instrumentation is disabled.
+InstrumentationTotals collectInstrumentation();
+
+// Traced stages are also recorded as timeline events while tracing is on (off by default).
+// Stages traced once per ray would swamp the timeline, and are hence only ever aggregated.
+void setInstrumentationTracing(const bool tracing);
+bool isInstrumentationTracing();
+
+// Names the calling thread on the timeline, where unnamed threads show up by their index
+void nameInstrumentationThread(const std::string& name);
+
+// Writes the events recorded so far in the Chrome trace event format, which both chrome://tracing
+// and Perfetto open, with a track per thread. Like collecting, only to be done while no instrumented
+// work is running. Returns false if the file couldn't be written.
+bool writeChromeTrace(const std::string& filePath);
+
+struct TraceEvent
+{
+    uint32 stage;
+    uint64 startNs;
+    uint64 durationNs;
+};
+
+struct ThreadInstrumentation
+{
+    InstrumentationTotals totals;
+    std::vector<TraceEvent> events;
+    std::string name;
+};
+
+// The calling thread's instrumentation, registered on first use and kept alive past the thread
+std::shared_ptr<ThreadInstrumentation> registerThreadInstrumentation();
+
+inline ThreadInstrumentation& getThreadInstrumentation()
+{
+    static thread_local const auto threadInstrumentation = registerThreadInstrumentation();
+    return *threadInstrumentation;
+}
+
+class ScopedStageTimer final
+{
+public:
+    ScopedStageTimer(const InstrumentationStage stage, const bool traced)
+        : _stage(stage)
+        , _traced(traced && isInstrumentationTracing())
+        , _start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedStageTimer()
+    {
+        const auto end = std::chrono::steady_clock::now();
+        const auto durationNs = static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count());
+
+        auto& threadInstrumentation = getThreadInstrumentation();
+        threadInstrumentation.totals.stageNs[_stage] += durationNs;
+        threadInstrumentation.totals.stageCalls[_stage]++;
+
+        if (_traced)
+        {
+            const auto startNs = static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(_start.time_since_epoch()).count());
+            threadInstrumentation.events.push_back({ static_cast<uint32>(_stage), startNs, durationNs });
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator = (const ScopedStageTimer&) = delete;
+
+private:
+    const InstrumentationStage _stage;
+    const bool _traced;
+    const std::chrono::steady_clock::time_point _start;
+};
+
+#if defined(MINTRACER_INSTRUMENTATION)
+
+#define INSTRUMENT_JOIN_NAME(a, b) a##b
+#define INSTRUMENT_UNIQUE_NAME(a, b) INSTRUMENT_JOIN_NAME(a, b)
+
+// Adds amount to the calling thread's counter
+#define INSTRUMENT_COUNT(counter, amount) (getThreadInstrumentation().totals.counters[counter] += (amount))
+
+// Times the rest of the enclosing scope as the given stage, and with TRACED records it on the timeline as well
+#define INSTRUMENT_STAGE(stage) const ScopedStageTimer INSTRUMENT_UNIQUE_NAME(stageTimer, __LINE__)(stage, false)
+#define INSTRUMENT_TRACED_STAGE(stage) const ScopedStageTimer INSTRUMENT_UNIQUE_NAME(stageTimer, __LINE__)(stage, true)
+
+#define INSTRUMENT_THREAD_NAME(name) nameInstrumentationThread(name)
+
+#else
+
+#define INSTRUMENT_COUNT(counter, amount) ((void)0)
+#define INSTRUMENT_STAGE(stage) ((void)0)
+#define INSTRUMENT_TRACED_STAGE(stage) ((void)0)
+#define INSTRUMENT_THREAD_NAME(name) ((void)0)
+
+#endif
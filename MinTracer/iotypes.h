@@ -0,0 +1,22 @@
+/*********************************************************************/
+/** iotypes.h by Alex Koukoulas (C) 2017 All Rights Reserved        **/
+/** File Description: Platform agnostic result types and callbacks  **/
+/** used by the asynchronous scene IO operations                    **/
+/*********************************************************************/
+
+#pragma once
+
+// Local Headers
+
+// Remote Headers
+#include <functional>
+
+namespace io
+{
+    enum IO_RESULT_TYPE
+    {
+        SUCCESS, FAILURE
+    };
+
+    using io_result_callback = std::function<void(const IO_RESULT_TYPE)>;
+}
@@ -1,7 +1,7 @@
 /**********************************************************************/
 /** main.cpp by Alex Koukoulas (C) 2017 All Rights Reserved          **/
-/** File Description: Main entry point, containing the bulk of the   **/
-/** Ray tracing code                                                 **/
+/** File Description: Main entry point of the win32 GUI, driving the **/
+/** progressive rendering of the scene to the main window            **/
 /**********************************************************************/
 
 #if defined(DEBUG) || defined(_DEBUG)
@@ -12,9 +12,9 @@
 #include <string>
 #include <memory>
 #include <vector>
-#include <chrono>
 #include <thread>
-#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <iomanip>
 
 #include "win32gui.h"
@@ -22,358 +22,52 @@
 #include "typedefs.h"
 #include "math.h"
 #include "image.h"
-
-static const f32 T_MIN = 0.01f;
-static const f32 T_MAX = 100.0f;
+#include "raytracer.h"
+#include "threadpool.h"
 
 using namespace std;
 
-// HitInfo is essentially the info storage Struct 
-// for each Ray being cast
-struct HitInfo
-{
-    bool hit;
-    vec3<f32> position;
-    vec3<f32> normal;
-    uint8 surfaceMatIndex;
-    f32 t;
-
-    HitInfo(const bool hit, 
-            const vec3<f32>& position, 
-            const vec3<f32>& normal,
-            const uint8& surfaceMatIndex,
-            const f32 t)
-        : hit(hit)
-        , position(position)
-        , normal(normal)
-        , surfaceMatIndex(surfaceMatIndex)
-        , t(t)
-    {
-    }
-};
-
-HitInfo rayPlaneIntersectionTest(const Ray& ray, const Plane& plane)
-{
-    const auto denom = dot(plane.normal, ray.direction);
-
-    if (denom > 1e-6f || denom < -1e-6f)
-    {
-        const auto t = -(plane.d + (dot(plane.normal, ray.origin)))/denom;
-        if (t > 0.0f)
-        {
-            const auto hitPos = ray.origin + ray.direction * t;
-            return HitInfo(true, hitPos, plane.normal, plane.matIndex, t);                        
-        }        
-    }
-
-    return HitInfo(false, vec3<f32>(), vec3<f32>(), 0, T_MAX);
-}
-
-HitInfo raySphereIntersectionTest(const Ray& ray, const Sphere& sphere)
-{
-    const auto toRay = ray.origin - sphere.center;
-
-    const auto a = dot(ray.direction, ray.direction);
-    const auto b = 2.0f * dot(toRay, ray.direction);
-    const auto c = dot(toRay, toRay) - sphere.radius * sphere.radius;
-    const auto det = b * b - 4 * a * c;
-
-    if (det > 0.0f)
-    {
-        const auto minT = (-b - sqrtf(det)) / 2 * a;
-        const auto maxT = (-b + sqrtf(det)) / 2 * a;
-        const auto selT = minT > 0.0f ? minT : (maxT > 0.0f ? maxT : 0.0f);
-
-        if (selT > 0.0f)
-        {
-            const auto hitPos = ray.origin + ray.direction * selT;
-            auto normal = normalize(hitPos - sphere.center);
-
-            if (length(ray.origin - sphere.center) < sphere.radius)
-            {
-                normal = -normal;
-            }
-
-            return HitInfo(true, hitPos, normal, sphere.matIndex, selT);
-        }                
-    }
-    
-    return HitInfo(false, vec3<f32>(), vec3<f32>(), 0, T_MAX);
-}
-
-HitInfo intersectScene(const Ray& ray)
-{
-    HitInfo closestHitInfo(false, vec3<f32>(), vec3<f32>(), 0, T_MAX);
-    
-    const auto sphereCount = Scene::get().getSphereCount();
-    for (auto i = 0U; i < sphereCount; ++i)
-    {
-        auto hitInfo = raySphereIntersectionTest(ray, Scene::get().getSphere(i));
-
-        if (hitInfo.hit && hitInfo.t < closestHitInfo.t)
-        {            
-            closestHitInfo = hitInfo;
-        }
-    }
-
-    const auto planeCount = Scene::get().getPlaneCount();
-    for (auto i = 0U; i < planeCount; ++i)
-    {
-        auto hitInfo = rayPlaneIntersectionTest(ray, Scene::get().getPlane(i));
-
-        if (hitInfo.hit && hitInfo.t < closestHitInfo.t)
-        {            
-            closestHitInfo = hitInfo;
-        }
-    }
-
-    return closestHitInfo;
-}
-
-vec3<f32> shade(const Ray& ray, const Light& light, const HitInfo& hitInfo)
-{    
-    vec3<f32> colorAccum;
-
-    const auto epsilon = 1e-5f;
-    const auto displacedHitPos = hitInfo.position + hitInfo.normal * epsilon;
-
-    const auto hitToLight = normalize(light.position - displacedHitPos);    
-    const auto viewDir = normalize(displacedHitPos - ray.origin);
-    const auto reflDir = normalize(viewDir - hitInfo.normal * dot(viewDir, hitInfo.normal) * 2.0f);
-    
-    const auto diffuseTerm = max(0.0f, dot(hitInfo.normal, hitToLight));
-    const auto& material = Scene::get().getMaterial(hitInfo.surfaceMatIndex);
-    const auto specularTerm = powf(max(0.0f, dot(reflDir, hitToLight)), material.glossiness);
-
-    colorAccum += (material.diffuse * light.color) * diffuseTerm;    
-    if (light.getLightType() == Light::POINT_LIGHT)
-    {                
-        // This downcast might cause issues if it executes concurrently with
-        // reconstructing the scene from an existing file, due to the way
-        // stubs are returned during construction.
-        colorAccum /= 4 * PI * static_cast<const PointLight&>(light).radius;
-    }
-
-    colorAccum += (material.specular * light.color) * specularTerm;    
-    
-
-    const auto lightHitInfo = intersectScene(Ray(hitToLight, displacedHitPos));        
-    const auto displacedLightHitPos = lightHitInfo.position + lightHitInfo.normal * epsilon;
-
-    // Shadow test
-    if (lightHitInfo.hit)
-    {                                                                
-        auto visibility = 1.0f;
-
-        const auto prevHitToLight = light.position - displacedHitPos;
-        const auto revHitToLight = light.position - displacedLightHitPos;
-        const auto originalHitToLightMag = length(prevHitToLight);
-        const auto reverseIntersectionHitToLightMag = length(revHitToLight);
-            
-        // In order to cancel visibility, i.e. the object is in shadow, we need to make sure that there
-        // exists an object inbetween the original hit object and the light's position
-        const auto objectInBetweenHitInfoAndLight = (originalHitToLightMag - reverseIntersectionHitToLightMag) > 1e-6f;            
-        const auto objectNotBehindLight = dot(normalize(prevHitToLight), normalize(revHitToLight)) >= 1.0f - 1e-6f;
-
-        // Enshadow only if the above conditions are satisfied
-        visibility = objectInBetweenHitInfoAndLight && objectNotBehindLight ? 0.0f : 1.0f;
-        colorAccum *= visibility;        
-    }            
-
-    return colorAccum;
-}
-
-vec3<f32> traceForEachLight(const Ray& ray, const HitInfo& hitInfo)
-{
-    if (!hitInfo.hit) return vec3<f32>();
-
-    vec3<f32> fragment = Scene::get().getMaterial(hitInfo.surfaceMatIndex).ambient;
-
-    const auto lightCount = Scene::get().getLightCount();
-    for (auto i = 0U; i < lightCount; ++i)
-    {
-        fragment += shade(ray, Scene::get().getLight(i), hitInfo);
-    }    
-
-    return fragment;
-}
-
-f32 fresnel(const Ray& ray, const vec3<f32>& normal, const f32 ior)
-{
-    return powf(1.0f - dot(-ray.direction, normal), Scene::get().getFresnelPower());
-}
-
-vec3<f32> trace(const Ray& ray)
-{    
-    auto initialRay = ray;
-    auto initialHitInfo = intersectScene(ray);    
-
-    auto currentRay = initialRay;
-    auto currentHitInfo = initialHitInfo;
-    auto currentFragColor = traceForEachLight(currentRay, currentHitInfo);
-    auto reflectionWeight = 1.0f;
-
-    // Compute Reflection
-    const auto reflectionCount = Scene::get().getReflectionCount();
-    for (auto i = 0U; i < reflectionCount; ++i)
-    {
-        if (!currentHitInfo.hit) break;
-
-        reflectionWeight *= Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).reflectivity > 0.0f ? 0.5f : 0.0f;
-                
-        const auto reflectionDir = normalize(ray.direction - currentHitInfo.normal * dot(ray.direction, currentHitInfo.normal) * 2.0f);
-        const auto epsilon = 1e-3f;
-        auto fresnelKr = 1.0f;
-        
-        if (Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).refractivity > 1.0f)
-        {
-            fresnelKr = fresnel(currentRay, currentHitInfo.normal, Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).refractivity);
-        }        
-
-        currentRay = Ray(reflectionDir, currentHitInfo.position + epsilon * reflectionDir);
-        currentHitInfo = intersectScene(currentRay);        
-        currentFragColor += (reflectionWeight * fresnelKr) * traceForEachLight(currentRay, currentHitInfo);
-    }
-
-    // Compute Refraction
-    const auto refractionCount = Scene::get().getRefractionCount();
-    auto refractionWeight = 1.0f;
-    currentRay = initialRay;    
-    currentHitInfo = initialHitInfo;
-    for (auto i = 0U; i < refractionCount; ++i)
-    {
-        if (!currentHitInfo.hit) break;
-
-        refractionWeight *= Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).refractivity > 1.0f ? 0.5f : 0.0f;
-        
-        
-        auto cosi = dot(currentRay.direction, currentHitInfo.normal);                        
-
-        auto etaAir = 1.0f;
-        auto etaT = Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).refractivity;
-        auto n = currentHitInfo.normal;
-
-        if (cosi < 0.0f)
-        {
-            cosi = -cosi;
-        }
-        else
-        {
-            swap(etaAir, etaT);
-            n = -currentHitInfo.normal;
-        }
-
-        const auto eta = etaAir/etaT;
-        const auto k = 1 - eta * eta * (1 - cosi * cosi);
-        const auto refractionDir = k < 0.0f ? vec3<f32>() : eta * currentRay.direction + (eta * cosi - sqrtf(k)) * n;
-        const auto epsilon = 1e-3f;
-        
-        auto fresnelKt = 1.0f;
-
-        if (Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).reflectivity > 0.0f)
-        {
-            fresnelKt = 1.0f - fresnel(currentRay, currentHitInfo.normal, Scene::get().getMaterial(currentHitInfo.surfaceMatIndex).refractivity);
-        }
-
-        currentRay = Ray(refractionDir, currentHitInfo.position + epsilon * refractionDir);
-        currentHitInfo = intersectScene(currentRay);                
-        currentFragColor += (refractionWeight * fresnelKt) * traceForEachLight(currentRay, currentHitInfo);
-    }
-
-    return currentFragColor;
-}
-
 void render(const sint32 currentRenderWidth,
             const sint32 currentRenderHeight, 
             const sint32 endGoalWidth, 
             const sint32 endGoalHeight, 
             const bool& renderStopFlag,
+            const uint32 finalScale,
+            Image& previousPass,
+            ThreadPool& threadPool,
+            const bool costHeatmap,
             HWND windowHandle)
 {
     // Initilize ray tracing result
     Image resultImage(currentRenderWidth, currentRenderHeight);    
 
-    // Compute ray direction parameters    
-    const auto invWidth = 1.0f / currentRenderWidth;
-    const auto invHeight = 1.0f / currentRenderHeight;
-    const auto fov = PI / 3.0f; 
-    const auto aspect = static_cast<f32>(currentRenderWidth) / currentRenderHeight;
-    const auto angle = tan(fov * 0.5f);
+    // Preview passes get the quickly built LBVH, so that edits show up without delay, and only 
+    // the final pass waits for the SAH built one (which each snapshot keeps, alongside the LBVH)
+    RenderOptions options;
+    options.bvhBuilder = finalScale > 1 ? BVH_BUILDER_LBVH : BVH_BUILDER_BINNED_SAH;
 
-    // Could probably parameterize worker count
-    const auto threadCount = 2;    
-    const auto renderStart = chrono::steady_clock::now();
-    
-    // Debug-specific thread, announcing Ray tracing completion percentages
-    atomic_long rowsRendered = 0;
-    thread announcer([&rowsRendered, &renderStopFlag, currentRenderHeight]()
-    {
-#if defined(DEBUG) || defined(_DEBUG)
-        auto currentPercent = 0;
-        while (rowsRendered != currentRenderHeight)
-        {
-            if (renderStopFlag) return;
+    // The heatmap of how long each pixel took to trace, written next to the rendering
+    Image costImage;
+    options.costMetric = costHeatmap ? COST_METRIC_CYCLES : COST_METRIC_NONE;
 
-            const auto completedPerc = static_cast<uint32>(100 * (static_cast<f32>(rowsRendered) / currentRenderHeight));
-            if (currentPercent != completedPerc)
-            {
-                currentPercent = completedPerc;
-                OutputDebugString(string("Ray Tracing " + to_string(currentPercent) + "% complete\n").c_str());
-            }
-        }
-#endif
-    });
-
-    // Main Ray-tracing workers
-    thread workers[threadCount];
-    for (auto i = 0; i < threadCount; ++i)
+    // Samples of the previous pass are reused, if it is part of the same refinement sequence
+    const auto stats = renderImage(resultImage, threadPool, renderStopFlag, [](const RenderProgress& progress)
     {
-        // Divide work amongst threads
-        const auto workPerThread = currentRenderHeight / threadCount;
-        auto currentThreadWork = workPerThread;
+        OutputDebugString(string("Ray Tracing " + to_string(100 * progress.tilesCompleted / progress.tileCount) + "% complete | " + 
+                                 to_string(progress.tilesCompleted) + "/" + to_string(progress.tileCount) + " tiles | " + 
+                                 to_string(progress.raysPerSecond / 1e6) + " Mrays/s | ETA " + to_string(progress.etaMs / 1000.0) + " s\n").c_str());
+    }, &previousPass, finalScale, options, costHeatmap ? &costImage : nullptr);
 
-        // The last thread also gets any outstanding work if present
-        if (i == threadCount - 1 && currentRenderHeight % workPerThread != 0)
-        {
-            currentThreadWork += currentRenderHeight % workPerThread;
-        }
-    
-        workers[i] = thread([&resultImage, &rowsRendered, &renderStopFlag, i, workPerThread, currentThreadWork, currentRenderWidth, invWidth, invHeight, angle, aspect]()
-        {
-            for (auto y = i * workPerThread; y < i * workPerThread + currentThreadWork && !renderStopFlag; ++y)
-            {
-                for (auto x = 0; x < currentRenderWidth; ++x)
-                {            
-                    // Transform to normalized coordinates
-                    const auto xx = (2 * ((x + 0.5f) * invWidth) - 1) * angle * aspect;
-                    const auto yy = (1 - 2 * ((y + 0.5f) * invHeight)) * angle;
-                    
-                    // Compute ray direction
-                    vec3<f32> rayDirection(xx, yy, -1.0f);
-                    rayDirection = normalize(rayDirection);
-
-                    // Perform Ray tracing
-                    Ray ray(rayDirection, vec3<f32>());
-                    resultImage[y][x] = trace(ray);                    
-                }
-                rowsRendered++;
-            }
-        });
-    }
-
-    for (auto i = 0; i < threadCount; ++i)
-    {
-        workers[i].join();
-    }    
-    announcer.join();
-
-    const auto diff = chrono::steady_clock::now() - renderStart;
-    cout << "Ray Trace finished - " << chrono::duration<double, milli>(diff).count() << " ms elapsed | " << threadCount << " with worker(s)" << endl;    
+    cout << "Ray Trace finished - " << stats.elapsedMs << " ms elapsed | " << stats.threadCount << " with worker(s)" << endl;    
 
     if (renderStopFlag) return;    
 
     // Scale result
-    const auto invRoundedScaleFactor = resultImage.scale((endGoalWidth + endGoalHeight) / static_cast<f32>(currentRenderWidth + currentRenderHeight));
+    Image scaledImage;
+    const auto invRoundedScaleFactor = resultImage.scale((endGoalWidth + endGoalHeight) / static_cast<f32>(currentRenderWidth + currentRenderHeight), scaledImage);
+
+    // Keep the unscaled pass around, for the next pass to refine
+    previousPass = move(resultImage);
 
     // Create bitmap array
     auto* arr = (COLORREF*)calloc(endGoalWidth * endGoalHeight, sizeof(COLORREF));
@@ -387,7 +81,7 @@ void render(const sint32 currentRenderWidth,
         {
             if (renderStopFlag) return;
 
-            const auto colorVec = resultImage[minu(y, resultImage.getHeight() - 1)][minu(x, resultImage.getWidth() - 1)];
+            const auto colorVec = scaledImage[minu(y, scaledImage.getHeight() - 1)][minu(x, scaledImage.getWidth() - 1)];
             arr[y * endGoalWidth + x] = RGB(minf(1.0f, colorVec.z) * 255, minf(1.0f, colorVec.y) * 255, minf(1.0f, colorVec.x) * 255);
         }
     }
@@ -403,7 +97,25 @@ void render(const sint32 currentRenderWidth,
     // Write result to file
     std::stringstream outputFileNameStream;	
     outputFileNameStream << "output_images/last_rendering" << std::fixed << std::setprecision(2) << 1.0f/invRoundedScaleFactor << "x.bmp";
-    resultImage.writeToBMP(outputFileNameStream.str());
+    if (!scaledImage.writeToBMP(outputFileNameStream.str(), &threadPool))
+    {
+        cout << "Error: Could not write " << outputFileNameStream.str() << endl;
+        return;
+    }
+
+    if (costHeatmap)
+    {
+        std::stringstream heatmapFileNameStream;
+        heatmapFileNameStream << "output_images/last_rendering" << std::fixed << std::setprecision(2) << 1.0f/invRoundedScaleFactor << "x_heatmap.bmp";
+        costImage.toHeatmap();
+        Image scaledCostImage;
+        costImage.scale((endGoalWidth + endGoalHeight) / static_cast<f32>(currentRenderWidth + currentRenderHeight), scaledCostImage);
+        if (!scaledCostImage.writeToBMP(heatmapFileNameStream.str(), &threadPool))
+        {
+            cout << "Error: Could not write " << heatmapFileNameStream.str() << endl;
+            return;
+        }
+    }
 
     cout << "Finished writing output to file.. " << endl;
 }
@@ -439,6 +151,9 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
     auto startingRenderWidth = prevWindowWidth / 8;
     auto startingRenderHeight = prevWindowHeight / 8;
 
+    // Toggled from the Render menu, and picked up by the next render pass requested
+    auto costHeatmap = false;
+
     // Initialize Window
     auto windowHandle = win32::CreateMainWindow(instance, prevWindowWidth, prevWindowHeight, "MinTracer");    
 
@@ -449,6 +164,75 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
     auto saveScene = false;
     auto openScene = false;
 
+    // Render workers, created once and shared by every render pass
+    ThreadPool renderThreadPool(getDefaultThreadCount());
+
+    // Long-lived thread responsible for driving the render passes. It sleeps until 
+    // a pass is requested from WM_PAINT, with the pass dimensions captured at request time.
+    struct RenderPassRequest
+    {
+        uint32 windowWidth;
+        uint32 windowHeight;
+        uint32 endGoalWidth;
+        bool costHeatmap;
+        bool pending;
+        bool quit;
+    } renderPassRequest = {};
+    mutex renderPassMutex;
+    condition_variable renderPassCondition;
+
+    thread renderPassThread([&renderPassRequest, &renderPassMutex, &renderPassCondition, &renderThreadPool, &rendering, &currentRenderWidth, &currentRenderHeight, &renderStopFlag, windowHandle]()
+    {
+        // Last completed pass, and the final pass width of its refinement sequence
+        Image previousPass;
+        auto previousPassFinalWidth = 0U;
+
+        while (true)
+        {
+            RenderPassRequest request;
+            {
+                unique_lock<mutex> lock(renderPassMutex);
+                renderPassCondition.wait(lock, [&renderPassRequest]() { return renderPassRequest.pending || renderPassRequest.quit; });
+                if (renderPassRequest.quit) return;
+
+                request = renderPassRequest;
+                renderPassRequest.pending = false;
+            }
+
+            // The resolution keeps doubling until it exceeds the end goal, 
+            // so this determines the resolution of the final pass
+            auto finalScale = 1U;
+            while (currentRenderWidth * finalScale * 2 <= request.endGoalWidth)
+            {
+                finalScale *= 2;
+            }
+
+            // Passes only line up with the previous pass if they share the same final pass
+            if (previousPassFinalWidth != currentRenderWidth * finalScale)
+            {
+                previousPass = Image();
+            }
+
+            render(currentRenderWidth, currentRenderHeight, request.windowWidth, request.windowHeight, renderStopFlag, finalScale, previousPass, renderThreadPool, request.costHeatmap, windowHandle);
+            previousPassFinalWidth = previousPass.getWidth() * finalScale;
+
+            // SetWindowText blocks on the GUI thread, which might be waiting for us to quit
+            if (!renderStopFlag)
+            {
+                SetWindowText(windowHandle, ("MinTracer -- Current resolution: " + to_string(currentRenderWidth) + " x " + to_string(currentRenderHeight)).c_str());
+            }
+            
+            // Ray Tracing completed for current resolution, 
+            // double the render resolution for the next rendering
+            if (currentRenderWidth <= request.endGoalWidth)
+            {
+                currentRenderWidth *= 2;
+                currentRenderHeight *= 2;                        
+            }
+            rendering = false;
+        }
+    });
+
     MSG msg = {};    
     while (msg.message != WM_QUIT )
     {
@@ -465,24 +249,16 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
                     rendering = true;
                     renderStopFlag = false;
 
-                    // Thread responsible for spawning workers and performing Ray Tracing
-                    thread masterRayTraceThread([&rendering, &currentRenderWidth, &currentRenderHeight, prevWindowHeight, prevWindowWidth, endGoalWidth, endGoalHeight, &renderStopFlag, windowHandle]()
-                    {                        
-                        render(currentRenderWidth, currentRenderHeight, prevWindowWidth, prevWindowHeight, renderStopFlag, windowHandle);
-                        SetWindowText(windowHandle, ("MinTracer -- Current resolution: " + to_string(currentRenderWidth) + " x " + to_string(currentRenderHeight)).c_str());
-                        
-                        // Ray Tracing completed for current resolution, 
-                        // double the render resolution for the next rendering
-                        if (currentRenderWidth <= endGoalWidth)
-                        {
-                            currentRenderWidth *= 2;
-                            currentRenderHeight *= 2;                        
-                        }
-                        rendering = false;
-
-                    });
-
-                    masterRayTraceThread.detach();
+                    // Wake up the render pass thread
+                    {
+                        lock_guard<mutex> lock(renderPassMutex);
+                        renderPassRequest.windowWidth = prevWindowWidth;
+                        renderPassRequest.windowHeight = prevWindowHeight;
+                        renderPassRequest.endGoalWidth = endGoalWidth;
+                        renderPassRequest.costHeatmap = costHeatmap;
+                        renderPassRequest.pending = true;
+                    }
+                    renderPassCondition.notify_one();
                 }            
             } break;
 
@@ -519,6 +295,16 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
                         currentRenderWidth = startingRenderWidth; 
                         currentRenderHeight = startingRenderHeight; 
                     } break;
+
+                    // Restarts rendering as well, so that every pass gets its heatmap (or stops getting one)
+                    case win32::GUID_COST_HEATMAP_RENDER:
+                    {
+                        costHeatmap = !costHeatmap;
+                        CheckMenuItem(GetMenu(windowHandle), win32::GUID_COST_HEATMAP_RENDER, costHeatmap ? MF_CHECKED : MF_UNCHECKED);
+                        renderStopFlag = true;
+                        currentRenderWidth = startingRenderWidth; 
+                        currentRenderHeight = startingRenderHeight; 
+                    } break;
                 }
 
                 // Might also need to create the dynamic gui menus for each 
@@ -594,16 +380,16 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
         // Async scene saving
         if (saveScene)
         {
-            win32::CreateIODialog(windowHandle, instance, win32::IO_DIALOG_TYPE::SAVE_AS, [](const win32::IO_DIALOG_RESULT_TYPE resultType)
+            win32::CreateIODialog(windowHandle, instance, win32::IO_DIALOG_TYPE::SAVE_AS, [](const io::IO_RESULT_TYPE resultType)
             {
                 switch (resultType)
                 {
-                    case win32::SUCCESS:
+                    case io::SUCCESS:
                     {
                         MessageBox(NULL, "Scene successfully saved", "Save Scene", MB_OK);
                     } break;
 
-                    case win32::FAILURE:
+                    case io::FAILURE:
                     {
                         MessageBox(NULL, "Error: Could not save scene", "Error", MB_OK | MB_ICONERROR);
                     } break;
@@ -616,18 +402,18 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
         // Async scene loading
         if (openScene)
         {
-            win32::CreateIODialog(windowHandle, instance, win32::IO_DIALOG_TYPE::OPEN, [&currentRenderWidth, &currentRenderHeight, &renderStopFlag, &startingRenderWidth, &startingRenderHeight](const win32::IO_DIALOG_RESULT_TYPE resultType)
+            win32::CreateIODialog(windowHandle, instance, win32::IO_DIALOG_TYPE::OPEN, [&currentRenderWidth, &currentRenderHeight, &renderStopFlag, &startingRenderWidth, &startingRenderHeight](const io::IO_RESULT_TYPE resultType)
             {
                 switch (resultType)
                 {
-                    case win32::SUCCESS:
+                    case io::SUCCESS:
                     {
                         renderStopFlag = true;
                         currentRenderWidth = startingRenderWidth;
                         currentRenderHeight = startingRenderHeight;
                     } break;
 
-                    case win32::FAILURE:
+                    case io::FAILURE:
                     {
                         MessageBox(NULL, "Error: Could not load scene", "Error", MB_OK | MB_ICONERROR);
                     } break;
@@ -639,8 +425,13 @@ int CALLBACK WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmd, int
 
     renderStopFlag = true;
 
-    // Wait for threads to catch up to the rendering stop flag and shut down
-    Sleep(1000);
+    // Wait for the current pass to catch up to the rendering stop flag and shut down
+    {
+        lock_guard<mutex> lock(renderPassMutex);
+        renderPassRequest.quit = true;
+    }
+    renderPassCondition.notify_one();
+    renderPassThread.join();
 
     return 0;
 }
\ No newline at end of file
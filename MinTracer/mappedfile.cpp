@@ -0,0 +1,77 @@
+/**********************************************************************/
+/** mappedfile.cpp by Alex Koukoulas (C) 2017 All Rights Reserved    **/
+/** File Description: Win32 and POSIX implementations of MappedFile  **/
+/**********************************************************************/
+
+// Local Headers
+#include "mappedfile.h"
+
+// Remote Headers
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& filePath)
+    : _data(nullptr)
+    , _size(0)
+    , _fileHandle(INVALID_HANDLE_VALUE)
+    , _mappingHandle(nullptr)
+{
+    _fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (_fileHandle == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_fileHandle, &fileSize) || fileSize.QuadPart == 0) return;
+
+    _mappingHandle = CreateFileMappingA(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (_mappingHandle == nullptr) return;
+
+    _data = static_cast<const uint8*>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    _size = _data ? static_cast<size_t>(fileSize.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data) UnmapViewOfFile(_data);
+    if (_mappingHandle) CloseHandle(_mappingHandle);
+    if (_fileHandle != INVALID_HANDLE_VALUE) CloseHandle(_fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filePath)
+    : _data(nullptr)
+    , _size(0)
+{
+    const auto fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) return;
+
+    // The mapping stays valid after the descriptor is closed
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        auto* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping != MAP_FAILED)
+        {
+            _data = static_cast<const uint8*>(mapping);
+            _size = static_cast<size_t>(fileStat.st_size);
+        }
+    }
+
+    close(fileDescriptor);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data) munmap(const_cast<uint8*>(_data), _size);
+}
+
+#endif
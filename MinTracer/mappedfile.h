@@ -0,0 +1,37 @@
+/**********************************************************************/
+/** mappedfile.h by Alex Koukoulas (C) 2017 All Rights Reserved      **/
+/** File Description: Interface to a read-only memory mapped file    **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <string>
+
+// Maps the whole file into memory for reading, for as long as the object lives.
+// Pages are only read from disk once they are touched.
+class MappedFile final
+{
+public:
+    explicit MappedFile(const std::string& filePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    inline bool isValid() const { return _data != nullptr; }
+    inline const uint8* getData() const { return _data; }
+    inline size_t getSize() const { return _size; }
+
+private:
+    const uint8* _data;
+    size_t _size;
+
+#if defined(_WIN32)
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+};
@@ -71,7 +71,7 @@ template<typename T>
 inline vec3<T> operator / (const vec3<T>& a, const T& scalar) { return vec3<T>(a.x / scalar, a.y / scalar, a.z / scalar); }
 
 template<typename T>
-inline vec3<T> operator / (const T& scalar, const vec3<T>& b) { return a / scalar; }
+inline vec3<T> operator / (const T& scalar, const vec3<T>& b) { return vec3<T>(scalar / b.x, scalar / b.y, scalar / b.z); }
 
 template<typename T>
 inline T length(const vec3<T>& vec) { return sqrtf(vec.x * vec.x + vec.y * vec.y + vec.z * vec.z); }
@@ -83,7 +83,7 @@ template<typename T>
 inline T dot(const vec3<T>& a, const vec3<T>& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
 
 template<typename T>
-inline vec3<T> cross(const vec3<T>& a, const vec3<T>& b) { return vec3<T>(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x); }
+inline vec3<T> cross(const vec3<T>& a, const vec3<T>& b) { return vec3<T>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
 
 template<typename T>
 inline uint32 vec3toARGB(const vec3<T>& vec)
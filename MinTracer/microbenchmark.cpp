@@ -0,0 +1,289 @@
+/************************************************************************/
+/** microbenchmark.cpp by Alex Koukoulas (C) 2017 All Rights Reserved **/
+/** File Description: Implementation of the kernel microbenchmarks    **/
+/************************************************************************/
+
+// Local Headers
+#include "microbenchmark.h"
+#include "raytracer.h"
+#include "renderscene.h"
+#include "scene.h"
+#include "image.h"
+#include "spherekernels.h"
+#include "seededrandom.h"
+#include "strutils.h"
+
+// Remote Headers
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+// Rays per ray set, and primitives the random rays are tested against
+static const uint32 RAY_SET_SIZE = 1 << 16;
+static const uint32 PRIMITIVE_SPHERE_COUNT = 16;
+static const uint32 PRIMITIVE_PLANE_COUNT = 8;
+
+// Scratch file the BMP writer is timed on, removed once done
+static const char* BMP_FILE_NAME = "microbenchmark.bmp";
+
+struct MicroBenchmarkResult
+{
+    std::string name;
+    uint64 operationCount;
+    bool tracesRays;
+    f64 bestMs;
+    f64 medianMs;
+    f64 checksum;
+};
+
+// Runs the kernel once untimed and then repetitions times. The kernel returns the checksum
+// of its results, which also keeps the compiler from optimizing the work away.
+template<typename Kernel>
+static MicroBenchmarkResult measure(const char* name, const uint64 operationCount, const bool tracesRays, const uint32 repetitions, std::ostream& output, Kernel kernel)
+{
+    MicroBenchmarkResult result = { name, operationCount, tracesRays, 0.0, 0.0, kernel() };
+
+    std::vector<f64> elapsedMs;
+    for (auto i = 0U; i < repetitions; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        result.checksum = kernel();
+        elapsedMs.push_back(std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(elapsedMs.begin(), elapsedMs.end());
+    result.bestMs = elapsedMs.front();
+    result.medianMs = elapsedMs[elapsedMs.size() / 2];
+
+    output << std::left << std::setw(28) << name << std::right << ": best " << result.bestMs << " ms | median " << result.medianMs << " ms | "
+           << result.bestMs * 1e6 / operationCount << " ns/op";
+    if (tracesRays) output << " | " << operationCount / (result.bestMs / 1000.0) / 1e6 << " Mrays/s";
+    output << " | checksum " << result.checksum << std::endl;
+    return result;
+}
+
+// Camera rays through random points of the image plane, exactly as renderImage sets them up
+static std::vector<Ray> createCameraRays(const sint32 width, const sint32 height, SeededRandom& random)
+{
+    const auto fov = PI / 3.0f;
+    const auto aspect = static_cast<f32>(width) / height;
+    const auto angle = tan(fov * 0.5f);
+
+    std::vector<Ray> rays(RAY_SET_SIZE);
+    for (auto& ray: rays)
+    {
+        const auto xx = (2 * random.nextFloat() - 1) * angle * aspect;
+        const auto yy = (1 - 2 * random.nextFloat()) * angle;
+        ray = Ray(normalize(vec3<f32>(xx, yy, -1.0f)), vec3<f32>());
+    }
+    return rays;
+}
+
+static bool writeJson(const std::string& jsonFilePath, const sint32 width, const sint32 height, const uint32 repetitions, const uint64 seed,
+                      const SceneSnapshot& snapshot, const std::vector<MicroBenchmarkResult>& results)
+{
+    std::ofstream file(jsonFilePath);
+    if (!file) return false;
+
+    file << std::setprecision(12);
+    file << "{\n"
+         << "  \"suite\": \"micro\",\n"
+         << "  \"seed\": " << seed << ",\n"
+         << "  \"repetitions\": " << repetitions << ",\n"
+         << "  \"width\": " << width << ",\n"
+         << "  \"height\": " << height << ",\n"
+         << "  \"sphereKernels\": " << strutils::toJsonString(getSimdLevelName(getSimdLevel())) << ",\n"
+         << "  \"scene\": { \"spheres\": " << snapshot.getSphereCount() << ", \"planes\": " << snapshot.getPlaneCount()
+         << ", \"lights\": " << snapshot.getLightCount() << " },\n"
+         << "  \"benchmarks\": [\n";
+
+    for (auto i = 0U; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        file << "    { \"name\": " << strutils::toJsonString(result.name)
+             << ", \"operations\": " << result.operationCount
+             << ", \"bestMs\": " << result.bestMs
+             << ", \"medianMs\": " << result.medianMs
+             << ", \"nsPerOp\": " << result.bestMs * 1e6 / result.operationCount
+             << ", \"raysPerSecond\": ";
+        if (result.tracesRays) file << result.operationCount / (result.bestMs / 1000.0);
+        else file << "null";
+        file << ", \"checksum\": " << result.checksum << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+bool runMicroBenchmarks(const sint32 width, const sint32 height, const uint32 repetitions, const uint64 seed, const std::string& jsonFilePath, std::ostream& output)
+{
+    const auto snapshot = Scene::get().getSnapshot();
+    const RenderScene scene(snapshot);
+
+    output << "Microbenchmarks with seed " << seed << ", " << repetitions << " repetition(s), " << RAY_SET_SIZE << " rays per set, "
+           << width << " x " << height << " camera and images, " << getSimdLevelName(getSimdLevel()) << " sphere kernels" << std::endl;
+
+    SeededRandom random(seed);
+
+    // Random rays through the box the random primitives are spread over
+    std::vector<Ray> rays(RAY_SET_SIZE);
+    for (auto& ray: rays)
+    {
+        const vec3<f32> origin(random.nextFloat(-10.0f, 10.0f), random.nextFloat(-10.0f, 10.0f), random.nextFloat(-10.0f, 10.0f));
+        ray = Ray(random.nextDirection(), origin);
+    }
+
+    std::vector<Sphere> spheres(PRIMITIVE_SPHERE_COUNT);
+    for (auto& sphere: spheres)
+    {
+        const vec3<f32> center(random.nextFloat(-8.0f, 8.0f), random.nextFloat(-8.0f, 8.0f), random.nextFloat(-8.0f, 8.0f));
+        sphere = Sphere(random.nextFloat(0.5f, 2.0f), center, 0);
+    }
+
+    std::vector<Plane> planes(PRIMITIVE_PLANE_COUNT);
+    for (auto& plane: planes)
+    {
+        plane = Plane(random.nextDirection(), random.nextFloat(-10.0f, 10.0f), 0);
+    }
+
+    const auto cameraRays = createCameraRays(width, height, random);
+
+    // The hits shade is timed on
+    std::vector<std::pair<Ray, HitInfo>> cameraHits;
+    for (const auto& ray: cameraRays)
+    {
+        const auto hitInfo = intersectScene(scene, ray);
+        if (hitInfo.hit) cameraHits.push_back(std::make_pair(ray, hitInfo));
+    }
+
+    Image image(width, height);
+    for (auto y = 0; y < height; ++y)
+    {
+        for (auto x = 0; x < width; ++x)
+        {
+            image[y][x] = vec3<f32>(random.nextFloat(), random.nextFloat(), random.nextFloat());
+        }
+    }
+
+    std::vector<MicroBenchmarkResult> results;
+    const auto pixelCount = static_cast<uint64>(width) * height;
+
+    results.push_back(measure("raySphereIntersectionTest", static_cast<uint64>(RAY_SET_SIZE) * PRIMITIVE_SPHERE_COUNT, true, repetitions, output, [&rays, &spheres]()
+    {
+        auto checksum = 0.0;
+        for (const auto& ray: rays)
+        {
+            for (const auto& sphere: spheres)
+            {
+                const auto hitInfo = raySphereIntersectionTest(ray, sphere);
+                if (hitInfo.hit) checksum += hitInfo.t + hitInfo.normal.x;
+            }
+        }
+        return checksum;
+    }));
+
+    results.push_back(measure("rayPlaneIntersectionTest", static_cast<uint64>(RAY_SET_SIZE) * PRIMITIVE_PLANE_COUNT, true, repetitions, output, [&rays, &planes]()
+    {
+        auto checksum = 0.0;
+        for (const auto& ray: rays)
+        {
+            for (const auto& plane: planes)
+            {
+                const auto hitInfo = rayPlaneIntersectionTest(ray, plane);
+                if (hitInfo.hit) checksum += hitInfo.t + hitInfo.position.x;
+            }
+        }
+        return checksum;
+    }));
+
+    results.push_back(measure("closestHit", RAY_SET_SIZE, true, repetitions, output, [&scene, &cameraRays]()
+    {
+        auto checksum = 0.0;
+        for (const auto& ray: cameraRays)
+        {
+            const auto primitiveHit = closestHit(scene, ray);
+            checksum += primitiveHit.t;
+        }
+        return checksum;
+    }));
+
+    results.push_back(measure("intersectScene", RAY_SET_SIZE, true, repetitions, output, [&scene, &cameraRays]()
+    {
+        auto checksum = 0.0;
+        for (const auto& ray: cameraRays)
+        {
+            const auto hitInfo = intersectScene(scene, ray);
+            if (hitInfo.hit) checksum += hitInfo.t + hitInfo.normal.x;
+        }
+        return checksum;
+    }));
+
+    // Every shade call traces the light's shadow ray
+    const auto shadeCount = static_cast<uint64>(cameraHits.size()) * scene.getLightCount();
+    if (shadeCount > 0)
+    {
+        results.push_back(measure("shade", shadeCount, true, repetitions, output, [&scene, &cameraHits]()
+        {
+            auto checksum = 0.0;
+            const auto* lights = scene.getLights();
+            for (const auto& cameraHit: cameraHits)
+            {
+                for (auto light = 0U; light < scene.getLightCount(); ++light)
+                {
+                    const auto color = shade(scene, cameraHit.first, lights[light], cameraHit.second);
+                    checksum += color.x + color.y + color.z;
+                }
+            }
+            return checksum;
+        }));
+    }
+
+    // Rays per second only count the camera rays, not the shadow and secondary rays they spawn
+    results.push_back(measure("trace", RAY_SET_SIZE, true, repetitions, output, [&scene, &cameraRays]()
+    {
+        auto checksum = 0.0;
+        for (const auto& ray: cameraRays)
+        {
+            const auto color = trace(scene, ray);
+            checksum += color.x + color.y + color.z;
+        }
+        return checksum;
+    }));
+
+    results.push_back(measure("Image::scale", pixelCount, false, repetitions, output, [&image]()
+    {
+        Image scaledImage;
+        image.scale(2.0f, scaledImage);
+        return static_cast<f64>(scaledImage[scaledImage.getHeight() - 1][scaledImage.getWidth() - 1].x);
+    }));
+
+    results.push_back(measure("Image::writeToBMP", pixelCount, false, repetitions, output, [&image]()
+    {
+        image.writeToBMP(BMP_FILE_NAME);
+        return static_cast<f64>(image.getWidth() * image.getHeight());
+    }));
+    std::remove(BMP_FILE_NAME);
+
+    const auto sceneText = snapshot->toString();
+    const auto sceneObjectCount = snapshot->getSphereCount() + snapshot->getPlaneCount() + snapshot->getLightCount() + snapshot->getMaterialCount();
+    results.push_back(measure("Scene::constructFromString", maxu(1U, static_cast<uint32>(sceneObjectCount)), false, repetitions, output, [&sceneText]()
+    {
+        auto& parsedScene = Scene::get();
+        parsedScene.constructFromString(sceneText);
+        return static_cast<f64>(parsedScene.getSphereCount() + parsedScene.getPlaneCount());
+    }));
+
+    if (jsonFilePath.empty()) return true;
+
+    if (!writeJson(jsonFilePath, width, height, repetitions, seed, *snapshot, results))
+    {
+        output << "Error: Could not write " << jsonFilePath << std::endl;
+        return false;
+    }
+
+    output << "Results written to " << jsonFilePath << std::endl;
+    return true;
+}
@@ -0,0 +1,30 @@
+/**********************************************************************/
+/** microbenchmark.h by Alex Koukoulas (C) 2017 All Rights Reserved  **/
+/** File Description: Interface to the microbenchmarks timing the    **/
+/** individual intersection, shading, image and parsing kernels      **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <ostream>
+#include <string>
+
+// Times every kernel over fixed inputs generated from the seed (ray sets, primitives, image
+// contents), so that runs with the same seed, scene and resolution do the exact same work:
+//
+//  - raySphereIntersectionTest and rayPlaneIntersectionTest, of random rays against random primitives
+//  - closestHit, intersectScene, shade and trace, of random camera rays (as renderImage casts them
+//    at the given resolution) into the current scene
+//  - Image::scale and Image::writeToBMP, of a random image at the given resolution
+//  - Scene::constructFromString, of the current scene's text form
+//
+// Scene parsing replaces the current scene with the parsed one, and hence runs last. Every kernel
+// runs once untimed and then the given number of times. Reports the best and median time, ns per
+// operation and, for kernels tracing rays, rays per second, along with a checksum of the results
+// that has to match between builds doing the same work. The same is written as JSON to
+// jsonFilePath, unless empty, for diffing between builds. Returns false if it couldn't be written.
+bool runMicroBenchmarks(const sint32 width, const sint32 height, const uint32 repetitions, const uint64 seed, const std::string& jsonFilePath, std::ostream& output);
@@ -0,0 +1,137 @@
+/**********************************************************************/
+/** perfcounters.cpp by Alex Koukoulas (C) 2017 All Rights Reserved  **/
+/** File Description: Implementation of the cache miss counters and  **/
+/** the memory usage queries                                         **/
+/**********************************************************************/
+
+// Local Headers
+#include "perfcounters.h"
+#include "threadpool.h"
+
+// Remote Headers
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <string>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <Psapi.h>
+#endif
+
+static const uint32 COUNTERS_PER_WORKER = 2;
+
+#ifdef __linux__
+static sint32 openCounter(const uint32 type, const uint64 config)
+{
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+
+    // The calling thread, on whichever CPU it runs
+    return static_cast<sint32>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+#endif
+
+CacheMissCounters::CacheMissCounters(ThreadPool& threadPool)
+    : _counters(threadPool.getThreadCount() * COUNTERS_PER_WORKER, -1)
+    , _available(false)
+{
+#ifdef __linux__
+    threadPool.dispatch([this](const uint32 workerIndex)
+    {
+        const auto l1dReadMisses = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        _counters[workerIndex * COUNTERS_PER_WORKER] = openCounter(PERF_TYPE_HW_CACHE, l1dReadMisses);
+        _counters[workerIndex * COUNTERS_PER_WORKER + 1] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    });
+    threadPool.wait();
+
+    _available = true;
+    for (const auto counter: _counters)
+    {
+        _available &= counter >= 0;
+    }
+#endif
+}
+
+CacheMissCounters::~CacheMissCounters()
+{
+#ifdef __linux__
+    for (const auto counter: _counters)
+    {
+        if (counter >= 0) close(counter);
+    }
+#endif
+}
+
+void CacheMissCounters::reset()
+{
+#ifdef __linux__
+    if (!_available) return;
+
+    for (const auto counter: _counters)
+    {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+    }
+#endif
+}
+
+CacheMisses CacheMissCounters::read() const
+{
+    CacheMisses misses = {};
+
+#ifdef __linux__
+    if (!_available) return misses;
+
+    for (auto i = 0U; i < _counters.size(); ++i)
+    {
+        uint64 value = 0;
+        if (::read(_counters[i], &value, sizeof(value)) != sizeof(value)) continue;
+
+        if (i % COUNTERS_PER_WORKER == 0) misses.l1dReadMisses += value;
+        else misses.lastLevelMisses += value;
+    }
+#endif
+
+    return misses;
+}
+
+uint64 getPeakResidentSetSize()
+{
+#ifdef __linux__
+    // VmHWM, unlike getrusage's maximum, honours resetPeakResidentSetSize
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::stoull(line.substr(6)) * 1024;
+    }
+    return 0;
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    return 0;
+#endif
+}
+
+bool resetPeakResidentSetSize()
+{
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return static_cast<bool>(clearRefs);
+#else
+    return false;
+#endif
+}
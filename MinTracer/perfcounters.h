@@ -0,0 +1,76 @@
+/**********************************************************************/
+/** perfcounters.h by Alex Koukoulas (C) 2017 All Rights Reserved    **/
+/** File Description: Interface to the hardware cache miss counters  **/
+/** of the render workers, the cycle counter and the memory usage    **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <chrono>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PERF_COUNTERS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+class ThreadPool;
+
+struct CacheMisses
+{
+    uint64 l1dReadMisses;
+    uint64 lastLevelMisses;
+};
+
+// Counts the cache misses of every worker of the pool, through perf events on Linux.
+// Unavailable on other platforms, or where the kernel denies access to the hardware
+// counters (e.g. in most virtual machines), in which case nothing is counted.
+class CacheMissCounters final
+{
+public:
+    // Opens the counters from within every worker, as they count the thread opening them
+    explicit CacheMissCounters(ThreadPool& threadPool);
+    ~CacheMissCounters();
+
+    CacheMissCounters(const CacheMissCounters&) = delete;
+    CacheMissCounters& operator = (const CacheMissCounters&) = delete;
+
+    inline bool isAvailable() const { return _available; }
+
+    void reset();
+
+    // Misses since the last reset, summed over every worker
+    CacheMisses read() const;
+
+private:
+    // Per worker, the L1D read miss counter followed by the last level one
+    std::vector<sint32> _counters;
+    bool _available;
+};
+
+// Time stamp counter, cheap enough to read around every pixel. Only differences between reads
+// on the same thread are meaningful. Counts nanoseconds on platforms without one.
+inline uint64 readCycleCounter()
+{
+#if defined(PERF_COUNTERS_X86)
+    return __rdtsc();
+#else
+    return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Peak resident set size (working set on Windows) of the process in bytes, 0 where unavailable
+uint64 getPeakResidentSetSize();
+
+// Restarts the peak resident set size from the current one, so that the next peak only covers
+// what happens from now on. Only supported on Linux. Returns false where unsupported, in which
+// case the peak keeps covering the whole lifetime of the process.
+bool resetPeakResidentSetSize();
@@ -0,0 +1,375 @@
+/**********************************************************************/
+/** raypacket.cpp by Alex Koukoulas (C) 2017 All Rights Reserved     **/
+/** File Description: AVX implementation of the packet traversal and **/
+/** intersection kernels                                             **/
+/**********************************************************************/
+
+// Local Headers
+#include "raypacket.h"
+#include "spherekernels.h"
+#include "bvh.h"
+#include "instrumentation.h"
+
+// Remote Headers
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RAY_PACKET_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+bool isPacketTracingSupported()
+{
+#if defined(RAY_PACKET_X86)
+    return getSimdLevel() == SIMD_AVX;
+#else
+    return false;
+#endif
+}
+
+#if defined(RAY_PACKET_X86)
+
+// Every lane evaluates the exact operations of the single ray kernels
+// (BVH::intersectBounds, sphereDistance and the plane test), so that the
+// packets find bit identical distances.
+
+struct PacketVectors
+{
+    __m256 originX, originY, originZ;
+    __m256 directionX, directionY, directionZ;
+    __m256 invDirectionX, invDirectionY, invDirectionZ;
+    __m256 a, fourA;
+};
+
+struct PacketStackEntry
+{
+    __m256 tEntry;
+    uint32 nodeIndex;
+    uint32 laneMask;
+};
+
+TARGET_AVX static inline void loadPacket(const RayPacket& packet, PacketVectors& vectors)
+{
+    const auto one = _mm256_set1_ps(1.0f);
+    vectors.originX = _mm256_load_ps(packet.originX);
+    vectors.originY = _mm256_load_ps(packet.originY);
+    vectors.originZ = _mm256_load_ps(packet.originZ);
+    vectors.directionX = _mm256_load_ps(packet.directionX);
+    vectors.directionY = _mm256_load_ps(packet.directionY);
+    vectors.directionZ = _mm256_load_ps(packet.directionZ);
+    vectors.invDirectionX = _mm256_div_ps(one, vectors.directionX);
+    vectors.invDirectionY = _mm256_div_ps(one, vectors.directionY);
+    vectors.invDirectionZ = _mm256_div_ps(one, vectors.directionZ);
+    vectors.a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vectors.directionX, vectors.directionX), _mm256_mul_ps(vectors.directionY, vectors.directionY)), _mm256_mul_ps(vectors.directionZ, vectors.directionZ));
+    vectors.fourA = _mm256_mul_ps(_mm256_set1_ps(4.0f), vectors.a);
+}
+
+TARGET_AVX static inline uint32 getMask(const __m256 condition)
+{
+    return static_cast<uint32>(_mm256_movemask_ps(condition));
+}
+
+// Slab test of every lane against the node's bounds, returning the mask of lanes that hit them before maxT
+TARGET_AVX static inline uint32 intersectBoundsPacket(const BVHNode& node, const PacketVectors& vectors, const __m256 maxT, __m256& tEntry)
+{
+    const auto tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin.x), vectors.originX), vectors.invDirectionX);
+    const auto tx2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax.x), vectors.originX), vectors.invDirectionX);
+    const auto ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin.y), vectors.originY), vectors.invDirectionY);
+    const auto ty2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax.y), vectors.originY), vectors.invDirectionY);
+    const auto tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin.z), vectors.originZ), vectors.invDirectionZ);
+    const auto tz2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax.z), vectors.originZ), vectors.invDirectionZ);
+
+    // _mm256_min_ps/_mm256_max_ps pick their second operand on NaNs, exactly like minf/maxf
+    const auto tMin = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(tx1, tx2), _mm256_min_ps(ty1, ty2)), _mm256_min_ps(tz1, tz2));
+    const auto tMax = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(tx1, tx2), _mm256_max_ps(ty1, ty2)), _mm256_max_ps(tz1, tz2));
+
+    tEntry = tMin;
+    return getMask(_mm256_and_ps(_mm256_cmp_ps(tMax, _mm256_max_ps(tMin, _mm256_setzero_ps()), _CMP_GE_OQ), _mm256_cmp_ps(tMin, maxT, _CMP_LE_OQ)));
+}
+
+// Distance of every lane to a single sphere, along with the mask of lanes that hit it (t > 0)
+TARGET_AVX static inline __m256 sphereDistancePacket(const RenderSpheres& spheres, const uint32 sphere, const PacketVectors& vectors, uint32& hitMask)
+{
+    const auto zero = _mm256_setzero_ps();
+    const auto toRayX = _mm256_sub_ps(vectors.originX, _mm256_set1_ps(spheres.centerX[sphere]));
+    const auto toRayY = _mm256_sub_ps(vectors.originY, _mm256_set1_ps(spheres.centerY[sphere]));
+    const auto toRayZ = _mm256_sub_ps(vectors.originZ, _mm256_set1_ps(spheres.centerZ[sphere]));
+
+    const auto toRayDotDirection = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, vectors.directionX), _mm256_mul_ps(toRayY, vectors.directionY)), _mm256_mul_ps(toRayZ, vectors.directionZ));
+    const auto toRayDotToRay = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, toRayX), _mm256_mul_ps(toRayY, toRayY)), _mm256_mul_ps(toRayZ, toRayZ));
+    const auto b = _mm256_mul_ps(_mm256_set1_ps(2.0f), toRayDotDirection);
+    const auto c = _mm256_sub_ps(toRayDotToRay, _mm256_set1_ps(spheres.radiusSq[sphere]));
+    const auto det = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(vectors.fourA, c));
+
+    const auto sqrtDet = _mm256_sqrt_ps(det);
+    const auto negB = _mm256_xor_ps(b, _mm256_set1_ps(-0.0f));
+    const auto half = _mm256_set1_ps(0.5f);
+    const auto minT = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(negB, sqrtDet), half), vectors.a);
+    const auto maxT = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(negB, sqrtDet), half), vectors.a);
+
+    const auto t = _mm256_blendv_ps(_mm256_and_ps(_mm256_cmp_ps(maxT, zero, _CMP_GT_OQ), maxT), minT, _mm256_cmp_ps(minT, zero, _CMP_GT_OQ));
+
+    hitMask = getMask(_mm256_and_ps(_mm256_cmp_ps(det, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, zero, _CMP_GT_OQ)));
+    return t;
+}
+
+// Distance of every lane to a plane, along with the mask of lanes that hit it (t > 0)
+TARGET_AVX static inline __m256 planeDistancePacket(const RenderPlanes& planes, const uint32 plane, const PacketVectors& vectors, uint32& hitMask)
+{
+    const auto normalX = _mm256_set1_ps(planes.normalX[plane]);
+    const auto normalY = _mm256_set1_ps(planes.normalY[plane]);
+    const auto normalZ = _mm256_set1_ps(planes.normalZ[plane]);
+
+    const auto denom = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX, vectors.directionX), _mm256_mul_ps(normalY, vectors.directionY)), _mm256_mul_ps(normalZ, vectors.directionZ));
+    const auto normalDotOrigin = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX, vectors.originX), _mm256_mul_ps(normalY, vectors.originY)), _mm256_mul_ps(normalZ, vectors.originZ));
+    const auto t = _mm256_div_ps(_mm256_xor_ps(_mm256_add_ps(_mm256_set1_ps(planes.d[plane]), normalDotOrigin), _mm256_set1_ps(-0.0f)), denom);
+
+    const auto notParallel = _mm256_or_ps(_mm256_cmp_ps(denom, _mm256_set1_ps(1e-6f), _CMP_GT_OQ), _mm256_cmp_ps(denom, _mm256_set1_ps(-1e-6f), _CMP_LT_OQ));
+    hitMask = getMask(_mm256_and_ps(notParallel, _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ)));
+    return t;
+}
+
+static inline f32 getMinLane(const f32* values, uint32 laneMask)
+{
+    auto minValue = 1e30f;
+    for (auto lane = 0U; laneMask != 0; ++lane, laneMask >>= 1)
+    {
+        if ((laneMask & 1) && values[lane] < minValue) minValue = values[lane];
+    }
+    return minValue;
+}
+
+// Rays of a packet in laneMask
+static inline uint32 countLanes(uint32 laneMask)
+{
+    auto laneCount = 0U;
+    for (; laneMask != 0; laneMask &= laneMask - 1)
+    {
+        laneCount++;
+    }
+    return laneCount;
+}
+
+// Visits, roughly nearest first, every leaf whose bounds are hit by any of the lanes in laneMask
+// before the lane's maxT. maxT is re-read before every node, so the visitor may shrink it. The
+// visitor is called with the leaf's BVH ordered sphere range and the lanes that reached it, and
+// returns the lanes that still need to continue (0 terminates the traversal).
+template<typename LeafVisitor>
+TARGET_AVX static inline void traversePacket(const BVH& bvh, const PacketVectors& vectors, const f32* maxT, uint32 laneMask, LeafVisitor visitLeaf)
+{
+    if (bvh.getNodeCount() == 0) return;
+
+    const auto* nodes = bvh.getNodes();
+    PacketStackEntry stack[BVH_STACK_SIZE];
+    auto stackSize = 0U;
+
+    __m256 tEntry;
+    const auto rootMask = intersectBoundsPacket(nodes[0], vectors, _mm256_load_ps(maxT), tEntry) & laneMask;
+    if (rootMask == 0) return;
+    stack[stackSize++] = { tEntry, 0U, rootMask };
+
+    alignas(32) f32 laneT[RAY_PACKET_SIZE];
+    while (stackSize > 0)
+    {
+        const auto entry = stack[--stackSize];
+
+        // maxT might have shrunk since the node was pushed, and lanes might have finished
+        const auto currentMaxT = _mm256_load_ps(maxT);
+        const auto entryMask = entry.laneMask & laneMask & getMask(_mm256_cmp_ps(entry.tEntry, currentMaxT, _CMP_LE_OQ));
+        if (entryMask == 0) continue;
+
+        INSTRUMENT_COUNT(COUNTER_BVH_NODES_VISITED, 1);
+        const auto& node = nodes[entry.nodeIndex];
+        if (node.isLeaf())
+        {
+            laneMask = visitLeaf(node.leftFirst, node.primCount, entryMask);
+            if (laneMask == 0) return;
+            continue;
+        }
+
+        __m256 tLeft, tRight;
+        const auto leftMask = intersectBoundsPacket(nodes[node.leftFirst], vectors, currentMaxT, tLeft) & entryMask;
+        const auto rightMask = intersectBoundsPacket(nodes[node.leftFirst + 1], vectors, currentMaxT, tRight) & entryMask;
+
+        // Push the child that is farther for the packet first, so that the nearest one is visited next
+        if (leftMask && rightMask)
+        {
+            _mm256_store_ps(laneT, tLeft);
+            const auto leftEntry = getMinLane(laneT, leftMask);
+            _mm256_store_ps(laneT, tRight);
+            const auto rightEntry = getMinLane(laneT, rightMask);
+
+            if (leftEntry <= rightEntry)
+            {
+                stack[stackSize++] = { tRight, node.leftFirst + 1, rightMask };
+                stack[stackSize++] = { tLeft, node.leftFirst, leftMask };
+            }
+            else
+            {
+                stack[stackSize++] = { tLeft, node.leftFirst, leftMask };
+                stack[stackSize++] = { tRight, node.leftFirst + 1, rightMask };
+            }
+        }
+        else if (leftMask)
+        {
+            stack[stackSize++] = { tLeft, node.leftFirst, leftMask };
+        }
+        else if (rightMask)
+        {
+            stack[stackSize++] = { tRight, node.leftFirst + 1, rightMask };
+        }
+    }
+}
+
+TARGET_AVX static void intersectPacketAVX(const RenderScene& scene, const RayPacket& packet, PacketHit& hit)
+{
+    PacketVectors vectors;
+    loadPacket(packet, vectors);
+
+    for (auto lane = 0U; lane < RAY_PACKET_SIZE; ++lane)
+    {
+        hit.t[lane] = packet.maxT[lane];
+        hit.sphere[lane] = NO_PRIMITIVE;
+        hit.plane[lane] = NO_PRIMITIVE;
+    }
+
+    // Same closest hit rule as the single ray kernels, nearer hits or equally near
+    // ones with a lower scene index win. Lanes are updated one by one, which is
+    // cheap as only lanes that hit something nearer get that far.
+    const auto& spheres = scene.getSpheres();
+    alignas(32) f32 laneT[RAY_PACKET_SIZE];
+    auto visitLeaf = [&](const uint32 first, const uint32 count, const uint32 laneMask) TARGET_AVX
+    {
+        INSTRUMENT_COUNT(COUNTER_SPHERE_TESTS, count * countLanes(laneMask));
+        for (auto i = first; i < first + count; ++i)
+        {
+            uint32 hitMask;
+            const auto t = sphereDistancePacket(spheres, i, vectors, hitMask);
+            auto candidateMask = hitMask & laneMask & getMask(_mm256_cmp_ps(t, _mm256_load_ps(hit.t), _CMP_LE_OQ));
+            if (candidateMask == 0) continue;
+
+            _mm256_store_ps(laneT, t);
+            for (auto lane = 0U; candidateMask != 0; ++lane, candidateMask >>= 1)
+            {
+                if ((candidateMask & 1) == 0) continue;
+
+                const auto closestSphere = hit.sphere[lane];
+                if (laneT[lane] < hit.t[lane] || (closestSphere != NO_PRIMITIVE && laneT[lane] == hit.t[lane] && spheres.sceneIndex[i] < spheres.sceneIndex[closestSphere]))
+                {
+                    hit.t[lane] = laneT[lane];
+                    hit.sphere[lane] = i;
+                }
+            }
+        }
+        return packet.activeMask;
+    };
+
+    if (scene.usesLinearSpheres())
+    {
+        if (scene.getSphereCount() > 0) visitLeaf(0U, scene.getSphereCount(), packet.activeMask);
+    }
+    else
+    {
+        traversePacket(scene.getBVH(), vectors, hit.t, packet.activeMask, visitLeaf);
+    }
+
+    // Planes only win if strictly nearer, as they are tested after the spheres
+    const auto& planes = scene.getPlanes();
+    const auto planeCount = scene.getPlaneCount();
+    INSTRUMENT_COUNT(COUNTER_PLANE_TESTS, planeCount * countLanes(packet.activeMask));
+    for (auto i = 0U; i < planeCount; ++i)
+    {
+        uint32 hitMask;
+        const auto t = planeDistancePacket(planes, i, vectors, hitMask);
+        auto closerMask = hitMask & packet.activeMask & getMask(_mm256_cmp_ps(t, _mm256_load_ps(hit.t), _CMP_LT_OQ));
+        if (closerMask == 0) continue;
+
+        _mm256_store_ps(laneT, t);
+        for (auto lane = 0U; closerMask != 0; ++lane, closerMask >>= 1)
+        {
+            if (closerMask & 1)
+            {
+                hit.t[lane] = laneT[lane];
+                hit.sphere[lane] = NO_PRIMITIVE;
+                hit.plane[lane] = i;
+            }
+        }
+    }
+
+    _mm256_zeroupper();
+}
+
+TARGET_AVX static uint32 occludedPacketAVX(const RenderScene& scene, const RayPacket& packet)
+{
+    PacketVectors vectors;
+    loadPacket(packet, vectors);
+    const auto maxT = _mm256_load_ps(packet.maxT);
+
+    // Planes first, as they tend to be the blockers of the enclosing room
+    auto blockedMask = 0U;
+    const auto& planes = scene.getPlanes();
+    const auto planeCount = scene.getPlaneCount();
+    for (auto i = 0U; i < planeCount && (blockedMask & packet.activeMask) != packet.activeMask; ++i)
+    {
+        INSTRUMENT_COUNT(COUNTER_PLANE_TESTS, countLanes(packet.activeMask & ~blockedMask));
+        uint32 hitMask;
+        const auto t = planeDistancePacket(planes, i, vectors, hitMask);
+        blockedMask |= hitMask & getMask(_mm256_cmp_ps(t, maxT, _CMP_LT_OQ));
+    }
+    blockedMask &= packet.activeMask;
+
+    // Lanes drop out as soon as they are blocked
+    const auto& spheres = scene.getSpheres();
+    auto visitLeaf = [&](const uint32 first, const uint32 count, const uint32 laneMask) TARGET_AVX
+    {
+        auto openMask = laneMask & ~blockedMask;
+        for (auto i = first; i < first + count && openMask != 0; ++i)
+        {
+            INSTRUMENT_COUNT(COUNTER_SPHERE_TESTS, countLanes(openMask));
+            uint32 hitMask;
+            const auto t = sphereDistancePacket(spheres, i, vectors, hitMask);
+            const auto newlyBlocked = hitMask & openMask & getMask(_mm256_cmp_ps(t, maxT, _CMP_LT_OQ));
+            blockedMask |= newlyBlocked;
+            openMask &= ~newlyBlocked;
+        }
+        return packet.activeMask & ~blockedMask;
+    };
+
+    const auto openMask = packet.activeMask & ~blockedMask;
+    if (openMask != 0)
+    {
+        if (scene.usesLinearSpheres())
+        {
+            if (scene.getSphereCount() > 0) visitLeaf(0U, scene.getSphereCount(), openMask);
+        }
+        else
+        {
+            traversePacket(scene.getBVH(), vectors, packet.maxT, openMask, visitLeaf);
+        }
+    }
+
+    _mm256_zeroupper();
+    return blockedMask;
+}
+
+#endif
+
+void intersectPacket(const RenderScene& scene, const RayPacket& packet, PacketHit& hit)
+{
+#if defined(RAY_PACKET_X86)
+    intersectPacketAVX(scene, packet, hit);
+#endif
+}
+
+uint32 occludedPacket(const RenderScene& scene, const RayPacket& packet)
+{
+#if defined(RAY_PACKET_X86)
+    return occludedPacketAVX(scene, packet);
+#else
+    return 0U;
+#endif
+}
@@ -0,0 +1,73 @@
+/**********************************************************************/
+/** raypacket.h by Alex Koukoulas (C) 2017 All Rights Reserved       **/
+/** File Description: Interface to the SIMD kernels tracing packets  **/
+/** of coherent rays through the compiled scene at once              **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "renderscene.h"
+
+// Rays per packet, i.e. the width of an AVX register
+const uint32 RAY_PACKET_SIZE = 8;
+
+// Marks packet lanes that hit nothing
+const uint32 NO_PRIMITIVE = 0xFFFFFFFF;
+
+// Rays as a structure of arrays. Only the lanes in activeMask take part in queries.
+struct RayPacket
+{
+    alignas(32) f32 originX[RAY_PACKET_SIZE];
+    alignas(32) f32 originY[RAY_PACKET_SIZE];
+    alignas(32) f32 originZ[RAY_PACKET_SIZE];
+    alignas(32) f32 directionX[RAY_PACKET_SIZE];
+    alignas(32) f32 directionY[RAY_PACKET_SIZE];
+    alignas(32) f32 directionZ[RAY_PACKET_SIZE];
+    alignas(32) f32 maxT[RAY_PACKET_SIZE];
+    uint32 activeMask;
+
+    // Inactive lanes are zeroed, so they never hold denormals or signaling NaNs
+    RayPacket()
+        : originX(), originY(), originZ()
+        , directionX(), directionY(), directionZ()
+        , maxT()
+        , activeMask(0U)
+    {
+    }
+
+    inline void setRay(const uint32 lane, const Ray& ray, const f32 laneMaxT)
+    {
+        originX[lane] = ray.origin.x;
+        originY[lane] = ray.origin.y;
+        originZ[lane] = ray.origin.z;
+        directionX[lane] = ray.direction.x;
+        directionY[lane] = ray.direction.y;
+        directionZ[lane] = ray.direction.z;
+        maxT[lane] = laneMaxT;
+        activeMask |= 1U << lane;
+    }
+};
+
+// Closest hit of every lane. Lanes that hit a sphere have its BVH ordered index in sphere,
+// lanes that hit a plane its index in plane, and every other lane NO_PRIMITIVE in both.
+struct PacketHit
+{
+    alignas(32) f32 t[RAY_PACKET_SIZE];
+    uint32 sphere[RAY_PACKET_SIZE];
+    uint32 plane[RAY_PACKET_SIZE];
+};
+
+// The packet kernels need AVX, and are hence only used when
+// the sphere kernels dispatch to AVX as well
+bool isPacketTracingSupported();
+
+// Finds the closest hit of every active lane before its maxT, exactly as a single ray
+// intersectScene would (nearest sphere, lowest scene index on ties, then any nearer plane)
+void intersectPacket(const RenderScene& scene, const RayPacket& packet, PacketHit& hit);
+
+// Returns the mask of active lanes that are blocked by anything before their maxT
+uint32 occludedPacket(const RenderScene& scene, const RayPacket& packet);
@@ -0,0 +1,810 @@
+/**********************************************************************/
+/** raytracer.cpp by Alex Koukoulas (C) 2017 All Rights Reserved     **/
+/** File Description: Implementation of the Ray tracing core         **/
+/**********************************************************************/
+
+// Local Headers
+#include "raytracer.h"
+#include "bvh.h"
+#include "spherekernels.h"
+#include "raypacket.h"
+#include "wavefront.h"
+#include "tilescheduler.h"
+#include "threadpool.h"
+#include "perfcounters.h"
+
+// Remote Headers
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+static const f32 T_MIN = 0.01f;
+static const f32 T_MAX = 100.0f;
+static const uint32 PROGRESS_REPORT_INTERVAL_MS = 250;
+
+// Packets with fewer active rays than this are traced one ray at a time instead,
+// as the packet kernels would then mostly be computing idle lanes
+static const uint32 PACKET_MIN_RAY_COUNT = 3;
+
+using namespace std;
+
+// Every scene intersection query (primary, secondary or shadow ray)
+// counts as a single ray. Kept per thread to avoid contention. Shadow
+// rays (i.e. any hit queries) are counted separately as well.
+static thread_local uint64 threadRayCount = 0;
+static thread_local uint64 threadShadowRayCount = 0;
+
+// Shared by the Plane based tests and the compiled scene kernels,
+// so that both compute bit identical distances
+static inline f32 planeDistance(const Ray& ray, const vec3<f32>& normal, const f32 d)
+{
+    const auto denom = dot(normal, ray.direction);
+
+    if (denom > 1e-6f || denom < -1e-6f)
+    {
+        const auto t = -(d + (dot(normal, ray.origin)))/denom;
+        if (t > 0.0f)
+        {
+            return t;
+        }        
+    }
+
+    return 0.0f;
+}
+
+static inline HitInfo sphereHitInfo(const Ray& ray, const vec3<f32>& center, const f32 radius, const uint32 matIndex, const f32 t)
+{
+    const auto hitPos = ray.origin + ray.direction * t;
+    auto normal = normalize(hitPos - center);
+
+    if (length(ray.origin - center) < radius)
+    {
+        normal = -normal;
+    }
+
+    return HitInfo(true, hitPos, normal, matIndex, t);
+}
+
+f32 rayPlaneDistance(const Ray& ray, const Plane& plane)
+{
+    return planeDistance(ray, plane.normal, plane.d);
+}
+
+f32 raySphereDistance(const Ray& ray, const Sphere& sphere)
+{
+    return sphereDistance(ray, dot(ray.direction, ray.direction), sphere.center, sphere.radius * sphere.radius);
+}
+
+HitInfo rayPlaneIntersectionTest(const Ray& ray, const Plane& plane)
+{
+    const auto t = rayPlaneDistance(ray, plane);
+
+    if (t > 0.0f)
+    {
+        const auto hitPos = ray.origin + ray.direction * t;
+        return HitInfo(true, hitPos, plane.normal, plane.matIndex, t);                        
+    }
+
+    return HitInfo(false, vec3<f32>(), vec3<f32>(), 0, T_MAX);
+}
+
+HitInfo raySphereIntersectionTest(const Ray& ray, const Sphere& sphere)
+{
+    const auto selT = raySphereDistance(ray, sphere);
+
+    if (selT > 0.0f)
+    {
+        return sphereHitInfo(ray, sphere.center, sphere.radius, sphere.matIndex, selT);
+    }
+    
+    return HitInfo(false, vec3<f32>(), vec3<f32>(), 0, T_MAX);
+}
+
+PrimitiveHit closestHit(const RenderScene& scene, const Ray& ray)
+{
+    threadRayCount++;
+
+    PrimitiveHit primitiveHit = { T_MAX, NO_PRIMITIVE, NO_PRIMITIVE };
+
+    // Spheres are found through the BVH (or linearly in small scenes). Hits at equal distances
+    // are resolved in favour of the lowest scene index, to match a linear walk of the spheres.
+    const auto& spheres = scene.getSpheres();
+    auto closestSphere = NO_SPHERE;
+    scene.traverseSpheres(ray, primitiveHit.t, [&](const uint32 first, const uint32 count)
+    {
+        INSTRUMENT_COUNT(COUNTER_SPHERE_TESTS, count);
+        intersectSpheres(spheres, ray, first, count, primitiveHit.t, closestSphere);
+        return false;
+    });
+    primitiveHit.sphere = closestSphere;
+
+    // Infinite planes can't be bounded, and are hence tested linearly
+    const auto& planes = scene.getPlanes();
+    const auto planeCount = scene.getPlaneCount();
+    INSTRUMENT_COUNT(COUNTER_PLANE_TESTS, planeCount);
+    for (auto i = 0U; i < planeCount; ++i)
+    {
+        const auto t = planeDistance(ray, vec3<f32>(planes.normalX[i], planes.normalY[i], planes.normalZ[i]), planes.d[i]);
+
+        if (t > 0.0f && t < primitiveHit.t)
+        {            
+            primitiveHit.t = t;
+            primitiveHit.plane = i;
+        }
+    }
+
+    return primitiveHit;
+}
+
+HitInfo getHitInfo(const RenderScene& scene, const Ray& ray, const PrimitiveHit& primitiveHit)
+{
+    const auto t = primitiveHit.t;
+
+    // Planes found nearer take precedence over the sphere hit before them
+    if (primitiveHit.plane != NO_PRIMITIVE)
+    {
+        const auto& planes = scene.getPlanes();
+        const auto plane = primitiveHit.plane;
+        const vec3<f32> normal(planes.normalX[plane], planes.normalY[plane], planes.normalZ[plane]);
+        return HitInfo(true, ray.origin + ray.direction * t, normal, planes.matIndex[plane], t);
+    }
+    
+    if (primitiveHit.sphere != NO_PRIMITIVE)
+    {
+        const auto& spheres = scene.getSpheres();
+        const auto sphere = primitiveHit.sphere;
+        const vec3<f32> center(spheres.centerX[sphere], spheres.centerY[sphere], spheres.centerZ[sphere]);
+        return sphereHitInfo(ray, center, spheres.radius[sphere], spheres.matIndex[sphere], t);
+    }
+
+    return HitInfo(false, vec3<f32>(), vec3<f32>(), 0, T_MAX);
+}
+
+HitInfo intersectScene(const RenderScene& scene, const Ray& ray)
+{
+    return getHitInfo(scene, ray, closestHit(scene, ray));
+}
+
+bool occluded(const RenderScene& scene, const Ray& ray, const f32 tMax)
+{
+    threadRayCount++;
+    threadShadowRayCount++;
+
+    // Planes first, as there are only a handful of them and they 
+    // tend to be the blockers of the enclosing room
+    const auto& planes = scene.getPlanes();
+    const auto planeCount = scene.getPlaneCount();
+    for (auto i = 0U; i < planeCount; ++i)
+    {
+        INSTRUMENT_COUNT(COUNTER_PLANE_TESTS, 1);
+        const auto t = planeDistance(ray, vec3<f32>(planes.normalX[i], planes.normalY[i], planes.normalZ[i]), planes.d[i]);
+        if (t > 0.0f && t < tMax)
+        {
+            return true;
+        }
+    }
+
+    // Any blocker will do, so the traversal stops at the first one found
+    const auto& spheres = scene.getSpheres();
+    auto maxT = tMax;
+    auto blocked = false;
+    scene.traverseSpheres(ray, maxT, [&](const uint32 first, const uint32 count)
+    {
+        // Counts the whole leaf, although the test stops at its first blocker
+        INSTRUMENT_COUNT(COUNTER_SPHERE_TESTS, count);
+        blocked = anySphereHit(spheres, ray, first, count, tMax);
+        return blocked;
+    });
+
+    return blocked;
+}
+
+void intersectSceneBatch(const RenderScene& scene, const Ray* rays, const uint32 rayCount, HitInfo* hitInfos, const bool usePackets)
+{
+    const auto packets = usePackets && isPacketTracingSupported();
+
+    for (auto first = 0U; first < rayCount; first += RAY_PACKET_SIZE)
+    {
+        const auto count = minu(RAY_PACKET_SIZE, rayCount - first);
+        if (!packets || count < PACKET_MIN_RAY_COUNT)
+        {
+            for (auto i = first; i < first + count; ++i)
+            {
+                hitInfos[i] = intersectScene(scene, rays[i]);
+            }
+            continue;
+        }
+
+        RayPacket packet;
+        for (auto i = 0U; i < count; ++i)
+        {
+            packet.setRay(i, rays[first + i], T_MAX);
+        }
+
+        threadRayCount += count;
+        PacketHit packetHit;
+        intersectPacket(scene, packet, packetHit);
+
+        // Hit attributes are computed per ray, exactly as intersectScene does
+        for (auto i = 0U; i < count; ++i)
+        {
+            const PrimitiveHit primitiveHit = { packetHit.t[i], packetHit.sphere[i], packetHit.plane[i] };
+            hitInfos[first + i] = getHitInfo(scene, rays[first + i], primitiveHit);
+        }
+    }
+}
+
+void occludedBatch(const RenderScene& scene, const Ray* rays, const f32* tMax, const uint32 rayCount, uint8* blocked, const bool usePackets)
+{
+    const auto packets = usePackets && isPacketTracingSupported();
+
+    for (auto first = 0U; first < rayCount; first += RAY_PACKET_SIZE)
+    {
+        const auto count = minu(RAY_PACKET_SIZE, rayCount - first);
+        if (!packets || count < PACKET_MIN_RAY_COUNT)
+        {
+            for (auto i = first; i < first + count; ++i)
+            {
+                blocked[i] = occluded(scene, rays[i], tMax[i]) ? 1 : 0;
+            }
+            continue;
+        }
+
+        RayPacket packet;
+        for (auto i = 0U; i < count; ++i)
+        {
+            packet.setRay(i, rays[first + i], tMax[first + i]);
+        }
+
+        threadRayCount += count;
+        threadShadowRayCount += count;
+        const auto occludedMask = occludedPacket(scene, packet);
+        for (auto i = 0U; i < count; ++i)
+        {
+            blocked[first + i] = (occludedMask >> i) & 1;
+        }
+    }
+}
+
+Ray getShadowRay(const RenderLight& light, const HitInfo& hitInfo, f32& tMax)
+{
+    const auto epsilon = 1e-5f;
+    const auto displacedHitPos = hitInfo.position + hitInfo.normal * epsilon;
+
+    const auto hitToLightVec = light.position - displacedHitPos;
+    const auto lightDistance = length(hitToLightVec);
+    tMax = minf(lightDistance, T_MAX);
+    return Ray(hitToLightVec / lightDistance, displacedHitPos);
+}
+
+vec3<f32> shadeUnoccluded(const RenderScene& scene, const Ray& ray, const RenderLight& light, const HitInfo& hitInfo, const Ray& shadowRay)
+{
+    vec3<f32> colorAccum;
+
+    const auto& displacedHitPos = shadowRay.origin;
+    const auto& hitToLight = shadowRay.direction;
+
+    const auto& material = scene.getMaterial(hitInfo.surfaceMatIndex);
+    const auto diffuseTerm = maxf(0.0f, dot(hitInfo.normal, hitToLight));
+
+    colorAccum += (material.diffuse * light.color) * diffuseTerm;    
+    if (light.lightType == Light::POINT_LIGHT)
+    {                
+        colorAccum /= light.falloff;
+    }
+
+    // A black specular contributes nothing, so the highlight is only computed when it can
+    if (material.flags & MATERIAL_SPECULAR)
+    {
+        const auto viewDir = normalize(displacedHitPos - ray.origin);
+        const auto reflDir = normalize(viewDir - hitInfo.normal * dot(viewDir, hitInfo.normal) * 2.0f);
+        const auto specularTerm = powf(maxf(0.0f, dot(reflDir, hitToLight)), material.glossiness);
+
+        colorAccum += (material.specular * light.color) * specularTerm;    
+    }
+
+    return colorAccum;
+}
+
+vec3<f32> shade(const RenderScene& scene, const Ray& ray, const RenderLight& light, const HitInfo& hitInfo)
+{    
+    // Shadow test, the fragment is in shadow if any object lies inbetween 
+    // the hit position and the light's position. Tested first, so that
+    // shading is skipped altogether for shadowed fragments.
+    f32 shadowMaxT;
+    const auto shadowRay = getShadowRay(light, hitInfo, shadowMaxT);
+    auto shadowed = false;
+    {
+        INSTRUMENT_STAGE(STAGE_SHADOW_RAYS);
+        shadowed = occluded(scene, shadowRay, shadowMaxT);
+    }
+
+    if (shadowed)
+    {
+        return vec3<f32>();
+    }
+
+    return shadeUnoccluded(scene, ray, light, hitInfo, shadowRay);
+}
+
+vec3<f32> traceForEachLight(const RenderScene& scene, const Ray& ray, const HitInfo& hitInfo)
+{
+    if (!hitInfo.hit) return vec3<f32>();
+
+    vec3<f32> fragment = scene.getMaterial(hitInfo.surfaceMatIndex).ambient;
+
+    const auto* lights = scene.getLights();
+    const auto lightCount = scene.getLightCount();
+    for (auto i = 0U; i < lightCount; ++i)
+    {
+        fragment += shade(scene, ray, lights[i], hitInfo);
+    }    
+
+    return fragment;
+}
+
+f32 fresnel(const RenderScene& scene, const Ray& ray, const vec3<f32>& normal, const f32 ior)
+{
+    return powf(1.0f - dot(-ray.direction, normal), scene.getFresnelPower());
+}
+
+Ray reflectRay(const RenderScene& scene, const Ray& primaryRay, const Ray& ray, const HitInfo& hitInfo, f32& weight, f32& contribution)
+{
+    const auto& material = scene.getMaterial(hitInfo.surfaceMatIndex);
+    weight *= (material.flags & MATERIAL_REFLECTIVE) ? 0.5f : 0.0f;
+            
+    const auto reflectionDir = normalize(primaryRay.direction - hitInfo.normal * dot(primaryRay.direction, hitInfo.normal) * 2.0f);
+    const auto epsilon = 1e-3f;
+    auto fresnelKr = 1.0f;
+    
+    if (material.flags & MATERIAL_REFRACTIVE)
+    {
+        fresnelKr = fresnel(scene, ray, hitInfo.normal, material.refractivity);
+    }        
+
+    contribution = weight * fresnelKr;
+    return Ray(reflectionDir, hitInfo.position + epsilon * reflectionDir);
+}
+
+Ray refractRay(const RenderScene& scene, const Ray& ray, const HitInfo& hitInfo, f32& weight, f32& contribution)
+{
+    const auto& material = scene.getMaterial(hitInfo.surfaceMatIndex);
+    weight *= (material.flags & MATERIAL_REFRACTIVE) ? 0.5f : 0.0f;
+    
+    auto cosi = dot(ray.direction, hitInfo.normal);                        
+
+    auto etaAir = 1.0f;
+    auto etaT = material.refractivity;
+    auto n = hitInfo.normal;
+
+    if (cosi < 0.0f)
+    {
+        cosi = -cosi;
+    }
+    else
+    {
+        swap(etaAir, etaT);
+        n = -hitInfo.normal;
+    }
+
+    const auto eta = etaAir/etaT;
+    const auto k = 1 - eta * eta * (1 - cosi * cosi);
+    const auto refractionDir = k < 0.0f ? vec3<f32>() : eta * ray.direction + (eta * cosi - sqrtf(k)) * n;
+    const auto epsilon = 1e-3f;
+    
+    auto fresnelKt = 1.0f;
+
+    if (material.flags & MATERIAL_REFLECTIVE)
+    {
+        fresnelKt = 1.0f - fresnel(scene, ray, hitInfo.normal, material.refractivity);
+    }
+
+    contribution = weight * fresnelKt;
+    return Ray(refractionDir, hitInfo.position + epsilon * refractionDir);
+}
+
+// Adds the reflection and refraction chains to the directly lit color of the ray's hit
+static vec3<f32> traceSecondaryRays(const RenderScene& scene, const Ray& ray, const HitInfo& initialHitInfo, const vec3<f32>& directColor)
+{
+    auto currentRay = ray;
+    auto currentHitInfo = initialHitInfo;
+    auto currentFragColor = directColor;
+    auto reflectionWeight = 1.0f;
+
+    // Compute Reflection
+    const auto reflectionCount = scene.getReflectionCount();
+    {
+        INSTRUMENT_STAGE(STAGE_REFLECTION);
+        for (auto i = 0U; i < reflectionCount; ++i)
+        {
+            if (!currentHitInfo.hit) break;
+
+            f32 contribution;
+            currentRay = reflectRay(scene, ray, currentRay, currentHitInfo, reflectionWeight, contribution);
+            currentHitInfo = intersectScene(scene, currentRay);        
+            currentFragColor += contribution * traceForEachLight(scene, currentRay, currentHitInfo);
+        }
+    }
+
+    // Compute Refraction
+    const auto refractionCount = scene.getRefractionCount();
+    auto refractionWeight = 1.0f;
+    currentRay = ray;    
+    currentHitInfo = initialHitInfo;
+    {
+        INSTRUMENT_STAGE(STAGE_REFRACTION);
+        for (auto i = 0U; i < refractionCount; ++i)
+        {
+            if (!currentHitInfo.hit) break;
+
+            f32 contribution;
+            currentRay = refractRay(scene, currentRay, currentHitInfo, refractionWeight, contribution);
+            currentHitInfo = intersectScene(scene, currentRay);                
+            currentFragColor += contribution * traceForEachLight(scene, currentRay, currentHitInfo);
+        }
+    }
+
+    return currentFragColor;
+}
+
+static inline HitInfo intersectPrimary(const RenderScene& scene, const Ray& ray)
+{
+    INSTRUMENT_STAGE(STAGE_PRIMARY_INTERSECTION);
+    return intersectScene(scene, ray);
+}
+
+vec3<f32> trace(const RenderScene& scene, const Ray& ray)
+{    
+    const auto hitInfo = intersectPrimary(scene, ray);
+    return traceSecondaryRays(scene, ray, hitInfo, traceForEachLight(scene, ray, hitInfo));
+}
+
+void tracePacket(const RenderScene& scene, const Ray* rays, const uint32 rayCount, vec3<f32>* colors)
+{
+    if (rayCount < PACKET_MIN_RAY_COUNT || !isPacketTracingSupported())
+    {
+        for (auto i = 0U; i < rayCount; ++i)
+        {
+            colors[i] = trace(scene, rays[i]);
+        }
+        return;
+    }
+
+    HitInfo hitInfos[RAY_PACKET_SIZE];
+    {
+        INSTRUMENT_STAGE(STAGE_PRIMARY_INTERSECTION);
+        intersectSceneBatch(scene, rays, rayCount, hitInfos, true);
+    }
+
+    uint32 hitRays[RAY_PACKET_SIZE];
+    auto hitCount = 0U;
+    for (auto i = 0U; i < rayCount; ++i)
+    {
+        colors[i] = hitInfos[i].hit ? scene.getMaterial(hitInfos[i].surfaceMatIndex).ambient : vec3<f32>();
+        if (hitInfos[i].hit) hitRays[hitCount++] = i;
+    }
+
+    // Shadow rays of the rays that hit something, traced as a packet per light unless too few remain
+    const auto* lights = scene.getLights();
+    const auto lightCount = scene.getLightCount();
+    for (auto light = 0U; light < lightCount && hitCount > 0; ++light)
+    {
+        Ray shadowRays[RAY_PACKET_SIZE];
+        f32 shadowMaxT[RAY_PACKET_SIZE];
+        uint8 blocked[RAY_PACKET_SIZE];
+        for (auto i = 0U; i < hitCount; ++i)
+        {
+            shadowRays[i] = getShadowRay(lights[light], hitInfos[hitRays[i]], shadowMaxT[i]);
+        }
+
+        {
+            INSTRUMENT_STAGE(STAGE_SHADOW_RAYS);
+            occludedBatch(scene, shadowRays, shadowMaxT, hitCount, blocked, true);
+        }
+
+        for (auto i = 0U; i < hitCount; ++i)
+        {
+            const auto ray = hitRays[i];
+            colors[ray] += blocked[i] ? vec3<f32>() : shadeUnoccluded(scene, rays[ray], lights[light], hitInfos[ray], shadowRays[i]);
+        }
+    }
+
+    // Reflections and refractions scatter in every direction, hence are traced one ray at a time
+    for (auto i = 0U; i < rayCount; ++i)
+    {
+        colors[i] = traceSecondaryRays(scene, rays[i], hitInfos[i], colors[i]);
+    }
+}
+
+const char* getCostMetricName(const CostMetric metric)
+{
+    switch (metric)
+    {
+        case COST_METRIC_NONE: return "none";
+        case COST_METRIC_CYCLES: return "cycles";
+        case COST_METRIC_INTERSECTION_TESTS: return "intersection tests";
+        case COST_METRIC_BVH_NODES: return "BVH nodes visited";
+        default: return "unknown";
+    }
+}
+
+bool isCostMetricSupported(const CostMetric metric)
+{
+    return metric == COST_METRIC_NONE || metric == COST_METRIC_CYCLES || isInstrumentationEnabled();
+}
+
+// Running total of the calling thread's cost, the cost of a pixel being the difference around it
+static inline uint64 readThreadCost(const CostMetric metric)
+{
+    switch (metric)
+    {
+        case COST_METRIC_CYCLES: return readCycleCounter();
+        case COST_METRIC_INTERSECTION_TESTS:
+        {
+            const auto& counters = getThreadInstrumentation().totals.counters;
+            return counters[COUNTER_SPHERE_TESTS] + counters[COUNTER_PLANE_TESTS];
+        }
+        case COST_METRIC_BVH_NODES: return getThreadInstrumentation().totals.counters[COUNTER_BVH_NODES_VISITED];
+        default: return 0;
+    }
+}
+
+RenderStats renderImage(Image& resultImage,
+                        ThreadPool& threadPool,
+                        const bool& renderStopFlag,
+                        progress_callback onProgress,
+                        const Image* previousPass,
+                        const uint32 finalScale,
+                        const RenderOptions& options,
+                        Image* costImage)
+{
+    const auto renderWidth = resultImage.getWidth();
+    const auto renderHeight = resultImage.getHeight();
+
+    // Costs can only be told apart per pixel when every pixel is traced on its own
+    const auto costMetric = costImage != nullptr ? options.costMetric : COST_METRIC_NONE;
+    if (costMetric != COST_METRIC_NONE)
+    {
+        costImage->resize(renderWidth, renderHeight);
+    }
+
+    // Pixels are sampled at the center of their top left pixel in the final pass,
+    // which makes the samples of consecutive passes line up
+    const auto sampleScale = static_cast<sint32>(maxu(1U, finalScale));
+    const auto finalWidth = renderWidth * sampleScale;
+    const auto finalHeight = renderHeight * sampleScale;
+
+    // The even pixels of this pass coincide with the samples of a previous pass at
+    // exactly half the resolution, so they are copied over instead of being traced
+    const auto reusePreviousPass = previousPass != nullptr && costMetric == COST_METRIC_NONE &&
+                                   previousPass->getWidth() * 2 == renderWidth &&
+                                   previousPass->getHeight() * 2 == renderHeight;
+
+    // Compute ray direction parameters    
+    const auto invWidth = 1.0f / finalWidth;
+    const auto invHeight = 1.0f / finalHeight;
+    const auto fov = PI / 3.0f; 
+    const auto aspect = static_cast<f32>(finalWidth) / finalHeight;
+    const auto angle = tan(fov * 0.5f);
+
+    // The whole render traces against the same snapshot, whose BVH is built here (by all the workers)
+    // unless it is shared with an earlier snapshot that already had it built by the same builder
+    const auto instrumentationStart = collectInstrumentation();
+    const auto snapshot = Scene::get().getSnapshot();
+    const auto bvhBuildStart = chrono::steady_clock::now();
+    auto bvhBuilt = false;
+    {
+        INSTRUMENT_TRACED_STAGE(STAGE_BVH_BUILD);
+        bvhBuilt = snapshot->prepareBVH(options.bvhBuilder, &threadPool);
+    }
+    const auto bvhBuildMs = bvhBuilt ? chrono::duration<f64, milli>(chrono::steady_clock::now() - bvhBuildStart).count() : 0.0;
+
+    // Flattened into plain arrays, so the kernels are free of indirections and virtual calls
+    const auto sceneCompileStart = chrono::steady_clock::now();
+    const RenderScene scene(snapshot, options.bvhBuilder);
+    const auto sceneCompileMs = chrono::duration<f64, milli>(chrono::steady_clock::now() - sceneCompileStart).count();
+
+    const auto renderStart = chrono::steady_clock::now();
+
+    const auto threadCount = threadPool.getThreadCount();
+    const auto tileSize = maxu(1U, options.tileSize);
+    TileScheduler scheduler(renderWidth, renderHeight, tileSize, threadCount, options.tileOrder);
+    const auto tileCount = scheduler.getTileCount();
+    atomic<uint32> tilesRendered(0);
+    atomic<uint64> raysTraced(0);
+
+    // Main Ray-tracing workers, pulling tiles off the scheduler until no work is left
+    vector<WorkerStats> workerStats(threadCount);
+    // Packets cover blocks of 4 x 2 pixels, whereas single rays are traced pixel by pixel.
+    // Wavefronts gather the blocks of a whole tile, so that its packets are coherent as well.
+    const auto packetTracing = options.packetTracing && costMetric == COST_METRIC_NONE;
+    const auto wavefront = options.wavefront && costMetric == COST_METRIC_NONE;
+    const auto blockWidth = packetTracing || wavefront ? sint32(RAY_PACKET_SIZE / 2) : 1;
+    const auto blockHeight = packetTracing || wavefront ? 2 : 1;
+
+    // Blocks of a full tile, in the tile order. Partial tiles at
+    // the image edges skip the blocks that fall outside of them.
+    const auto blocksPerTileRow = (tileSize + blockWidth - 1) / blockWidth;
+    const auto blockOrder = getTraversalOrder(blocksPerTileRow, (tileSize + blockHeight - 1) / blockHeight, options.tileOrder);
+
+    threadPool.dispatch([&scene, &resultImage, &scheduler, &tilesRendered, &raysTraced, &renderStopFlag, &workerStats, &blockOrder, previousPass, reusePreviousPass, sampleScale, invWidth, invHeight, angle, aspect, packetTracing, wavefront, blockWidth, blockHeight, blocksPerTileRow, costImage, costMetric](const uint32 i)
+    {
+        const auto initialRayCount = threadRayCount;
+        const auto initialShadowRayCount = threadShadowRayCount;
+        auto primaryRayCount = 0ULL;
+        auto busyTime = chrono::steady_clock::duration::zero();
+        auto tilesTraced = 0U;
+
+        // Wavefront storage, reused for every tile of this worker
+        WavefrontQueues wavefrontQueues;
+        vector<Ray> tileRays;
+        vector<vec3<f32>*> tileRayPixels;
+        vector<vec3<f32>> tileColors;
+
+        Tile tile;
+        while (!renderStopFlag && scheduler.nextTile(i, tile))
+        {
+            INSTRUMENT_TRACED_STAGE(STAGE_TILE);
+            const auto tileStart = chrono::steady_clock::now();
+            const auto tileInitialRayCount = threadRayCount;
+
+            const auto tileView = resultImage.getView(tile.x0, tile.y0, tile.x1, tile.y1);
+            tileRays.clear();
+            tileRayPixels.clear();
+
+            // Pixels are traced in blocks of neighbours, which make for coherent packets
+            for (const auto block: blockOrder)
+            {
+                const auto blockX = tile.x0 + static_cast<sint32>(block % blocksPerTileRow) * blockWidth;
+                const auto blockY = tile.y0 + static_cast<sint32>(block / blocksPerTileRow) * blockHeight;
+                if (blockX >= tile.x1 || blockY >= tile.y1) continue;
+
+                Ray rays[RAY_PACKET_SIZE];
+                vec3<f32>* rayPixels[RAY_PACKET_SIZE];
+                auto rayCount = 0U;
+
+                for (auto y = blockY; y < blockY + blockHeight && y < tile.y1; ++y)
+                {
+                    auto* tileRow = tileView[y - tile.y0] - tile.x0;
+                    const auto* previousPassRow = reusePreviousPass && (y & 1) == 0 ? (*previousPass)[y / 2] : nullptr;
+
+                    for (auto x = blockX; x < blockX + blockWidth && x < tile.x1; ++x)
+                    {
+                        if (previousPassRow && (x & 1) == 0)
+                        {
+                            tileRow[x] = previousPassRow[x / 2];
+                            continue;
+                        }
+
+                        // Transform to normalized coordinates
+                        const auto xx = (2 * ((x * sampleScale + 0.5f) * invWidth) - 1) * angle * aspect;
+                        const auto yy = (1 - 2 * ((y * sampleScale + 0.5f) * invHeight)) * angle;
+                
+                        // Compute ray direction
+                        vec3<f32> rayDirection(xx, yy, -1.0f);
+                        rayDirection = normalize(rayDirection);
+
+                        rays[rayCount] = Ray(rayDirection, vec3<f32>());
+                        rayPixels[rayCount++] = &tileRow[x];
+                    }
+                }
+
+                primaryRayCount += rayCount;
+
+                // Perform Ray tracing
+                if (wavefront)
+                {
+                    tileRays.insert(tileRays.end(), rays, rays + rayCount);
+                    tileRayPixels.insert(tileRayPixels.end(), rayPixels, rayPixels + rayCount);
+                }
+                else if (packetTracing)
+                {
+                    vec3<f32> colors[RAY_PACKET_SIZE];
+                    tracePacket(scene, rays, rayCount, colors);
+                    for (auto ray = 0U; ray < rayCount; ++ray)
+                    {
+                        *rayPixels[ray] = colors[ray];
+                    }
+                }
+                else if (rayCount > 0 && costMetric != COST_METRIC_NONE)
+                {
+                    const auto costStart = readThreadCost(costMetric);
+                    *rayPixels[0] = trace(scene, rays[0]);
+                    const auto cost = static_cast<f32>(readThreadCost(costMetric) - costStart);
+                    (*costImage)[blockY][blockX] = vec3<f32>(cost, cost, cost);
+                }
+                else if (rayCount > 0)
+                {
+                    *rayPixels[0] = trace(scene, rays[0]);
+                }
+            }
+
+            if (wavefront)
+            {
+                const auto tileRayCount = static_cast<uint32>(tileRays.size());
+                tileColors.resize(tileRayCount);
+                traceWavefront(scene, tileRays.data(), tileRayCount, tileColors.data(), wavefrontQueues, packetTracing);
+                for (auto ray = 0U; ray < tileRayCount; ++ray)
+                {
+                    *tileRayPixels[ray] = tileColors[ray];
+                }
+            }
+
+            busyTime += chrono::steady_clock::now() - tileStart;
+            tilesTraced++;
+
+            // Only read by the progress reports, so no ordering is required
+            raysTraced.fetch_add(threadRayCount - tileInitialRayCount, memory_order_relaxed);
+            tilesRendered.fetch_add(1, memory_order_relaxed);
+        }
+
+        workerStats[i].busyMs = chrono::duration<f64, milli>(busyTime).count();
+        workerStats[i].rayCount = threadRayCount - initialRayCount;
+        workerStats[i].primaryRayCount = primaryRayCount;
+        workerStats[i].shadowRayCount = threadShadowRayCount - initialShadowRayCount;
+        workerStats[i].tileCount = tilesTraced;
+        workerStats[i].stealCount = scheduler.getStealCount(i);
+    });
+
+    // Progress is reported from the calling thread, which sleeps on the pool 
+    // inbetween reports instead of polling the workers
+    if (onProgress)
+    {
+        auto lastTilesCompleted = 0U;
+        auto reportProgress = [&onProgress, &tilesRendered, &raysTraced, &lastTilesCompleted, tileCount, renderStart]()
+        {
+            RenderProgress progress;
+            progress.tilesCompleted = tilesRendered.load(memory_order_relaxed);
+            if (progress.tilesCompleted == lastTilesCompleted) return;
+
+            lastTilesCompleted = progress.tilesCompleted;
+            progress.tileCount = tileCount;
+            progress.rayCount = raysTraced.load(memory_order_relaxed);
+            progress.elapsedMs = chrono::duration<f64, milli>(chrono::steady_clock::now() - renderStart).count();
+            progress.raysPerSecond = progress.elapsedMs > 0.0 ? progress.rayCount / (progress.elapsedMs / 1000.0) : 0.0;
+            progress.etaMs = progress.elapsedMs * (tileCount - progress.tilesCompleted) / progress.tilesCompleted;
+            onProgress(progress);
+        };
+
+        while (!threadPool.waitFor(PROGRESS_REPORT_INTERVAL_MS))
+        {
+            reportProgress();
+        }
+
+        if (!renderStopFlag)
+        {
+            reportProgress();
+        }
+    }
+
+    threadPool.wait();
+
+    RenderStats stats;
+    stats.elapsedMs = chrono::duration<f64, milli>(chrono::steady_clock::now() - renderStart).count();
+    stats.rayCount = 0;
+    stats.primaryRayCount = 0;
+    stats.shadowRayCount = 0;
+    for (const auto& workerStat: workerStats)
+    {
+        stats.rayCount += workerStat.rayCount;
+        stats.primaryRayCount += workerStat.primaryRayCount;
+        stats.shadowRayCount += workerStat.shadowRayCount;
+    }
+    stats.secondaryRayCount = stats.rayCount - stats.primaryRayCount - stats.shadowRayCount;
+    stats.threadCount = threadCount;
+    stats.bvhBuildMs = bvhBuildMs;
+    stats.bvhSAHCost = scene.getBVH().getSAHCost();
+    stats.bvhBuilder = options.bvhBuilder;
+    stats.sceneCompileMs = sceneCompileMs;
+    stats.workerStats = move(workerStats);
+    stats.instrumentation = collectInstrumentation() - instrumentationStart;
+    return stats;
+}
+
+uint32 getDefaultThreadCount()
+{
+    // hardware_concurrency is allowed to return 0 when it can't be determined
+    return maxu(1U, thread::hardware_concurrency());
+}
\ No newline at end of file
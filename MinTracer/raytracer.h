@@ -0,0 +1,236 @@
+/**********************************************************************/
+/** raytracer.h by Alex Koukoulas (C) 2017 All Rights Reserved       **/
+/** File Description: Interface to the platform agnostic Ray tracing **/
+/** core (intersection, shading and tracing of the current scene)    **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "renderscene.h"
+#include "image.h"
+#include "raypacket.h"
+#include "tilescheduler.h"
+#include "instrumentation.h"
+
+// Remote Headers
+#include <functional>
+#include <vector>
+
+// HitInfo is essentially the info storage Struct
+// for each Ray being cast
+struct HitInfo
+{
+    bool hit;
+    vec3<f32> position;
+    vec3<f32> normal;
+    uint8 surfaceMatIndex;
+    f32 t;
+
+    HitInfo(){}
+
+    HitInfo(const bool hit,
+            const vec3<f32>& position,
+            const vec3<f32>& normal,
+            const uint8& surfaceMatIndex,
+            const f32 t)
+        : hit(hit)
+        , position(position)
+        , normal(normal)
+        , surfaceMatIndex(surfaceMatIndex)
+        , t(t)
+    {
+    }
+};
+
+// Per worker summary, used to verify that the load is balanced
+struct WorkerStats
+{
+    f64 busyMs;
+    uint64 rayCount;
+    uint64 primaryRayCount;
+    uint64 shadowRayCount;
+    uint32 tileCount;
+    uint32 stealCount;
+};
+
+// Summary of a single renderImage invocation
+struct RenderStats
+{
+    f64 elapsedMs;
+    uint64 rayCount;
+    uint64 primaryRayCount;
+    uint64 secondaryRayCount;  // Reflection and refraction rays
+    uint64 shadowRayCount;
+    uint32 threadCount;
+    f64 bvhBuildMs;      // 0 unless the BVH was built (or refit) for this render
+    f32 bvhSAHCost;
+    BVHBuilder bvhBuilder;
+    f64 sceneCompileMs;
+    std::vector<WorkerStats> workerStats;
+
+    // Counters and stage times of this render, all zero unless built with MINTRACER_INSTRUMENTATION
+    InstrumentationTotals instrumentation;
+};
+
+// Snapshot of an ongoing renderImage invocation, handed to the progress callback
+struct RenderProgress
+{
+    uint32 tilesCompleted;
+    uint32 tileCount;
+    uint64 rayCount;
+    f64 elapsedMs;
+    f64 raysPerSecond;
+    f64 etaMs;
+};
+
+using progress_callback = std::function<void(const RenderProgress& progress)>;
+
+// Distance along the ray to the nearest intersection in front of its origin, 0 on a miss
+f32 rayPlaneDistance(const Ray& ray, const Plane& plane);
+f32 raySphereDistance(const Ray& ray, const Sphere& sphere);
+
+HitInfo rayPlaneIntersectionTest(const Ray& ray, const Plane& plane);
+HitInfo raySphereIntersectionTest(const Ray& ray, const Sphere& sphere);
+
+// Closest primitive along a ray: the distance to it, and its index in the compiled scene's
+// spheres or planes (whichever it is, with the other NO_PRIMITIVE). Both NO_PRIMITIVE on a miss.
+struct PrimitiveHit
+{
+    f32 t;
+    uint32 sphere;
+    uint32 plane;
+};
+
+// The scene dependent kernels trace against a compiled scene, in two phases. closestHit only
+// finds the distance to and index of the closest primitive, so that the many candidates
+// discarded on the way cost no hit attributes. getHitInfo then computes the attributes of the
+// one hit kept. intersectScene runs both phases.
+PrimitiveHit closestHit(const RenderScene& scene, const Ray& ray);
+HitInfo getHitInfo(const RenderScene& scene, const Ray& ray, const PrimitiveHit& primitiveHit);
+HitInfo intersectScene(const RenderScene& scene, const Ray& ray);
+
+// Any-hit query, checking whether anything blocks the ray before tMax.
+// Cheaper than intersectScene, as it stops at the first blocker found
+// and computes no hit attributes.
+bool occluded(const RenderScene& scene, const Ray& ray, const f32 tMax);
+
+// Batched forms of intersectScene and occluded, with identical results and ray counts. Consecutive
+// rays are traced as packets when usePackets is set and packets are supported, so coherent
+// rays should be batched next to each other. blocked is set to 1 for occluded rays, 0 otherwise.
+void intersectSceneBatch(const RenderScene& scene, const Ray* rays, const uint32 rayCount, HitInfo* hitInfos, const bool usePackets);
+void occludedBatch(const RenderScene& scene, const Ray* rays, const f32* tMax, const uint32 rayCount, uint8* blocked, const bool usePackets);
+
+// Ray from the hit position, displaced off the surface, towards the light, 
+// along with the distance up to which it has to be tested for blockers
+Ray getShadowRay(const RenderLight& light, const HitInfo& hitInfo, f32& tMax);
+
+// Shading of a fragment the light is known to reach through the shadow ray
+vec3<f32> shadeUnoccluded(const RenderScene& scene, const Ray& ray, const RenderLight& light, const HitInfo& hitInfo, const Ray& shadowRay);
+
+vec3<f32> shade(const RenderScene& scene, const Ray& ray, const RenderLight& light, const HitInfo& hitInfo);
+vec3<f32> traceForEachLight(const RenderScene& scene, const Ray& ray, const HitInfo& hitInfo);
+f32 fresnel(const RenderScene& scene, const Ray& ray, const vec3<f32>& normal, const f32 ior);
+
+// Single bounces of the reflection and refraction chains that trace follows, off the surface
+// the chain's current ray hit. The chain's weight is scaled by the surface's, and contribution
+// is set to the factor the directly lit color of the bounced ray is added to the pixel with.
+// Reflections mirror the chain's primary ray, refractions bend the current one.
+Ray reflectRay(const RenderScene& scene, const Ray& primaryRay, const Ray& ray, const HitInfo& hitInfo, f32& weight, f32& contribution);
+Ray refractRay(const RenderScene& scene, const Ray& ray, const HitInfo& hitInfo, f32& weight, f32& contribution);
+
+vec3<f32> trace(const RenderScene& scene, const Ray& ray);
+
+// Traces up to RAY_PACKET_SIZE coherent rays (e.g. the primary rays of neighbouring pixels)
+// into colors, with identical results to tracing each one. Their closest hits and shadow rays
+// are traced as packets, while their reflections and refractions are traced one by one.
+// Falls back to tracing every ray on its own when packets aren't supported or too few rays are left.
+void tracePacket(const RenderScene& scene, const Ray* rays, const uint32 rayCount, vec3<f32>* colors);
+
+// What the per pixel cost of a render is measured in
+enum CostMetric
+{
+    COST_METRIC_NONE,
+    COST_METRIC_CYCLES,              // Cycle counter ticks spent tracing the pixel
+    COST_METRIC_INTERSECTION_TESTS,  // Ray sphere and ray plane tests of the pixel's rays
+    COST_METRIC_BVH_NODES,           // BVH nodes visited by the pixel's rays
+    COST_METRIC_COUNT
+};
+
+const char* getCostMetricName(const CostMetric metric);
+
+// Test and node counts are only kept in builds with MINTRACER_INSTRUMENTATION defined
+bool isCostMetricSupported(const CostMetric metric);
+
+// Per render settings
+struct RenderOptions
+{
+    // Whether primary rays are traced in packets of neighbouring pixels, or one at a time
+    bool packetTracing;
+
+    // Whether tiles are traced as a whole, stage by stage (see traceWavefront), rather than
+    // pixel by pixel. Its queued rays are traced in packets as well, unless packetTracing is off.
+    bool wavefront;
+
+    // Edge length of the square tiles handed to the workers, in pixels
+    uint32 tileSize;
+
+    // Order in which the tiles, and the pixels (or packet blocks) of each tile, are traced
+    TileOrder tileOrder;
+
+    // Builder of the BVH, if the snapshot doesn't have one built by it already. The
+    // LBVH suits interactive edits best, whereas the SAH builders make for faster renders.
+    BVHBuilder bvhBuilder;
+
+    // Cost measured for every pixel into the cost image handed to renderImage, if any
+    CostMetric costMetric;
+
+    RenderOptions()
+        : packetTracing(true)
+        , wavefront(false)
+        , tileSize(DEFAULT_TILE_SIZE)
+        , tileOrder(TILE_ORDER_HILBERT)
+        , bvhBuilder(BVH_BUILDER_BINNED_SAH)
+        , costMetric(COST_METRIC_NONE)
+    {
+    }
+};
+
+class ThreadPool;
+
+// Ray traces the current scene snapshot into every pixel of resultImage. The snapshot is
+// compiled into a RenderScene and held on to for the whole render, so edits made meanwhile
+// only affect later renders. The image is split into tiles, which are distributed
+// amongst the pool's workers with work stealing.
+// The render can be aborted early through renderStopFlag.
+//
+// While the workers are busy, the calling thread sleeps and wakes up periodically
+// to report progress through onProgress, whenever more tiles have been completed.
+// A final report is always made once every tile is done.
+//
+// For progressive refinement, finalScale is the (power of two) ratio between the
+// resolution of the final pass and this one. Every pass then samples a subset of the
+// final pass' pixel centers, and if previousPass is a completed pass at exactly half
+// this resolution, its samples are reused for a quarter of the pixels. The final pass
+// (finalScale 1) ends up identical to rendering its resolution from scratch.
+//
+// The image is identical regardless of the options, which only affect how it is traced.
+//
+// Given a costImage and a cost metric in the options, the cost of every pixel is stored in
+// all the channels of the matching costImage pixel (see Image::toHeatmap), costImage being
+// resized to the render resolution. Every pixel is then traced on its own, one ray at a time
+// and without reusing previousPass, as packets and wavefronts share their work between pixels.
+RenderStats renderImage(Image& resultImage,
+                        ThreadPool& threadPool,
+                        const bool& renderStopFlag,
+                        progress_callback onProgress = nullptr,
+                        const Image* previousPass = nullptr,
+                        const uint32 finalScale = 1,
+                        const RenderOptions& options = RenderOptions(),
+                        Image* costImage = nullptr);
+
+// Worker count used when none is specified, i.e. the hardware concurrency
+uint32 getDefaultThreadCount();
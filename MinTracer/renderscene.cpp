@@ -0,0 +1,99 @@
+/**********************************************************************/
+/** renderscene.cpp by Alex Koukoulas (C) 2017 All Rights Reserved   **/
+/** File Description: Compilation of scene snapshots into the render **/
+/** ready RenderScene                                                **/
+/**********************************************************************/
+
+// Local Headers
+#include "renderscene.h"
+#include "spherekernels.h"
+
+RenderScene::RenderScene(std::shared_ptr<const SceneSnapshot> snapshot, const BVHBuilder bvhBuilder)
+    : _snapshot(std::move(snapshot))
+    , _bvh(nullptr)
+    , _sphereCount(0U)
+    , _reflectionCount(_snapshot->getReflectionCount())
+    , _refractionCount(_snapshot->getRefractionCount())
+    , _fresnelPower(_snapshot->getFresnelPower())
+    , _linearSpheres(false)
+{
+    _snapshot->prepareBVH(bvhBuilder);
+    _bvh = &_snapshot->getBVH(bvhBuilder);
+
+    // Spheres are laid out in BVH order, which is all the kernels ever index them by
+    const auto& bvh = *_bvh;
+    const auto sphereCount = static_cast<uint32>(bvh.getSphereCount());
+    const auto paddedSphereCount = sphereCount + SPHERE_KERNEL_MAX_WIDTH;
+    _spheres.centerX.resize(paddedSphereCount);
+    _spheres.centerY.resize(paddedSphereCount);
+    _spheres.centerZ.resize(paddedSphereCount);
+    _spheres.radius.resize(paddedSphereCount);
+    _spheres.radiusSq.resize(paddedSphereCount);
+    _spheres.matIndex.resize(paddedSphereCount);
+    _spheres.sceneIndex.resize(paddedSphereCount);
+    for (auto i = 0U; i < sphereCount; ++i)
+    {
+        const auto& sphere = bvh.getSphere(i);
+        _spheres.centerX[i] = sphere.center.x;
+        _spheres.centerY[i] = sphere.center.y;
+        _spheres.centerZ[i] = sphere.center.z;
+        _spheres.radius[i] = sphere.radius;
+        _spheres.radiusSq[i] = sphere.radius * sphere.radius;
+        _spheres.matIndex[i] = sphere.matIndex;
+        _spheres.sceneIndex[i] = bvh.getSphereIndex(i);
+    }
+    _sphereCount = sphereCount;
+    _linearSpheres = sphereCount <= LINEAR_SPHERE_THRESHOLD;
+
+    const auto planeCount = _snapshot->getPlaneCount();
+    _planes.normalX.resize(planeCount);
+    _planes.normalY.resize(planeCount);
+    _planes.normalZ.resize(planeCount);
+    _planes.d.resize(planeCount);
+    _planes.matIndex.resize(planeCount);
+    for (auto i = 0U; i < planeCount; ++i)
+    {
+        const auto& plane = _snapshot->getPlane(i);
+        _planes.normalX[i] = plane.normal.x;
+        _planes.normalY[i] = plane.normal.y;
+        _planes.normalZ[i] = plane.normal.z;
+        _planes.d[i] = plane.d;
+        _planes.matIndex[i] = plane.matIndex;
+    }
+
+    const auto materialCount = _snapshot->getMaterialCount();
+    _materials.resize(materialCount);
+    for (auto i = 0U; i < materialCount; ++i)
+    {
+        const auto& material = _snapshot->getMaterial(i);
+        auto& renderMaterial = _materials[i];
+        renderMaterial.ambient = material.ambient;
+        renderMaterial.diffuse = material.diffuse;
+        renderMaterial.specular = material.specular;
+        renderMaterial.glossiness = material.glossiness;
+        renderMaterial.refractivity = material.refractivity;
+        renderMaterial.flags = 0U;
+
+        if (material.reflectivity > 0.0f) renderMaterial.flags |= MATERIAL_REFLECTIVE;
+        if (material.refractivity > 1.0f) renderMaterial.flags |= MATERIAL_REFRACTIVE;
+
+        // A negative glossiness can turn the highlight of a black specular into NaNs,
+        // so only non negative glossiness is safe to skip
+        if (material.specular.x != 0.0f || material.specular.y != 0.0f || material.specular.z != 0.0f || material.glossiness < 0.0f)
+        {
+            renderMaterial.flags |= MATERIAL_SPECULAR;
+        }
+    }
+
+    const auto lightCount = _snapshot->getLightCount();
+    _lights.resize(lightCount);
+    for (auto i = 0U; i < lightCount; ++i)
+    {
+        const auto& light = _snapshot->getLight(i);
+        auto& renderLight = _lights[i];
+        renderLight.position = light.position;
+        renderLight.color = light.color;
+        renderLight.lightType = light.getLightType();
+        renderLight.falloff = renderLight.lightType == Light::POINT_LIGHT ? 4 * PI * static_cast<const PointLight&>(light).radius : 1.0f;
+    }
+}
@@ -0,0 +1,132 @@
+/**********************************************************************/
+/** renderscene.h by Alex Koukoulas (C) 2017 All Rights Reserved     **/
+/** File Description: Interface to the render ready (compiled) form  **/
+/** of a scene snapshot, which the Ray tracing kernels operate on    **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "bvh.h"
+
+// Remote Headers
+#include <memory>
+#include <vector>
+
+// Up to this many spheres fit in a single BVH leaf anyway, so they are tested
+// linearly instead, sparing every ray the traversal setup and bounds tests
+const uint32 LINEAR_SPHERE_THRESHOLD = 8;
+
+// Precomputed material flags, sparing the kernels from re-deriving them on every hit
+const uint32 MATERIAL_REFLECTIVE = 1 << 0;  // reflectivity > 0
+const uint32 MATERIAL_REFRACTIVE = 1 << 1;  // refractivity > 1
+const uint32 MATERIAL_SPECULAR   = 1 << 2;  // non black specular color, i.e. the glossy highlight contributes
+
+struct RenderMaterial
+{
+    vec3<f32> ambient;
+    vec3<f32> diffuse;
+    vec3<f32> specular;
+    f32 glossiness;
+    f32 refractivity;
+    uint32 flags;
+};
+
+// Lights flattened into a tagged POD, with no virtual calls or downcasts needed to shade
+struct RenderLight
+{
+    vec3<f32> position;
+    vec3<f32> color;
+    f32 falloff;      // 4 * PI * radius for point lights, unused otherwise
+    uint32 lightType; // Light::LightType
+};
+
+// Spheres as a structure of arrays, stored in BVH order so that the spheres of a
+// leaf are contiguous in every array. The arrays are padded past the last sphere,
+// so that the SIMD kernels can load whole blocks at any offset.
+struct RenderSpheres
+{
+    std::vector<f32> centerX;
+    std::vector<f32> centerY;
+    std::vector<f32> centerZ;
+    std::vector<f32> radius;
+    std::vector<f32> radiusSq;
+    std::vector<uint32> matIndex;
+    std::vector<uint32> sceneIndex;
+};
+
+struct RenderPlanes
+{
+    std::vector<f32> normalX;
+    std::vector<f32> normalY;
+    std::vector<f32> normalZ;
+    std::vector<f32> d;
+    std::vector<uint32> matIndex;
+};
+
+// A scene snapshot compiled into plain arrays for rendering. Keeps the snapshot
+// (and hence its BVH) alive, and is immutable once compiled, so it can be
+// traced against from any number of threads.
+class RenderScene final
+{
+public:
+    // Builds the snapshot's BVH with the given builder first, unless it has already been built
+    explicit RenderScene(std::shared_ptr<const SceneSnapshot> snapshot, const BVHBuilder bvhBuilder = BVH_BUILDER_BINNED_SAH);
+
+    RenderScene(const RenderScene&) = delete;
+    RenderScene& operator = (const RenderScene&) = delete;
+
+    inline const RenderSpheres& getSpheres() const { return _spheres; }
+    inline const RenderPlanes& getPlanes() const { return _planes; }
+    inline const RenderMaterial& getMaterial(const size_t index) const { return _materials[index]; }
+    inline const RenderLight* getLights() const { return _lights.data(); }
+    inline const BVH& getBVH() const { return *_bvh; }
+
+    inline uint32 getSphereCount() const { return _sphereCount; }
+    inline uint32 getPlaneCount() const { return static_cast<uint32>(_planes.d.size()); }
+    inline uint32 getLightCount() const { return static_cast<uint32>(_lights.size()); }
+    inline uint32 getReflectionCount() const { return _reflectionCount; }
+    inline uint32 getRefractionCount() const { return _refractionCount; }
+    inline f32 getFresnelPower() const { return _fresnelPower; }
+
+    inline const SceneSnapshot& getSnapshot() const { return *_snapshot; }
+
+    // Whether the spheres are few enough to skip the BVH and be tested linearly
+    inline bool usesLinearSpheres() const { return _linearSpheres; }
+
+    // Visits the (BVH ordered) sphere ranges the ray may hit before maxT, with the same
+    // contract as BVH::traverse. Small scenes visit all of their spheres as a single range.
+    template<typename LeafVisitor>
+    void traverseSpheres(const Ray& ray, f32& maxT, LeafVisitor visitLeaf) const;
+
+private:
+    std::shared_ptr<const SceneSnapshot> _snapshot;
+    const BVH* _bvh;
+
+    RenderSpheres _spheres;
+    uint32 _sphereCount;
+    RenderPlanes _planes;
+    std::vector<RenderMaterial> _materials;
+    std::vector<RenderLight> _lights;
+
+    uint32 _reflectionCount;
+    uint32 _refractionCount;
+    f32    _fresnelPower;
+    bool   _linearSpheres;
+};
+
+template<typename LeafVisitor>
+void RenderScene::traverseSpheres(const Ray& ray, f32& maxT, LeafVisitor visitLeaf) const
+{
+    if (_linearSpheres)
+    {
+        const auto sphereCount = getSphereCount();
+        if (sphereCount > 0) visitLeaf(0U, sphereCount);
+        return;
+    }
+
+    getBVH().traverse(ray, maxT, visitLeaf);
+}
@@ -0,0 +1,160 @@
+/**********************************************************************/
+/** restorecheck.cpp by Alex Koukoulas (C) 2017 All Rights Reserved  **/
+/** File Description: Implementation of the stored BVH validation    **/
+/** check                                                            **/
+/**********************************************************************/
+
+// Local Headers
+#include "restorecheck.h"
+#include "binaryscene.h"
+#include "bvh.h"
+#include "scene.h"
+#include "scenegenerator.h"
+
+// Remote Headers
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Enough spheres for leaves of several spheres, and a few levels of interior nodes
+static const uint32 CHECK_SPHERE_COUNT = 1000;
+
+struct NodeCorruption
+{
+    const char* name;
+    std::function<bool(std::vector<BVHNode>& nodes)> corrupt;
+};
+
+static bool bvhMatches(const BVH& bvh, const std::vector<BVHNode>& nodes, const std::vector<uint32>& sphereIndices)
+{
+    return bvh.getNodeCount() == nodes.size() && bvh.getSphereCount() == sphereIndices.size() &&
+           memcmp(bvh.getNodes(), nodes.data(), nodes.size() * sizeof(BVHNode)) == 0 &&
+           memcmp(bvh.getSphereIndices(), sphereIndices.data(), sphereIndices.size() * sizeof(uint32)) == 0;
+}
+
+// Index of the first node matching the predicate, or the node count if there is none
+static size_t findNode(const std::vector<BVHNode>& nodes, const std::function<bool(const BVHNode& node)>& predicate)
+{
+    for (auto i = 0U; i < nodes.size(); ++i)
+    {
+        if (predicate(nodes[i])) return i;
+    }
+    return nodes.size();
+}
+
+static void shrinkBounds(BVHNode& node)
+{
+    node.boundsMax = node.boundsMin + (node.boundsMax - node.boundsMin) * 0.5f;
+}
+
+bool runBVHRestoreCheck(const uint64 seed, std::ostream& output)
+{
+    SceneGeneratorSettings settings;
+    settings.sphereCount = CHECK_SPHERE_COUNT;
+    settings.seed = seed;
+    const auto sourceSnapshot = SceneSnapshot::createFromContents(generateScene(settings));
+
+    std::stringstream binaryStream;
+    if (!sourceSnapshot->writeBinary(binaryStream))
+    {
+        output << "Error: Could not write the binary scene" << std::endl;
+        return false;
+    }
+
+    // Held in 64 bit words, which keeps every section suitably aligned
+    const auto binary = binaryStream.str();
+    std::vector<uint64> data((binary.size() + sizeof(uint64) - 1) / sizeof(uint64), 0);
+    auto* bytes = reinterpret_cast<uint8*>(data.data());
+    memcpy(bytes, binary.data(), binary.size());
+
+    BinarySceneHeader header;
+    memcpy(&header, bytes, sizeof(BinarySceneHeader));
+    auto* storedNodes = reinterpret_cast<BVHNode*>(bytes + header.sectionOffsets[BVH_NODE_SECTION]);
+    const auto* storedSphereIndices = reinterpret_cast<const uint32*>(bytes + header.sectionOffsets[BVH_SPHERE_INDEX_SECTION]);
+
+    const std::vector<BVHNode> intactNodes(storedNodes, storedNodes + header.sectionCounts[BVH_NODE_SECTION]);
+    const std::vector<uint32> intactSphereIndices(storedSphereIndices, storedSphereIndices + header.sectionCounts[BVH_SPHERE_INDEX_SECTION]);
+    const auto sphereCount = static_cast<uint32>(sourceSnapshot->getSphereCount());
+
+    output << "BVH restore check over " << sphereCount << " generated sphere(s) with seed " << seed << ", " << intactNodes.size() << " nodes" << std::endl;
+
+    const NodeCorruption corruptions[] =
+    {
+        { "intact", [](std::vector<BVHNode>&) { return true; } },
+        { "node shared by two parents", [](std::vector<BVHNode>& nodes)
+        {
+            // The root adopts the children of a later interior node, whose subtree is then reached twice
+            const auto other = findNode(nodes, [&nodes](const BVHNode& node) { return &node != &nodes[0] && !node.isLeaf(); });
+            if (nodes[0].isLeaf() || other == nodes.size()) return false;
+            nodes[0].leftFirst = nodes[other].leftFirst;
+            return true;
+        } },
+        { "overlapping leaf ranges", [sphereCount](std::vector<BVHNode>& nodes)
+        {
+            const auto leaf = findNode(nodes, [sphereCount](const BVHNode& node) { return node.isLeaf() && node.leftFirst + node.primCount < sphereCount; });
+            if (leaf == nodes.size()) return false;
+            nodes[leaf].primCount++;
+            return true;
+        } },
+        { "missing leaf range", [](std::vector<BVHNode>& nodes)
+        {
+            const auto leaf = findNode(nodes, [](const BVHNode& node) { return node.primCount > 1; });
+            if (leaf == nodes.size()) return false;
+            nodes[leaf].primCount--;
+            return true;
+        } },
+        { "shrunken leaf bounds", [](std::vector<BVHNode>& nodes)
+        {
+            const auto leaf = findNode(nodes, [](const BVHNode& node) { return node.isLeaf(); });
+            if (leaf == nodes.size()) return false;
+            shrinkBounds(nodes[leaf]);
+            return true;
+        } },
+        { "shrunken interior bounds", [](std::vector<BVHNode>& nodes)
+        {
+            if (nodes[0].isLeaf()) return false;
+            shrinkBounds(nodes[0]);
+            return true;
+        } }
+    };
+
+    auto passed = true;
+    for (const auto& corruption: corruptions)
+    {
+        auto nodes = intactNodes;
+        if (!corruption.corrupt(nodes))
+        {
+            output << "  " << corruption.name << ": Error: The BVH has no node to corrupt" << std::endl;
+            passed = false;
+            continue;
+        }
+
+        // Only the node array differs from the file as written
+        memcpy(storedNodes, nodes.data(), nodes.size() * sizeof(BVHNode));
+        const auto intact = &corruption == &corruptions[0];
+
+        BVH restoredBVH;
+        const auto restored = restoredBVH.restore(nodes.data(), nodes.size(), storedSphereIndices, sourceSnapshot->getSpheres());
+
+        const auto snapshot = SceneSnapshot::createFromBinary(bytes, binary.size());
+        auto loadedIntact = false;
+        if (snapshot)
+        {
+            snapshot->prepareBVH();
+            loadedIntact = bvhMatches(snapshot->getBVH(), intactNodes, intactSphereIndices);
+        }
+
+        const auto correct = restored == intact && loadedIntact;
+        passed &= correct;
+
+        output << "  " << corruption.name << ": " << (restored ? "restored" : "rejected");
+        if (restored != intact) output << " | Error: expected it to be " << (intact ? "restored" : "rejected");
+        if (!loadedIntact) output << " | Error: the loaded BVH differs from the intact one";
+        output << std::endl;
+    }
+
+    output << (passed ? "Every corrupted BVH is rebuilt" : "Error: Corrupted BVHs aren't all rebuilt") << std::endl;
+    return passed;
+}
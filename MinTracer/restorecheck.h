@@ -0,0 +1,21 @@
+/**********************************************************************/
+/** restorecheck.h by Alex Koukoulas (C) 2017 All Rights Reserved    **/
+/** File Description: Interface to the check of the validation that  **/
+/** stored BVHs go through when binary scenes are loaded             **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <ostream>
+
+// Writes a scene generated from the seed in the binary scene format, and loads it back once as is
+// and once for every way its BVH nodes get corrupted: a node shared by two parents, overlapping
+// and missing leaf ranges, and shrunken leaf and interior bounds. Checks that the intact BVH is
+// restored, and that every corrupted one is rejected and rebuilt, ending up as the intact one.
+// Works on snapshots of its own, leaving the current scene untouched. Returns false if any
+// check fails.
+bool runBVHRestoreCheck(const uint64 seed, std::ostream& output);
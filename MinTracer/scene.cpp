@@ -8,10 +8,249 @@
 // Local Headers
 #include "scene.h"
 #include "strutils.h"
+#include "bvh.h"
+#include "binaryscene.h"
+#include "mappedfile.h"
 
 // Remote Headers
+#include <algorithm>
 #include <thread>
 #include <fstream>
+#include <cstdlib>
+#include <cstring>
+
+// Zero-copy parsing helpers, operating directly on the scene description.
+// strtof and strtol are what stof and stoi use underneath, so the values 
+// parsed are identical to the ones of the previous std::string based parser.
+
+// Half open [begin, end) range of characters
+struct TextRange
+{
+    const char* begin;
+    const char* end;
+};
+
+// Retrieves the next '\n' terminated line. Returns false once all lines are consumed.
+static bool nextLine(const char*& cursor, const char* descriptionEnd, TextRange& line)
+{
+    if (cursor == descriptionEnd)
+    {
+        return false;
+    }
+
+    line.begin = cursor;
+    line.end = static_cast<const char*>(memchr(cursor, '\n', descriptionEnd - cursor));
+    if (line.end == nullptr)
+    {
+        line.end = descriptionEnd;
+    }
+    
+    cursor = line.end == descriptionEnd ? descriptionEnd : line.end + 1;
+    return true;
+}
+
+// Splits off the next ' ' separated token from the front of the line,
+// returning a pointer to its first character
+static const char* nextToken(TextRange& line)
+{
+    const auto token = line.begin;
+    while (line.begin != line.end && *line.begin != ' ')
+    {
+        line.begin++;
+    }
+
+    if (line.begin != line.end)
+    {
+        line.begin++;
+    }
+
+    return token;
+}
+
+static bool startsWith(const TextRange& line, const char* pattern)
+{
+    const auto patternLen = strlen(pattern);
+    return static_cast<size_t>(line.end - line.begin) >= patternLen && memcmp(line.begin, pattern, patternLen) == 0;
+}
+
+// Numbers are parsed up to the first character that isn't part of them, 
+// which is always a separator or the terminating null of the description
+static f32 parseF32(const char* token)
+{
+    return strtof(token, nullptr);
+}
+
+static uint32 parseUint32(const char* token)
+{
+    return static_cast<uint32>(strtol(token, nullptr, 10));
+}
+
+// Comma separated x,y,z
+static vec3<f32> parseVec3(const char* token)
+{
+    char* componentEnd;
+    vec3<f32> result;
+    result.x = strtof(token, &componentEnd);
+    result.y = strtof(*componentEnd == ',' ? componentEnd + 1 : componentEnd, &componentEnd);
+    result.z = strtof(*componentEnd == ',' ? componentEnd + 1 : componentEnd, &componentEnd);
+    return result;
+}
+
+// BVHs over the spheres of a snapshot (one per builder), shared by every snapshot with the same spheres
+struct SceneSnapshot::SharedBVH
+{
+    std::once_flag buildFlags[BVH_BUILDER_COUNT];
+    BVH bvhs[BVH_BUILDER_COUNT];
+
+    // Once spheres are edited, each builder's BVH is refit from the last one it built (its source),
+    // for the spheres edited since, rather than built from scratch. Sources always have their BVH
+    // built, so that no more than one BVH per builder is kept alive for refitting.
+    std::mutex sourceMutex;
+    bool built[BVH_BUILDER_COUNT];
+    std::shared_ptr<SharedBVH> sources[BVH_BUILDER_COUNT];
+    std::vector<uint32> editedSpheres[BVH_BUILDER_COUNT];
+
+    SharedBVH()
+        : built()
+    {
+    }
+
+    void deriveFrom(const std::shared_ptr<SharedBVH>& previous, const uint32 editedSphere)
+    {
+        std::lock_guard<std::mutex> lock(previous->sourceMutex);
+        for (auto builder = 0U; builder < BVH_BUILDER_COUNT; ++builder)
+        {
+            if (previous->built[builder])
+            {
+                sources[builder] = previous;
+            }
+            else if (previous->sources[builder])
+            {
+                sources[builder] = previous->sources[builder];
+                editedSpheres[builder] = previous->editedSpheres[builder];
+            }
+            else continue;
+
+            // Kept sorted, as a sphere dragged around is edited many times over
+            auto& edited = editedSpheres[builder];
+            const auto position = std::lower_bound(edited.begin(), edited.end(), editedSphere);
+            if (position == edited.end() || *position != editedSphere) edited.insert(position, editedSphere);
+        }
+    }
+
+    void markBuilt(const BVHBuilder builder)
+    {
+        std::lock_guard<std::mutex> lock(sourceMutex);
+        built[builder] = true;
+        sources[builder].reset();
+        editedSpheres[builder].clear();
+    }
+};
+
+const char* getBVHBuilderName(const BVHBuilder builder)
+{
+    switch (builder)
+    {
+        case BVH_BUILDER_SWEEP_SAH: return "sweep SAH";
+        case BVH_BUILDER_BINNED_SAH: return "binned SAH";
+        case BVH_BUILDER_LBVH: return "LBVH";
+        default: return "unknown";
+    }
+}
+
+SceneSnapshot::SceneSnapshot()
+    : _reflectionCount(0U)
+    , _refractionCount(0U)
+    , _fresnelPower(0.0f)
+{
+    setSpheres(std::vector<Sphere>());
+}
+
+bool SceneSnapshot::prepareBVH(const BVHBuilder builder, ThreadPool* threadPool) const
+{
+    auto built = false;
+    std::call_once(_sharedBVH->buildFlags[builder], [this, builder, threadPool, &built]()
+    {
+        std::shared_ptr<SharedBVH> source;
+        std::vector<uint32> editedSpheres;
+        {
+            std::lock_guard<std::mutex> lock(_sharedBVH->sourceMutex);
+            source = _sharedBVH->sources[builder];
+            editedSpheres = _sharedBVH->editedSpheres[builder];
+        }
+
+        auto& bvh = _sharedBVH->bvhs[builder];
+        auto refit = false;
+        if (source)
+        {
+            bvh = source->bvhs[builder];
+            refit = bvh.refit(*_spheres, editedSpheres);
+        }
+
+        if (!refit)
+        {
+            bvh.build(*_spheres, builder, threadPool);
+        }
+
+        _sharedBVH->markBuilt(builder);
+        built = true;
+    });
+    return built;
+}
+
+const BVH& SceneSnapshot::getBVH(const BVHBuilder builder) const
+{
+    return _sharedBVH->bvhs[builder];
+}
+
+void SceneSnapshot::setSpheres(std::vector<Sphere>&& spheres)
+{
+    _spheres = std::make_shared<const std::vector<Sphere>>(std::move(spheres));
+    _sharedBVH = std::make_shared<SharedBVH>();
+}
+
+void SceneSnapshot::writeText(std::ostream& outputStream) const
+{
+    outputStream << "#Reflection Count\n";
+    outputStream << _reflectionCount << "\n";
+    outputStream << "#Refraction Count\n";
+    outputStream << _refractionCount << "\n";
+    outputStream << "#Fresnel Power\n";
+    outputStream << _fresnelPower << "\n";
+
+    outputStream << "#Materials\n";
+    for (const auto& material: _materials)
+    {
+        outputStream << material.toString() << "\n";
+    }
+
+    outputStream << "#Lights\n";    
+    for (const auto& light : _lights)
+    {
+        outputStream << light->toString() << "\n";
+    }
+
+    outputStream << "#Spheres\n";    
+    for (const auto& sphere: *_spheres)
+    {
+        outputStream << sphere.toString() << "\n";
+    }
+    
+    outputStream << "#Planes\n";
+    for (const auto& plane : _planes)
+    {
+        outputStream << plane.toString() << "\n";
+    }
+    
+    outputStream << "#End";
+}
+
+std::string SceneSnapshot::toString() const
+{
+    std::stringstream result;
+    writeText(result);
+    return result.str();
+}
 
 Scene& Scene::get()
 {
@@ -24,154 +263,332 @@ Scene::~Scene()
 }
 
 Scene::Scene()
-    : _underConstruction(false)
 {
     constructDefaultScene();    
 }
 
-Sphere& Scene::getSphere(const size_t index) 
+std::shared_ptr<const SceneSnapshot> Scene::getSnapshot() const
 {
-    if (_underConstruction)
-    {
-        return _stubSphere;
-    }
-    return _spheres[index]; 
+    return std::atomic_load(&_snapshot);
 }
 
-Light& Scene::getLight(const size_t index) 
+void Scene::publish(const std::shared_ptr<const SceneSnapshot>& snapshot)
 {
-    if (_underConstruction)
-    {
-        return _stubLight;
-    }
-    return *_lights[index]; 
+    std::lock_guard<std::mutex> lock(_editMutex);
+    std::atomic_store(&_snapshot, snapshot);
 }
 
-Material& Scene::getMaterial(const size_t index) 
+void Scene::editSnapshot(const std::function<void(SceneSnapshot&)>& edit)
 {
-    if (_underConstruction)
+    std::lock_guard<std::mutex> lock(_editMutex);
+    auto snapshot = std::make_shared<SceneSnapshot>(*std::atomic_load(&_snapshot));
+    edit(*snapshot);
+    std::atomic_store(&_snapshot, std::shared_ptr<const SceneSnapshot>(std::move(snapshot)));
+}
+
+Sphere Scene::getSphere(const size_t index) const { return getSnapshot()->getSphere(index); }
+std::shared_ptr<const Light> Scene::getLight(const size_t index) const { return getSnapshot()->_lights[index]; }
+Material Scene::getMaterial(const size_t index) const { return getSnapshot()->getMaterial(index); }
+Plane Scene::getPlane(const size_t index) const { return getSnapshot()->getPlane(index); }
+
+size_t Scene::getSphereCount() const { return getSnapshot()->getSphereCount(); }
+size_t Scene::getLightCount() const { return getSnapshot()->getLightCount(); }
+size_t Scene::getMaterialCount() const { return getSnapshot()->getMaterialCount(); }
+size_t Scene::getPlaneCount() const { return getSnapshot()->getPlaneCount(); }
+uint32 Scene::getReflectionCount() const { return getSnapshot()->getReflectionCount(); }
+uint32 Scene::getRefractionCount() const { return getSnapshot()->getRefractionCount(); }
+f32 Scene::getFresnelPower() const { return getSnapshot()->getFresnelPower(); }
+
+void Scene::editSphere(const size_t index, const std::function<void(Sphere&)>& edit)
+{
+    editSnapshot([index, &edit](SceneSnapshot& snapshot)
     {
-        return _stubMaterial;
-    }
-    return _materials[index]; 
+        // The spheres are shared with the previous snapshots, hence copied before being edited
+        auto spheres = *snapshot._spheres;
+        edit(spheres[index]);
+
+        // The new BVHs are refit from the previous ones, once needed
+        const auto previousBVH = snapshot._sharedBVH;
+        snapshot.setSpheres(std::move(spheres));
+        snapshot._sharedBVH->deriveFrom(previousBVH, static_cast<uint32>(index));
+    });
 }
 
-Plane& Scene::getPlane(const size_t index) 
+void Scene::editLight(const size_t index, const std::function<void(Light&)>& edit)
 {
-    if (_underConstruction)
+    editSnapshot([index, &edit](SceneSnapshot& snapshot)
     {
-        return _stubPlane;
-    }
-    return _planes[index]; 
+        const auto& light = *snapshot._lights[index];
+        auto editedLight = light.getLightType() == Light::POINT_LIGHT ?
+            std::shared_ptr<Light>(std::make_shared<PointLight>(static_cast<const PointLight&>(light))) :
+            std::make_shared<Light>(light);
+
+        edit(*editedLight);
+        snapshot._lights[index] = editedLight;
+    });
+}
+
+void Scene::editMaterial(const size_t index, const std::function<void(Material&)>& edit)
+{
+    editSnapshot([index, &edit](SceneSnapshot& snapshot) { edit(snapshot._materials[index]); });
 }
 
-size_t Scene::getSphereCount() const { return _spheres.size(); }
-size_t Scene::getLightCount() const { return _lights.size(); }
-size_t Scene::getMaterialCount() const { return _materials.size(); }
-size_t Scene::getPlaneCount() const { return _planes.size(); }
-uint32 Scene::getReflectionCount() const { return _reflectionCount; }
-uint32 Scene::getRefractionCount() const { return _refractionCount; }
-f32 Scene::getFresnelPower() const { return _fresnelPower; }
+void Scene::editPlane(const size_t index, const std::function<void(Plane&)>& edit)
+{
+    editSnapshot([index, &edit](SceneSnapshot& snapshot) { edit(snapshot._planes[index]); });
+}
+
+void Scene::setReflectionCount(const uint32 reflectionCount) 
+{ 
+    editSnapshot([reflectionCount](SceneSnapshot& snapshot) { snapshot._reflectionCount = reflectionCount; }); 
+}
 
-void Scene::setReflectionCount(const uint32 reflectionCount) { _reflectionCount = reflectionCount; }
-void Scene::setRefractionCount(const uint32 refractionCount) { _refractionCount = refractionCount; }
-void Scene::setFresnelPower(const f32 fresnelPower) { _fresnelPower = fresnelPower; }
+void Scene::setRefractionCount(const uint32 refractionCount) 
+{ 
+    editSnapshot([refractionCount](SceneSnapshot& snapshot) { snapshot._refractionCount = refractionCount; }); 
+}
+
+void Scene::setFresnelPower(const f32 fresnelPower) 
+{ 
+    editSnapshot([fresnelPower](SceneSnapshot& snapshot) { snapshot._fresnelPower = fresnelPower; }); 
+}
 
-void Scene::saveScene(const std::string& filePath, win32::io_result_callback callbackOnCompletion)
+void Scene::saveScene(const std::string& filePath, io::io_result_callback callbackOnCompletion)
 {
     auto savingThread = std::thread([filePath, callbackOnCompletion, this]() 
     {
-        std::ofstream outputFile(filePath, std::ios::out);
-
-        if (outputFile.good())
-        {    
-            outputFile << this->toString();
-            callbackOnCompletion(win32::IO_DIALOG_RESULT_TYPE::SUCCESS);
-        }
-        else
-        {
-            callbackOnCompletion(win32::IO_DIALOG_RESULT_TYPE::FAILURE);
-        }
+        callbackOnCompletion(this->saveToFile(filePath) ? io::IO_RESULT_TYPE::SUCCESS : io::IO_RESULT_TYPE::FAILURE);
     });
 
     savingThread.detach();
 }
 
-void Scene::openScene(const std::string& filePath, win32::io_result_callback callbackOnCompletion)
+void Scene::openScene(const std::string& filePath, io::io_result_callback callbackOnCompletion)
 {
     auto openThread = std::thread([filePath, callbackOnCompletion, this]()
     {
-        std::ifstream inputFile(filePath, std::ios::in);
-
-        if (inputFile.good())
-        {
-            std::stringstream fileContents;
-            fileContents << inputFile.rdbuf();
-            this->constructFromString(fileContents.str());
-        }
-
-        callbackOnCompletion(win32::IO_DIALOG_RESULT_TYPE::SUCCESS);
+        callbackOnCompletion(this->loadFromFile(filePath) ? io::IO_RESULT_TYPE::SUCCESS : io::IO_RESULT_TYPE::FAILURE);
     });
 
     openThread.detach();
 }
 
-std::string Scene::toString() const
+bool Scene::saveToFile(const std::string& filePath) const
 {
-    std::stringstream result;
-    result << "#Reflection Count\n";
-    result << _reflectionCount << "\n";
-    result << "#Refraction Count\n";
-    result << _refractionCount << "\n";
-    result << "#Fresnel Power\n";
-    result << _fresnelPower << "\n";
-
-    result << "#Materials\n";
-    for (const auto& material: _materials)
+    const auto binary = hasBinarySceneExtension(filePath);
+    std::ofstream outputFile(filePath, binary ? std::ios::out | std::ios::binary : std::ios::out);
+
+    if (!outputFile.good())
     {
-        result << material.toString() << "\n";
+        return false;
     }
 
-    result << "#Lights\n";    
-    for (const auto& light : _lights)
+    // Saved as of the current snapshot, regardless of any edits made meanwhile
+    const auto snapshot = getSnapshot();
+
+    if (binary)
     {
-        result << light->toString() << "\n";
+        return snapshot->writeBinary(outputFile);
     }
 
-    result << "#Spheres\n";    
-    for (const auto& sphere: _spheres)
+    snapshot->writeText(outputFile);
+    return outputFile.good();
+}
+
+bool Scene::loadFromFile(const std::string& filePath)
+{
+    MappedFile inputFile(filePath);
+
+    if (!inputFile.isValid())
     {
-        result << sphere.toString() << "\n";
+        return false;
     }
-    
-    result << "#Planes\n";
-    for (const auto& plane : _planes)
+
+    if (inputFile.getSize() >= sizeof(BINARY_SCENE_MAGIC) && memcmp(inputFile.getData(), BINARY_SCENE_MAGIC, sizeof(BINARY_SCENE_MAGIC)) == 0)
     {
-        result << plane.toString() << "\n";
+        return constructFromBinary(inputFile.getData(), inputFile.getSize());
     }
-    
-    result << "#End";
 
-    return result.str();
+    // The text parser relies on the description being null terminated
+    constructFromString(std::string(reinterpret_cast<const char*>(inputFile.getData()), inputFile.getSize()));
+    return true;
 }
 
-void Scene::constructFromString(const std::string& sceneDescription)
+bool SceneSnapshot::writeBinary(std::ostream& outputStream) const
+{
+    BinarySceneHeader header = {};
+    memcpy(header.magic, BINARY_SCENE_MAGIC, sizeof(BINARY_SCENE_MAGIC));
+    header.version = BINARY_SCENE_VERSION;
+    header.reflectionCount = _reflectionCount;
+    header.refractionCount = _refractionCount;
+    header.fresnelPower = _fresnelPower;
+
+    std::vector<BinaryLight> lights(_lights.size());
+    for (auto i = 0U; i < _lights.size(); ++i)
+    {
+        lights[i].position = _lights[i]->position;
+        lights[i].color = _lights[i]->color;
+        lights[i].lightType = _lights[i]->getLightType();
+        lights[i].radius = lights[i].lightType == Light::POINT_LIGHT ? static_cast<const PointLight&>(*_lights[i]).radius : 0.0f;
+    }
+
+    // The BVH is stored along, saving the time to build it when loading
+    prepareBVH();
+    const auto& bvh = getBVH();
+    const auto& spheres = getSpheres();
+    const auto includeBVH = !spheres.empty();
+    if (includeBVH)
+    {
+        header.flags |= BINARY_SCENE_HAS_BVH;
+    }
+
+    const void* sectionData[SECTION_COUNT] = { _materials.data(), lights.data(), spheres.data(), _planes.data(), bvh.getNodes(), bvh.getSphereIndices() };
+    const size_t sectionElementSizes[SECTION_COUNT] = { sizeof(Material), sizeof(BinaryLight), sizeof(Sphere), sizeof(Plane), sizeof(BVHNode), sizeof(uint32) };
+    header.sectionCounts[MATERIAL_SECTION] = _materials.size();
+    header.sectionCounts[LIGHT_SECTION] = lights.size();
+    header.sectionCounts[SPHERE_SECTION] = spheres.size();
+    header.sectionCounts[PLANE_SECTION] = _planes.size();
+    header.sectionCounts[BVH_NODE_SECTION] = includeBVH ? bvh.getNodeCount() : 0;
+    header.sectionCounts[BVH_SPHERE_INDEX_SECTION] = includeBVH ? bvh.getSphereCount() : 0;
+
+    // Lay out the sections one after the other, each starting on an aligned offset
+    auto offset = static_cast<uint64>(sizeof(BinarySceneHeader));
+    for (auto i = 0U; i < SECTION_COUNT; ++i)
+    {
+        offset = (offset + BINARY_SCENE_SECTION_ALIGNMENT - 1) & ~static_cast<uint64>(BINARY_SCENE_SECTION_ALIGNMENT - 1);
+        header.sectionOffsets[i] = offset;
+        offset += header.sectionCounts[i] * sectionElementSizes[i];
+    }
+
+    outputStream.write(reinterpret_cast<const char*>(&header), sizeof(BinarySceneHeader));
+
+    const char padding[BINARY_SCENE_SECTION_ALIGNMENT] = {};
+    auto writtenBytes = static_cast<uint64>(sizeof(BinarySceneHeader));
+    for (auto i = 0U; i < SECTION_COUNT; ++i)
+    {
+        const auto sectionSize = header.sectionCounts[i] * sectionElementSizes[i];
+        outputStream.write(padding, static_cast<std::streamsize>(header.sectionOffsets[i] - writtenBytes));
+        outputStream.write(static_cast<const char*>(sectionData[i]), static_cast<std::streamsize>(sectionSize));
+        writtenBytes = header.sectionOffsets[i] + sectionSize;
+    }
+
+    return outputStream.good();
+}
+
+std::shared_ptr<const SceneSnapshot> SceneSnapshot::createFromBinary(const uint8* data, const size_t dataSize)
+{
+    if (dataSize < sizeof(BinarySceneHeader))
+    {
+        return nullptr;
+    }
+
+    BinarySceneHeader header;
+    memcpy(&header, data, sizeof(BinarySceneHeader));
+
+    if (memcmp(header.magic, BINARY_SCENE_MAGIC, sizeof(BINARY_SCENE_MAGIC)) != 0 || header.version != BINARY_SCENE_VERSION)
+    {
+        return nullptr;
+    }
+
+    // Validate every section before building anything
+    const size_t sectionElementSizes[SECTION_COUNT] = { sizeof(Material), sizeof(BinaryLight), sizeof(Sphere), sizeof(Plane), sizeof(BVHNode), sizeof(uint32) };
+    for (auto i = 0U; i < SECTION_COUNT; ++i)
+    {
+        if (header.sectionOffsets[i] % BINARY_SCENE_SECTION_ALIGNMENT != 0 ||
+            header.sectionOffsets[i] > dataSize ||
+            header.sectionCounts[i] > (dataSize - header.sectionOffsets[i]) / sectionElementSizes[i])
+        {
+            return nullptr;
+        }
+    }
+
+    const auto* materials = reinterpret_cast<const Material*>(data + header.sectionOffsets[MATERIAL_SECTION]);
+    const auto* lights = reinterpret_cast<const BinaryLight*>(data + header.sectionOffsets[LIGHT_SECTION]);
+    const auto* spheres = reinterpret_cast<const Sphere*>(data + header.sectionOffsets[SPHERE_SECTION]);
+    const auto* planes = reinterpret_cast<const Plane*>(data + header.sectionOffsets[PLANE_SECTION]);
+
+    auto snapshot = std::make_shared<SceneSnapshot>();
+
+    // Apart from the lights, every array is copied over as a whole
+    snapshot->_materials.assign(materials, materials + header.sectionCounts[MATERIAL_SECTION]);
+    snapshot->setSpheres(std::vector<Sphere>(spheres, spheres + header.sectionCounts[SPHERE_SECTION]));
+    snapshot->_planes.assign(planes, planes + header.sectionCounts[PLANE_SECTION]);
+
+    for (auto i = 0U; i < header.sectionCounts[LIGHT_SECTION]; ++i)
+    {
+        if (lights[i].lightType == Light::POINT_LIGHT)
+        {
+            snapshot->_lights.push_back(std::make_shared<PointLight>(lights[i].position, lights[i].color, lights[i].radius));
+        }
+        else
+        {
+            snapshot->_lights.push_back(std::make_shared<Light>(lights[i].position, lights[i].color));
+        }
+    }
+
+    snapshot->_reflectionCount = header.reflectionCount;
+    snapshot->_refractionCount = header.refractionCount;
+    snapshot->_fresnelPower = header.fresnelPower;
+
+    // A stored BVH saves building it, unless it turns out to be invalid. It is adopted
+    // as the default builder's, which is the one saving the BVH along.
+    if ((header.flags & BINARY_SCENE_HAS_BVH) != 0 && header.sectionCounts[BVH_SPHERE_INDEX_SECTION] == snapshot->getSphereCount())
+    {
+        auto& sharedBVH = *snapshot->_sharedBVH;
+        auto& bvh = sharedBVH.bvhs[BVH_BUILDER_BINNED_SAH];
+        std::call_once(sharedBVH.buildFlags[BVH_BUILDER_BINNED_SAH], [&sharedBVH, &bvh, &snapshot, &header, data]()
+        {
+            if (!bvh.restore(reinterpret_cast<const BVHNode*>(data + header.sectionOffsets[BVH_NODE_SECTION]), 
+                             static_cast<size_t>(header.sectionCounts[BVH_NODE_SECTION]),
+                             reinterpret_cast<const uint32*>(data + header.sectionOffsets[BVH_SPHERE_INDEX_SECTION]), 
+                             snapshot->getSpheres()))
+            {
+                bvh.build(snapshot->getSpheres(), BVH_BUILDER_BINNED_SAH);
+            }
+            sharedBVH.markBuilt(BVH_BUILDER_BINNED_SAH);
+        });
+    }
+
+    return snapshot;
+}
+
+bool Scene::constructFromBinary(const uint8* data, const size_t dataSize)
 {
-    _underConstruction = true;
-    _lights.clear();
-    _materials.clear();
-    _spheres.clear();
-    _planes.clear();
+    const auto snapshot = SceneSnapshot::createFromBinary(data, dataSize);
+    if (!snapshot)
+    {
+        return false;
+    }
 
-    _reflectionCount = 0U;
-    _refractionCount = 0U;
-    _fresnelPower = 0.0f;
+    publish(snapshot);
+    return true;
+}
 
-    const auto sceneDescLines = strutils::split(sceneDescription, '\n');
+std::string Scene::toString() const
+{
+    return getSnapshot()->toString();
+}
 
-    _reflectionCount = std::stoi(sceneDescLines[1]);
-    _refractionCount = std::stoi(sceneDescLines[3]);
-    _fresnelPower = std::stof(sceneDescLines[5]);
+void Scene::constructFromString(const std::string& sceneDescription)
+{
+    // Constructed off to the side, and published once complete
+    auto snapshot = std::make_shared<SceneSnapshot>();
+    std::vector<Sphere> spheres;
+
+    // The description is parsed in place, without building any temporary strings
+    auto cursor = sceneDescription.c_str();
+    const auto descriptionEnd = cursor + sceneDescription.size();
+    
+    // Header lines, alternating between a comment and a value
+    TextRange headerLines[6] = {};
+    for (auto& headerLine: headerLines)
+    {
+        nextLine(cursor, descriptionEnd, headerLine);
+    }
+
+    snapshot->_reflectionCount = parseUint32(headerLines[1].begin);
+    snapshot->_refractionCount = parseUint32(headerLines[3].begin);
+    snapshot->_fresnelPower = parseF32(headerLines[5].begin);
     
     enum ParsingState
     {
@@ -179,13 +596,13 @@ void Scene::constructFromString(const std::string& sceneDescription)
     };
 
     auto parsingState = MATERIAL;
-    auto lineCursor = 7; // Start of material entries
 
-    while (parsingState != END)
-    {
-        const auto& currentLine = sceneDescLines[lineCursor++];
-        const auto currentLineComps = strutils::split(currentLine, ' ');
+    // Skip the "#Materials" line, before the start of material entries
+    TextRange currentLine;
+    nextLine(cursor, descriptionEnd, currentLine);
 
+    while (parsingState != END && nextLine(cursor, descriptionEnd, currentLine))
+    {
         switch (parsingState)
         {
             case MATERIAL:
@@ -193,9 +610,16 @@ void Scene::constructFromString(const std::string& sceneDescription)
                 // Could optimize start of next states with fewer letters
                 // such as "#L", but kept the full redundant check against
                 // "#Lights" for clarity
-                if (!strutils::startsWith(currentLine, "#Lights"))
+                if (!startsWith(currentLine, "#Lights"))
                 {
-                    _materials.push_back(Material(currentLineComps));
+                    Material material;
+                    material.ambient = parseVec3(nextToken(currentLine));
+                    material.diffuse = parseVec3(nextToken(currentLine));
+                    material.specular = parseVec3(nextToken(currentLine));
+                    material.glossiness = parseF32(nextToken(currentLine));
+                    material.reflectivity = parseF32(nextToken(currentLine));
+                    material.refractivity = parseF32(nextToken(currentLine));
+                    snapshot->_materials.push_back(material);
                 }
                 else
                 {
@@ -205,11 +629,20 @@ void Scene::constructFromString(const std::string& sceneDescription)
 
             case LIGHT:
             {
-                if (!strutils::startsWith(currentLine, "#Spheres"))
+                if (!startsWith(currentLine, "#Spheres"))
                 {
-                    _lights.push_back(currentLineComps.size() > 2 ? 
-                        std::make_unique<PointLight>(currentLineComps) :
-                        std::make_unique<Light>(currentLineComps));
+                    const auto position = parseVec3(nextToken(currentLine));
+                    const auto color = parseVec3(nextToken(currentLine));
+
+                    // Lights with a third component are point lights
+                    if (currentLine.begin != currentLine.end)
+                    {
+                        snapshot->_lights.push_back(std::make_shared<PointLight>(position, color, parseF32(nextToken(currentLine))));
+                    }
+                    else
+                    {
+                        snapshot->_lights.push_back(std::make_shared<Light>(position, color));
+                    }
                 }
                 else
                 {
@@ -219,9 +652,11 @@ void Scene::constructFromString(const std::string& sceneDescription)
 
             case SPHERE:
             {
-                if (!strutils::startsWith(currentLine, "#Planes"))
+                if (!startsWith(currentLine, "#Planes"))
                 {
-                    _spheres.push_back(Sphere(currentLineComps));
+                    const auto radius = parseF32(nextToken(currentLine));
+                    const auto center = parseVec3(nextToken(currentLine));
+                    spheres.emplace_back(radius, center, parseUint32(nextToken(currentLine)));
                 }
                 else
                 {
@@ -231,43 +666,71 @@ void Scene::constructFromString(const std::string& sceneDescription)
 
             case PLANE:
             {
-                if (strutils::startsWith(currentLine, "#End"))
+                if (startsWith(currentLine, "#End"))
                 {
                     parsingState = END;
                 }
                 else
                 {
-                    _planes.push_back(Plane(currentLineComps));
+                    const auto normal = parseVec3(nextToken(currentLine));
+                    const auto d = parseF32(nextToken(currentLine));
+                    snapshot->_planes.emplace_back(normal, d, parseUint32(nextToken(currentLine)));
                 }
             } break;
         }
     }
-    _underConstruction = false;
+    snapshot->setSpheres(std::move(spheres));
+    publish(snapshot);
+}
+
+std::shared_ptr<const SceneSnapshot> SceneSnapshot::createFromContents(SceneContents&& contents)
+{
+    auto snapshot = std::make_shared<SceneSnapshot>();
+    snapshot->_materials = std::move(contents.materials);
+    snapshot->_lights = std::move(contents.lights);
+    snapshot->_planes = std::move(contents.planes);
+    snapshot->_reflectionCount = contents.reflectionCount;
+    snapshot->_refractionCount = contents.refractionCount;
+    snapshot->_fresnelPower = contents.fresnelPower;
+
+    snapshot->setSpheres(std::move(contents.spheres));
+    return snapshot;
+}
+
+void Scene::constructFromContents(SceneContents&& contents)
+{
+    publish(SceneSnapshot::createFromContents(std::move(contents)));
 }
 
 void Scene::constructDefaultScene()
 {
-    _lights.emplace_back(std::make_unique<PointLight>(vec3<f32>(0.0f, -0.5f, -6.0f), vec3<f32>(1.0f, 1.0f, 1.0f), 0.2f));
-
-    _materials.emplace_back(vec3<f32>(0.0f, 0.0f, 0.0f), vec3<f32>(0.0f, 0.0f, 0.0f), vec3<f32>(0.0f, 0.0f, 0.0f), 0.0f, 0.0f, 0.0f);
-    _materials.emplace_back(vec3<f32>(0.3f, 0.1f, 0.1f), vec3<f32>(0.9f, 0.3f, 0.3f), vec3<f32>(0.9f, 0.3f, 0.3f), 128.0f, 1.0f, 1.10f);
-    _materials.emplace_back(vec3<f32>(0.2f, 0.2f, 0.2f), vec3<f32>(0.3f, 0.3f, 0.3f), vec3<f32>(0.3f, 0.3f, 0.3f), 1.0f, 0.5f, 1.05f);
-    _materials.emplace_back(vec3<f32>(0.2f, 0.2f, 0.2f), vec3<f32>(0.5f, 0.5f, 0.5f), vec3<f32>(0.5f, 0.5f, 0.5f), 1.0f, 0.1f, 0.0f);
-    _materials.emplace_back(vec3<f32>(0.2f, 0.2f, 0.2f), vec3<f32>(0.5f, 0.5f, 0.5f), vec3<f32>(0.5f, 0.5f, 0.5f), 1.0f, 0.0f, 0.0f);
-    _materials.emplace_back(vec3<f32>(0.1f, 0.1f, 0.4f), vec3<f32>(0.3f, 0.3f, 0.9f), vec3<f32>(0.3f, 0.3f, 0.9f), 24.0f, 0.0f, 0.0f);
-
-    _spheres.emplace_back(2.0f, vec3<f32>(-3.0f, 1.0f, -4.0f), 1);
-    _spheres.emplace_back(0.3f, vec3<f32>(0.5f, 0.0f, -1.3f), 2);
-    _spheres.emplace_back(0.5f, vec3<f32>(2.0f, 0.0f, -5.0f), 5);
-
-    _planes.emplace_back(vec3<f32>(0.0f, 0.0f, 1.0f), 10.0f, 3);
-    _planes.emplace_back(vec3<f32>(0.0f, 0.0f, -1.0f), 2.0f, 4);
-    _planes.emplace_back(vec3<f32>(0.0f, 1.0f, 0.0f), 2.0f, 4);
-    _planes.emplace_back(vec3<f32>(0.0f, -1.0f, 0.0f), 4.0f, 4);
-    _planes.emplace_back(vec3<f32>(-1.0f, 0.0f, 0.0f), 4.0f, 4);
-    _planes.emplace_back(vec3<f32>(1.0f, 0.0f, 0.0f), 4.0f, 4);    
-
-    _reflectionCount = 1;
-    _refractionCount = 2;
-    _fresnelPower = 1.5f;
+    auto snapshot = std::make_shared<SceneSnapshot>();
+    std::vector<Sphere> spheres;
+
+    snapshot->_lights.emplace_back(std::make_shared<PointLight>(vec3<f32>(0.0f, -0.5f, -6.0f), vec3<f32>(1.0f, 1.0f, 1.0f), 0.2f));
+
+    snapshot->_materials.emplace_back(vec3<f32>(0.0f, 0.0f, 0.0f), vec3<f32>(0.0f, 0.0f, 0.0f), vec3<f32>(0.0f, 0.0f, 0.0f), 0.0f, 0.0f, 0.0f);
+    snapshot->_materials.emplace_back(vec3<f32>(0.3f, 0.1f, 0.1f), vec3<f32>(0.9f, 0.3f, 0.3f), vec3<f32>(0.9f, 0.3f, 0.3f), 128.0f, 1.0f, 1.10f);
+    snapshot->_materials.emplace_back(vec3<f32>(0.2f, 0.2f, 0.2f), vec3<f32>(0.3f, 0.3f, 0.3f), vec3<f32>(0.3f, 0.3f, 0.3f), 1.0f, 0.5f, 1.05f);
+    snapshot->_materials.emplace_back(vec3<f32>(0.2f, 0.2f, 0.2f), vec3<f32>(0.5f, 0.5f, 0.5f), vec3<f32>(0.5f, 0.5f, 0.5f), 1.0f, 0.1f, 0.0f);
+    snapshot->_materials.emplace_back(vec3<f32>(0.2f, 0.2f, 0.2f), vec3<f32>(0.5f, 0.5f, 0.5f), vec3<f32>(0.5f, 0.5f, 0.5f), 1.0f, 0.0f, 0.0f);
+    snapshot->_materials.emplace_back(vec3<f32>(0.1f, 0.1f, 0.4f), vec3<f32>(0.3f, 0.3f, 0.9f), vec3<f32>(0.3f, 0.3f, 0.9f), 24.0f, 0.0f, 0.0f);
+
+    spheres.emplace_back(2.0f, vec3<f32>(-3.0f, 1.0f, -4.0f), 1);
+    spheres.emplace_back(0.3f, vec3<f32>(0.5f, 0.0f, -1.3f), 2);
+    spheres.emplace_back(0.5f, vec3<f32>(2.0f, 0.0f, -5.0f), 5);
+
+    snapshot->_planes.emplace_back(vec3<f32>(0.0f, 0.0f, 1.0f), 10.0f, 3);
+    snapshot->_planes.emplace_back(vec3<f32>(0.0f, 0.0f, -1.0f), 2.0f, 4);
+    snapshot->_planes.emplace_back(vec3<f32>(0.0f, 1.0f, 0.0f), 2.0f, 4);
+    snapshot->_planes.emplace_back(vec3<f32>(0.0f, -1.0f, 0.0f), 4.0f, 4);
+    snapshot->_planes.emplace_back(vec3<f32>(-1.0f, 0.0f, 0.0f), 4.0f, 4);
+    snapshot->_planes.emplace_back(vec3<f32>(1.0f, 0.0f, 0.0f), 4.0f, 4);    
+
+    snapshot->_reflectionCount = 1;
+    snapshot->_refractionCount = 2;
+    snapshot->_fresnelPower = 1.5f;
+
+    snapshot->setSpheres(std::move(spheres));
+    publish(snapshot);
 }
\ No newline at end of file
@@ -8,12 +8,15 @@
 
 // Local Headers
 #include "math.h"
-#include "win32gui.h"
+#include "iotypes.h"
 
 // Remote Headers
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <functional>
+#include <mutex>
 
 struct Material
 {
@@ -189,6 +192,8 @@ struct Ray
     vec3<f32> direction;
     vec3<f32> origin;
 
+    Ray(){}
+
     Ray(const vec3<f32>& direction, const vec3<f32>& origin)
         : direction(direction)
         , origin(origin)
@@ -203,16 +208,125 @@ struct Ray
     }
 };
 
+// Objects making up a scene, for scenes put together in code (e.g. procedurally generated ones)
+// rather than parsed from a description
+struct SceneContents
+{
+    std::vector<Material> materials;
+    std::vector<std::shared_ptr<const Light>> lights;
+    std::vector<Sphere> spheres;
+    std::vector<Plane> planes;
+    uint32 reflectionCount;
+    uint32 refractionCount;
+    f32 fresnelPower;
+
+    SceneContents()
+        : reflectionCount(0U)
+        , refractionCount(0U)
+        , fresnelPower(0.0f)
+    {
+    }
+};
+
+class BVH;
+class ThreadPool;
+
+// Ways of building the BVH over the spheres, each trading build time for tree quality.
+// The BVH only affects how fast a scene is traced, never what the image looks like.
+enum BVHBuilder
+{
+    BVH_BUILDER_SWEEP_SAH,   // Surface Area Heuristic evaluated at every primitive, the best trees but slowest to build
+    BVH_BUILDER_BINNED_SAH,  // Surface Area Heuristic evaluated at a few bins, nearly as good and much faster to build
+    BVH_BUILDER_LBVH,        // Morton code sorted spheres split at their highest differing bit, the fastest to build
+    BVH_BUILDER_COUNT
+};
+
+const char* getBVHBuilderName(const BVHBuilder builder);
+
+// Immutable state of the scene at some point in time. Renders trace against 
+// a snapshot, which stays alive for as long as they hold on to it, while edits
+// and loads publish new snapshots through the Scene (read-copy-update).
+// Snapshots share their spheres, and the BVH built over them, with the 
+// snapshots they were derived from, for as long as the spheres are unchanged.
+class SceneSnapshot final
+{
+public:
+    SceneSnapshot();
+
+    inline const Sphere& getSphere(const size_t index) const { return (*_spheres)[index]; }
+    inline const Light& getLight(const size_t index) const { return *_lights[index]; }
+    inline const Material& getMaterial(const size_t index) const { return _materials[index]; }
+    inline const Plane& getPlane(const size_t index) const { return _planes[index]; }
+    inline uint32 getReflectionCount() const { return _reflectionCount; }
+    inline uint32 getRefractionCount() const { return _refractionCount; }
+    inline f32 getFresnelPower() const { return _fresnelPower; }
+
+    inline size_t getSphereCount() const { return _spheres->size(); }
+    inline size_t getLightCount() const { return _lights.size(); }
+    inline size_t getMaterialCount() const { return _materials.size(); }
+    inline size_t getPlaneCount() const { return _planes.size(); }
+
+    inline const std::vector<Sphere>& getSpheres() const { return *_spheres; }
+
+    // Builds the BVH over the snapshot's spheres with the given builder (on the pool's workers
+    // if one is given), unless the builder has already built one for them. Every builder's
+    // BVH is kept separately. Snapshots with edited spheres refit the builder's BVH of the
+    // snapshot they were edited from instead, falling back to a build if the refit tree would
+    // be too poor. Safe to call concurrently. Returns true if a build (or refit) took place.
+    bool prepareBVH(const BVHBuilder builder = BVH_BUILDER_BINNED_SAH, ThreadPool* threadPool = nullptr) const;
+
+    // Only valid after prepareBVH with the same builder
+    const BVH& getBVH(const BVHBuilder builder = BVH_BUILDER_BINNED_SAH) const;
+
+    // Writes the text form straight to the stream, without holding all of it in memory
+    void writeText(std::ostream& outputStream) const;
+    std::string toString() const;
+
+    // Writes the binary scene format, along with the default builder's BVH (built first if need be)
+    bool writeBinary(std::ostream& outputStream) const;
+
+    // Snapshots of their own, not published to the Scene
+    static std::shared_ptr<const SceneSnapshot> createFromContents(SceneContents&& contents);
+
+    // Returns nullptr if the data isn't a valid binary scene. A stored BVH is adopted as the
+    // default builder's, unless it turns out to be invalid, in which case it is rebuilt. The data
+    // is expected to be suitably aligned, as is the case for mapped files.
+    static std::shared_ptr<const SceneSnapshot> createFromBinary(const uint8* data, const size_t dataSize);
+
+private:
+    friend class Scene;
+    struct SharedBVH;
+
+    // Replaces the spheres, along with the BVH built over them
+    void setSpheres(std::vector<Sphere>&& spheres);
+
+private:
+    std::vector<std::shared_ptr<const Light>> _lights;
+    std::shared_ptr<const std::vector<Sphere>> _spheres;
+    std::vector<Material> _materials;
+    std::vector<Plane> _planes;
+    std::shared_ptr<SharedBVH> _sharedBVH;
+
+    uint32 _reflectionCount;
+    uint32 _refractionCount;
+    f32    _fresnelPower;
+};
+
 class Scene final
 {
 public:
     static Scene& get();
     ~Scene();
 
-    Sphere& getSphere(const size_t index);
-    Light& getLight(const size_t index);
-    Material& getMaterial(const size_t index);
-    Plane& getPlane(const size_t index);
+    // The most recently published snapshot. Renders hold on to it for their whole 
+    // duration, and are hence unaffected by any edits made in the meantime.
+    std::shared_ptr<const SceneSnapshot> getSnapshot() const;
+
+    // Copies of the objects of the current snapshot
+    Sphere getSphere(const size_t index) const;
+    std::shared_ptr<const Light> getLight(const size_t index) const;
+    Material getMaterial(const size_t index) const;
+    Plane getPlane(const size_t index) const;
     uint32 getReflectionCount() const;
     uint32 getRefractionCount() const;
     f32 getFresnelPower() const;
@@ -222,37 +336,45 @@ public:
     size_t getMaterialCount() const;
     size_t getPlaneCount() const;
 
+    // Every edit publishes a new snapshot, a copy of the current one with the edit applied
+    void editSphere(const size_t index, const std::function<void(Sphere&)>& edit);
+    void editLight(const size_t index, const std::function<void(Light&)>& edit);
+    void editMaterial(const size_t index, const std::function<void(Material&)>& edit);
+    void editPlane(const size_t index, const std::function<void(Plane&)>& edit);
     void setReflectionCount(const uint32 reflectionCount);
     void setRefractionCount(const uint32 refractionCount);
     void setFresnelPower(const f32 fresnelPower);
 
-    void saveScene(const std::string& filePath, win32::io_result_callback callbackOnCompletion);
-    void openScene(const std::string& filePath, win32::io_result_callback callbackOnCompletion);
+    void saveScene(const std::string& filePath, io::io_result_callback callbackOnCompletion);
+    void openScene(const std::string& filePath, io::io_result_callback callbackOnCompletion);
+
+    // Synchronous counterparts of saveScene and openScene. Files with the .scnb 
+    // extension are saved in the binary scene format, including the BVH, while 
+    // any other extension gets the text format. Files are opened as binary 
+    // scenes if they start with the binary scene magic.
+    bool saveToFile(const std::string& filePath) const;
+    bool loadFromFile(const std::string& filePath);
 
     std::string toString() const;
     void constructFromString(const std::string& sceneDescription);
+    void constructFromContents(SceneContents&& contents);
+    
+    // Returns false if the data isn't a valid binary scene. The data is
+    // expected to be suitably aligned, as is the case for mapped files.
+    bool constructFromBinary(const uint8* data, const size_t dataSize);
 
 private:
     Scene();
     void constructDefaultScene();
 
-private:
-    std::vector<std::unique_ptr<Light>> _lights;    
-    std::vector<Sphere> _spheres;
-    std::vector<Material> _materials;
-    std::vector<Plane> _planes;
-
-    uint32 _reflectionCount;
-    uint32 _refractionCount;
-    f32    _fresnelPower;
+    // Applies the edit to a copy of the current snapshot and publishes it
+    void editSnapshot(const std::function<void(SceneSnapshot&)>& edit);
+    void publish(const std::shared_ptr<const SceneSnapshot>& snapshot);
 
-    Light _stubLight;
-    Sphere _stubSphere;
-    Material _stubMaterial;
-    Plane _stubPlane;
+private:
+    // Only ever accessed through the std::atomic_load/atomic_store overloads
+    std::shared_ptr<const SceneSnapshot> _snapshot;
 
-    // This flag is used when the scene is currently loading from file,
-    // to not cause race conditions when the scene objects are being polled
-    // from the ray tracing threads.
-    bool   _underConstruction;
+    // Serializes edits, so that concurrent edits can't lose one another
+    std::mutex _editMutex;
 };
\ No newline at end of file
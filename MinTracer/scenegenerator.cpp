@@ -0,0 +1,179 @@
+/************************************************************************/
+/** scenegenerator.cpp by Alex Koukoulas (C) 2017 All Rights Reserved **/
+/** File Description: Implementation of the procedural scene          **/
+/** generator                                                         **/
+/************************************************************************/
+
+// Local Headers
+#include "scenegenerator.h"
+#include "seededrandom.h"
+
+// Remote Headers
+#include <cmath>
+
+// Box the spheres are spread over, in front of the camera looking down -z from the origin
+static const vec3<f32> SPHERE_BOX_MIN(-6.0f, -4.0f, -24.0f);
+static const vec3<f32> SPHERE_BOX_MAX(6.0f, 4.0f, -6.0f);
+
+// Radius of every clump of the clustered distribution
+static const f32 CLUSTER_RADIUS = 1.0f;
+
+// Radius of the overlapping spheres, which is large enough for any two of them to overlap
+// given that their centers are at most OVERLAP_CENTER_SPREAD apart along each axis
+static const f32 OVERLAP_RADIUS = 2.0f;
+static const f32 OVERLAP_CENTER_SPREAD = 1.0f;
+
+// Cross section and length of the rod of the thin distribution, starting at the front of the box
+static const f32 THIN_ROD_WIDTH = 0.5f;
+static const f32 THIN_ROD_LENGTH = 1000.0f;
+
+// Largest sphere radius, relative to the edge of the share of the box each sphere gets
+static const f32 SPHERE_RADIUS_SCALE = 0.4f;
+
+// Materials the spheres pick from. The first material is the unlit one, followed by the
+// diffuse ones (the first of which is the planes'), the reflective and the refractive ones.
+static const uint32 DIFFUSE_MATERIAL_COUNT = 4;
+static const uint32 REFLECTIVE_MATERIAL_COUNT = 2;
+static const uint32 REFRACTIVE_MATERIAL_COUNT = 2;
+
+static const uint32 FIRST_DIFFUSE_MATERIAL = 1;
+static const uint32 FIRST_REFLECTIVE_MATERIAL = FIRST_DIFFUSE_MATERIAL + DIFFUSE_MATERIAL_COUNT;
+static const uint32 FIRST_REFRACTIVE_MATERIAL = FIRST_REFLECTIVE_MATERIAL + REFLECTIVE_MATERIAL_COUNT;
+
+const char* getSceneDistributionName(const SceneDistribution distribution)
+{
+    switch (distribution)
+    {
+        case SCENE_DISTRIBUTION_UNIFORM: return "uniform";
+        case SCENE_DISTRIBUTION_CLUSTERED: return "clustered";
+        case SCENE_DISTRIBUTION_OVERLAPPING: return "overlapping";
+        case SCENE_DISTRIBUTION_THIN: return "thin";
+        default: return "unknown";
+    }
+}
+
+static vec3<f32> nextPointInBox(SeededRandom& random, const vec3<f32>& boxMin, const vec3<f32>& boxMax)
+{
+    return vec3<f32>(random.nextFloat(boxMin.x, boxMax.x), random.nextFloat(boxMin.y, boxMax.y), random.nextFloat(boxMin.z, boxMax.z));
+}
+
+static std::vector<Material> generateMaterials(SeededRandom& random)
+{
+    std::vector<Material> materials;
+    materials.emplace_back(vec3<f32>(0.0f, 0.0f, 0.0f), vec3<f32>(0.0f, 0.0f, 0.0f), vec3<f32>(0.0f, 0.0f, 0.0f), 0.0f, 0.0f, 0.0f);
+
+    for (auto i = 0U; i < DIFFUSE_MATERIAL_COUNT; ++i)
+    {
+        const auto color = i == 0 ? vec3<f32>(0.5f, 0.5f, 0.5f) : vec3<f32>(random.nextFloat(0.2f, 0.9f), random.nextFloat(0.2f, 0.9f), random.nextFloat(0.2f, 0.9f));
+        materials.emplace_back(color * 0.3f, color, color, random.nextFloat(1.0f, 64.0f), 0.0f, 0.0f);
+    }
+
+    for (auto i = 0U; i < REFLECTIVE_MATERIAL_COUNT; ++i)
+    {
+        const auto color = vec3<f32>(random.nextFloat(0.3f, 0.9f), random.nextFloat(0.3f, 0.9f), random.nextFloat(0.3f, 0.9f));
+        materials.emplace_back(color * 0.2f, color, color, 128.0f, random.nextFloat(0.4f, 0.9f), 0.0f);
+    }
+
+    for (auto i = 0U; i < REFRACTIVE_MATERIAL_COUNT; ++i)
+    {
+        materials.emplace_back(vec3<f32>(0.1f, 0.1f, 0.1f), vec3<f32>(0.3f, 0.3f, 0.3f), vec3<f32>(0.3f, 0.3f, 0.3f), 128.0f, 0.1f, random.nextFloat(1.05f, 1.5f));
+    }
+
+    return materials;
+}
+
+SceneContents generateScene(const SceneGeneratorSettings& settings)
+{
+    SeededRandom random(settings.seed);
+
+    SceneContents contents;
+    contents.reflectionCount = settings.reflectionCount;
+    contents.refractionCount = settings.refractionCount;
+    contents.fresnelPower = 1.0f;
+    contents.materials = generateMaterials(random);
+
+    // Lights split the brightness of a single white light amongst them, so that the image doesn't burn out
+    for (auto i = 0U; i < settings.lightCount; ++i)
+    {
+        const vec3<f32> position(random.nextFloat(SPHERE_BOX_MIN.x, SPHERE_BOX_MAX.x), SPHERE_BOX_MAX.y, random.nextFloat(SPHERE_BOX_MIN.z, SPHERE_BOX_MAX.z));
+        contents.lights.emplace_back(std::make_shared<PointLight>(position, vec3<f32>(1.0f, 1.0f, 1.0f) * (1.0f / settings.lightCount), 0.2f));
+    }
+
+    // Region the sphere centers fall in, along with the volume the spheres share amongst them
+    auto regionMin = SPHERE_BOX_MIN;
+    auto regionMax = SPHERE_BOX_MAX;
+    const auto boxExtent = SPHERE_BOX_MAX - SPHERE_BOX_MIN;
+    auto volume = boxExtent.x * boxExtent.y * boxExtent.z;
+    std::vector<vec3<f32>> clusterCenters;
+
+    switch (settings.distribution)
+    {
+        case SCENE_DISTRIBUTION_CLUSTERED:
+        {
+            const auto clusterExtent = vec3<f32>(CLUSTER_RADIUS, CLUSTER_RADIUS, CLUSTER_RADIUS);
+            clusterCenters.resize(maxu(1U, settings.clusterCount));
+            for (auto& clusterCenter: clusterCenters)
+            {
+                clusterCenter = nextPointInBox(random, SPHERE_BOX_MIN + clusterExtent, SPHERE_BOX_MAX - clusterExtent);
+            }
+            volume = clusterCenters.size() * 8.0f * CLUSTER_RADIUS * CLUSTER_RADIUS * CLUSTER_RADIUS;
+        } break;
+
+        case SCENE_DISTRIBUTION_OVERLAPPING:
+        {
+            const auto center = (SPHERE_BOX_MIN + SPHERE_BOX_MAX) * 0.5f;
+            const auto spread = vec3<f32>(OVERLAP_CENTER_SPREAD, OVERLAP_CENTER_SPREAD, OVERLAP_CENTER_SPREAD) * 0.5f;
+            regionMin = center - spread;
+            regionMax = center + spread;
+        } break;
+
+        case SCENE_DISTRIBUTION_THIN:
+        {
+            regionMin = vec3<f32>(-0.5f * THIN_ROD_WIDTH, -0.5f * THIN_ROD_WIDTH, SPHERE_BOX_MAX.z - THIN_ROD_LENGTH);
+            regionMax = vec3<f32>(0.5f * THIN_ROD_WIDTH, 0.5f * THIN_ROD_WIDTH, SPHERE_BOX_MAX.z);
+            volume = THIN_ROD_WIDTH * THIN_ROD_WIDTH * THIN_ROD_LENGTH;
+        } break;
+
+        default: break;
+    }
+
+    // Floor just below the box, and back wall just behind the spheres
+    contents.planes.emplace_back(vec3<f32>(0.0f, 1.0f, 0.0f), -SPHERE_BOX_MIN.y + 1.0f, FIRST_DIFFUSE_MATERIAL);
+    contents.planes.emplace_back(vec3<f32>(0.0f, 0.0f, 1.0f), -minf(SPHERE_BOX_MIN.z, regionMin.z) + 1.0f, FIRST_DIFFUSE_MATERIAL);
+
+    const auto maxRadius = SPHERE_RADIUS_SCALE * std::cbrt(volume / maxu(1U, settings.sphereCount));
+
+    contents.spheres.resize(settings.sphereCount);
+    for (auto& sphere: contents.spheres)
+    {
+        vec3<f32> center;
+
+        if (settings.distribution == SCENE_DISTRIBUTION_CLUSTERED)
+        {
+            // Denser towards the middle of the clump, with offsets made of the sum of uniform ones
+            const auto& clusterCenter = clusterCenters[random.nextUint32() % clusterCenters.size()];
+            vec3<f32> offset;
+            for (auto i = 0; i < 3; ++i)
+            {
+                offset = offset + nextPointInBox(random, vec3<f32>(-1.0f, -1.0f, -1.0f), vec3<f32>(1.0f, 1.0f, 1.0f));
+            }
+            center = clusterCenter + offset * (CLUSTER_RADIUS / 3.0f);
+        }
+        else
+        {
+            center = nextPointInBox(random, regionMin, regionMax);
+        }
+
+        const auto radius = random.nextFloat(0.5f, 1.0f) * (settings.distribution == SCENE_DISTRIBUTION_OVERLAPPING ? OVERLAP_RADIUS : maxRadius);
+
+        const auto materialChoice = random.nextFloat();
+        uint32 matIndex;
+        if (materialChoice < settings.refractiveShare) matIndex = FIRST_REFRACTIVE_MATERIAL + random.nextUint32() % REFRACTIVE_MATERIAL_COUNT;
+        else if (materialChoice < settings.refractiveShare + settings.reflectiveShare) matIndex = FIRST_REFLECTIVE_MATERIAL + random.nextUint32() % REFLECTIVE_MATERIAL_COUNT;
+        else matIndex = FIRST_DIFFUSE_MATERIAL + random.nextUint32() % DIFFUSE_MATERIAL_COUNT;
+
+        sphere = Sphere(radius, center, matIndex);
+    }
+
+    return contents;
+}
@@ -0,0 +1,65 @@
+/**********************************************************************/
+/** scenegenerator.h by Alex Koukoulas (C) 2017 All Rights Reserved  **/
+/** File Description: Interface to the procedural scene generator,   **/
+/** producing reproducible scenes of any size for benchmarking       **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "scene.h"
+
+// Remote Headers
+
+// How the spheres are spread, from the friendly case to the ones acceleration structures struggle with
+enum SceneDistribution
+{
+    SCENE_DISTRIBUTION_UNIFORM,     // Evenly over a box in front of the camera
+    SCENE_DISTRIBUTION_CLUSTERED,   // In dense clumps scattered over that box, with empty space in between
+    SCENE_DISTRIBUTION_OVERLAPPING, // All about the same point, every sphere overlapping every other one
+    SCENE_DISTRIBUTION_THIN,        // Along a long thin rod running away from the camera
+    SCENE_DISTRIBUTION_COUNT
+};
+
+const char* getSceneDistributionName(const SceneDistribution distribution);
+
+struct SceneGeneratorSettings
+{
+    SceneDistribution distribution;
+    uint32 sphereCount;
+    uint32 lightCount;
+
+    // Clumps the spheres are split amongst, for the clustered distribution only
+    uint32 clusterCount;
+
+    // Depths of the reflection and refraction chains
+    uint32 reflectionCount;
+    uint32 refractionCount;
+
+    // Shares of the spheres with a reflective or a refractive material, the rest being diffuse
+    f32 reflectiveShare;
+    f32 refractiveShare;
+
+    uint64 seed;
+
+    SceneGeneratorSettings()
+        : distribution(SCENE_DISTRIBUTION_UNIFORM)
+        , sphereCount(1000)
+        , lightCount(1)
+        , clusterCount(16)
+        , reflectionCount(2)
+        , refractionCount(2)
+        , reflectiveShare(0.2f)
+        , refractiveShare(0.1f)
+        , seed(1)
+    {
+    }
+};
+
+// Generates a scene of spheres spread as the settings' distribution has them, on a floor and in
+// front of a back wall, lit by point lights above them. Sphere sizes shrink as their count grows,
+// so that the spheres fill about the same share of their space at any count. The same settings
+// always generate the same scene, on any platform. Only the spheres themselves take memory in
+// proportion to their count, so scenes of 10^7 spheres are fine.
+SceneContents generateScene(const SceneGeneratorSettings& settings);
@@ -0,0 +1,54 @@
+/**********************************************************************/
+/** seededrandom.h by Alex Koukoulas (C) 2017 All Rights Reserved    **/
+/** File Description: Seeded pseudo random number generator, giving **/
+/** the same sequence on every platform and compiler                 **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+
+// Remote Headers
+
+// The <random> distributions are implementation defined, so anything generated through
+// them (benchmark ray sets, procedural scenes) would differ between compilers. This is
+// splitmix64, with floats made out of the top 24 bits of its output.
+class SeededRandom final
+{
+public:
+    explicit SeededRandom(const uint64 seed)
+        : _state(seed)
+    {
+    }
+
+    inline uint64 nextUint64()
+    {
+        _state += 0x9E3779B97F4A7C15ULL;
+        auto z = _state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    inline uint32 nextUint32() { return static_cast<uint32>(nextUint64() >> 32); }
+
+    // Uniform in [0, 1)
+    inline f32 nextFloat() { return (nextUint32() >> 8) * (1.0f / 16777216.0f); }
+
+    // Uniform in [minValue, maxValue)
+    inline f32 nextFloat(const f32 minValue, const f32 maxValue) { return minValue + (maxValue - minValue) * nextFloat(); }
+
+    // Uniform over the unit sphere
+    inline vec3<f32> nextDirection()
+    {
+        const auto z = nextFloat(-1.0f, 1.0f);
+        const auto phi = 2.0f * PI * nextFloat();
+        const auto r = sqrtf(maxf(0.0f, 1.0f - z * z));
+        return vec3<f32>(r * cosf(phi), r * sinf(phi), z);
+    }
+
+private:
+    uint64 _state;
+};
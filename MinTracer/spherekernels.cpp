@@ -0,0 +1,340 @@
+/**********************************************************************/
+/** spherekernels.cpp by Alex Koukoulas (C) 2017 All Rights Reserved **/
+/** File Description: Scalar, SSE and AVX Ray-sphere kernels, and    **/
+/** their runtime dispatch                                           **/
+/**********************************************************************/
+
+// Local Headers
+#include "spherekernels.h"
+
+// Remote Headers
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SPHERE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX intrinsics anywhere, whereas GCC and Clang only allow them
+// in functions targeting AVX. Either way only the AVX kernels contain AVX code.
+#if defined(__GNUC__)
+#define TARGET_AVX __attribute__((target("avx")))
+#else
+#define TARGET_AVX
+#endif
+
+using intersect_spheres_kernel = bool(*)(const RenderSpheres&, const Ray&, const uint32, const uint32, f32&, uint32&);
+using any_sphere_hit_kernel = bool(*)(const RenderSpheres&, const Ray&, const uint32, const uint32, const f32);
+
+// Applies the closest hit rule to a candidate sphere. Shared by every kernel,
+// so that they all resolve ties identically.
+static inline bool updateClosest(const RenderSpheres& spheres, const uint32 sphere, const f32 t, f32& closestT, uint32& closestSphere)
+{
+    if (t < closestT || (closestSphere != NO_SPHERE && t == closestT && spheres.sceneIndex[sphere] < spheres.sceneIndex[closestSphere]))
+    {
+        closestT = t;
+        closestSphere = sphere;
+        return true;
+    }
+    return false;
+}
+
+static bool intersectSpheresScalar(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, f32& closestT, uint32& closestSphere)
+{
+    const auto a = dot(ray.direction, ray.direction);
+    auto updated = false;
+    for (auto i = first; i < first + count; ++i)
+    {
+        const auto t = sphereDistance(ray, a, vec3<f32>(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]), spheres.radiusSq[i]);
+        if (t > 0.0f)
+        {
+            updated |= updateClosest(spheres, i, t, closestT, closestSphere);
+        }
+    }
+    return updated;
+}
+
+static bool anySphereHitScalar(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, const f32 tMax)
+{
+    const auto a = dot(ray.direction, ray.direction);
+    for (auto i = first; i < first + count; ++i)
+    {
+        const auto t = sphereDistance(ray, a, vec3<f32>(spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i]), spheres.radiusSq[i]);
+        if (t > 0.0f && t < tMax)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if defined(SPHERE_KERNELS_X86)
+
+// The SIMD kernels evaluate sphereDistance for a whole block of spheres, with the
+// operations in the exact same order, so every lane computes a bit identical t.
+// Lanes past the end of the range are masked off.
+
+static inline uint32 getLaneMask(const uint32 remaining, const uint32 width)
+{
+    return remaining >= width ? (1U << width) - 1 : (1U << remaining) - 1;
+}
+
+// Returns the distances of a block of 4 spheres, along with the mask of lanes with a hit (t > 0)
+static inline __m128 sphereDistanceSSE(const RenderSpheres& spheres, const uint32 block,
+                                       const __m128 originX, const __m128 originY, const __m128 originZ,
+                                       const __m128 directionX, const __m128 directionY, const __m128 directionZ,
+                                       const __m128 a, const __m128 fourA, __m128& hitMask)
+{
+    const auto zero = _mm_setzero_ps();
+    const auto toRayX = _mm_sub_ps(originX, _mm_loadu_ps(&spheres.centerX[block]));
+    const auto toRayY = _mm_sub_ps(originY, _mm_loadu_ps(&spheres.centerY[block]));
+    const auto toRayZ = _mm_sub_ps(originZ, _mm_loadu_ps(&spheres.centerZ[block]));
+
+    const auto toRayDotDirection = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, directionX), _mm_mul_ps(toRayY, directionY)), _mm_mul_ps(toRayZ, directionZ));
+    const auto toRayDotToRay = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, toRayX), _mm_mul_ps(toRayY, toRayY)), _mm_mul_ps(toRayZ, toRayZ));
+    const auto b = _mm_mul_ps(_mm_set1_ps(2.0f), toRayDotDirection);
+    const auto c = _mm_sub_ps(toRayDotToRay, _mm_loadu_ps(&spheres.radiusSq[block]));
+    const auto det = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+
+    const auto sqrtDet = _mm_sqrt_ps(det);
+    const auto negB = _mm_xor_ps(b, _mm_set1_ps(-0.0f));
+    const auto half = _mm_set1_ps(0.5f);
+    const auto minT = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(negB, sqrtDet), half), a);
+    const auto maxT = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(negB, sqrtDet), half), a);
+
+    // minT > 0 ? minT : (maxT > 0 ? maxT : 0), without SSE4 blends
+    const auto minTPositive = _mm_cmpgt_ps(minT, zero);
+    const auto maxTPositive = _mm_cmpgt_ps(maxT, zero);
+    const auto t = _mm_or_ps(_mm_and_ps(minTPositive, minT), _mm_andnot_ps(minTPositive, _mm_and_ps(maxTPositive, maxT)));
+
+    hitMask = _mm_and_ps(_mm_cmpgt_ps(det, zero), _mm_cmpgt_ps(t, zero));
+    return t;
+}
+
+static bool intersectSpheresSSE(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, f32& closestT, uint32& closestSphere)
+{
+    const auto scalarA = dot(ray.direction, ray.direction);
+    const auto a = _mm_set1_ps(scalarA);
+    const auto fourA = _mm_set1_ps(4 * scalarA);
+    const auto originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+    const auto directionX = _mm_set1_ps(ray.direction.x), directionY = _mm_set1_ps(ray.direction.y), directionZ = _mm_set1_ps(ray.direction.z);
+
+    auto updated = false;
+    const auto end = first + count;
+    for (auto block = first; block < end; block += 4)
+    {
+        __m128 hitMask;
+        const auto t = sphereDistanceSSE(spheres, block, originX, originY, originZ, directionX, directionY, directionZ, a, fourA, hitMask);
+
+        // Only lanes that can win (or tie) need the scalar closest hit rule applied
+        const auto candidateMask = _mm_and_ps(hitMask, _mm_cmple_ps(t, _mm_set1_ps(closestT)));
+        auto laneMask = static_cast<uint32>(_mm_movemask_ps(candidateMask)) & getLaneMask(end - block, 4);
+        if (laneMask == 0) continue;
+
+        alignas(16) f32 laneT[4];
+        _mm_store_ps(laneT, t);
+        for (auto lane = 0U; laneMask != 0; ++lane, laneMask >>= 1)
+        {
+            if (laneMask & 1)
+            {
+                updated |= updateClosest(spheres, block + lane, laneT[lane], closestT, closestSphere);
+            }
+        }
+    }
+    return updated;
+}
+
+static bool anySphereHitSSE(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, const f32 tMax)
+{
+    const auto scalarA = dot(ray.direction, ray.direction);
+    const auto a = _mm_set1_ps(scalarA);
+    const auto fourA = _mm_set1_ps(4 * scalarA);
+    const auto originX = _mm_set1_ps(ray.origin.x), originY = _mm_set1_ps(ray.origin.y), originZ = _mm_set1_ps(ray.origin.z);
+    const auto directionX = _mm_set1_ps(ray.direction.x), directionY = _mm_set1_ps(ray.direction.y), directionZ = _mm_set1_ps(ray.direction.z);
+    const auto maxT = _mm_set1_ps(tMax);
+
+    const auto end = first + count;
+    for (auto block = first; block < end; block += 4)
+    {
+        __m128 hitMask;
+        const auto t = sphereDistanceSSE(spheres, block, originX, originY, originZ, directionX, directionY, directionZ, a, fourA, hitMask);
+
+        const auto blockerMask = _mm_and_ps(hitMask, _mm_cmplt_ps(t, maxT));
+        if (static_cast<uint32>(_mm_movemask_ps(blockerMask)) & getLaneMask(end - block, 4))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TARGET_AVX static inline __m256 sphereDistanceAVX(const RenderSpheres& spheres, const uint32 block,
+                                                  const __m256 originX, const __m256 originY, const __m256 originZ,
+                                                  const __m256 directionX, const __m256 directionY, const __m256 directionZ,
+                                                  const __m256 a, const __m256 fourA, __m256& hitMask)
+{
+    const auto zero = _mm256_setzero_ps();
+    const auto toRayX = _mm256_sub_ps(originX, _mm256_loadu_ps(&spheres.centerX[block]));
+    const auto toRayY = _mm256_sub_ps(originY, _mm256_loadu_ps(&spheres.centerY[block]));
+    const auto toRayZ = _mm256_sub_ps(originZ, _mm256_loadu_ps(&spheres.centerZ[block]));
+
+    const auto toRayDotDirection = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, directionX), _mm256_mul_ps(toRayY, directionY)), _mm256_mul_ps(toRayZ, directionZ));
+    const auto toRayDotToRay = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, toRayX), _mm256_mul_ps(toRayY, toRayY)), _mm256_mul_ps(toRayZ, toRayZ));
+    const auto b = _mm256_mul_ps(_mm256_set1_ps(2.0f), toRayDotDirection);
+    const auto c = _mm256_sub_ps(toRayDotToRay, _mm256_loadu_ps(&spheres.radiusSq[block]));
+    const auto det = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(fourA, c));
+
+    const auto sqrtDet = _mm256_sqrt_ps(det);
+    const auto negB = _mm256_xor_ps(b, _mm256_set1_ps(-0.0f));
+    const auto half = _mm256_set1_ps(0.5f);
+    const auto minT = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(negB, sqrtDet), half), a);
+    const auto maxT = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(negB, sqrtDet), half), a);
+
+    const auto t = _mm256_blendv_ps(_mm256_and_ps(_mm256_cmp_ps(maxT, zero, _CMP_GT_OQ), maxT), minT, _mm256_cmp_ps(minT, zero, _CMP_GT_OQ));
+
+    hitMask = _mm256_and_ps(_mm256_cmp_ps(det, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+    return t;
+}
+
+TARGET_AVX static bool intersectSpheresAVX(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, f32& closestT, uint32& closestSphere)
+{
+    const auto scalarA = dot(ray.direction, ray.direction);
+    const auto a = _mm256_set1_ps(scalarA);
+    const auto fourA = _mm256_set1_ps(4 * scalarA);
+    const auto originX = _mm256_set1_ps(ray.origin.x), originY = _mm256_set1_ps(ray.origin.y), originZ = _mm256_set1_ps(ray.origin.z);
+    const auto directionX = _mm256_set1_ps(ray.direction.x), directionY = _mm256_set1_ps(ray.direction.y), directionZ = _mm256_set1_ps(ray.direction.z);
+
+    auto updated = false;
+    const auto end = first + count;
+    for (auto block = first; block < end; block += 8)
+    {
+        __m256 hitMask;
+        const auto t = sphereDistanceAVX(spheres, block, originX, originY, originZ, directionX, directionY, directionZ, a, fourA, hitMask);
+
+        const auto candidateMask = _mm256_and_ps(hitMask, _mm256_cmp_ps(t, _mm256_set1_ps(closestT), _CMP_LE_OQ));
+        auto laneMask = static_cast<uint32>(_mm256_movemask_ps(candidateMask)) & getLaneMask(end - block, 8);
+        if (laneMask == 0) continue;
+
+        alignas(32) f32 laneT[8];
+        _mm256_store_ps(laneT, t);
+        for (auto lane = 0U; laneMask != 0; ++lane, laneMask >>= 1)
+        {
+            if (laneMask & 1)
+            {
+                updated |= updateClosest(spheres, block + lane, laneT[lane], closestT, closestSphere);
+            }
+        }
+    }
+
+    // Avoids the penalty of mixing AVX with the legacy SSE code of the callers
+    _mm256_zeroupper();
+    return updated;
+}
+
+TARGET_AVX static bool anySphereHitAVX(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, const f32 tMax)
+{
+    const auto scalarA = dot(ray.direction, ray.direction);
+    const auto a = _mm256_set1_ps(scalarA);
+    const auto fourA = _mm256_set1_ps(4 * scalarA);
+    const auto originX = _mm256_set1_ps(ray.origin.x), originY = _mm256_set1_ps(ray.origin.y), originZ = _mm256_set1_ps(ray.origin.z);
+    const auto directionX = _mm256_set1_ps(ray.direction.x), directionY = _mm256_set1_ps(ray.direction.y), directionZ = _mm256_set1_ps(ray.direction.z);
+    const auto maxT = _mm256_set1_ps(tMax);
+
+    auto blocked = false;
+    const auto end = first + count;
+    for (auto block = first; block < end && !blocked; block += 8)
+    {
+        __m256 hitMask;
+        const auto t = sphereDistanceAVX(spheres, block, originX, originY, originZ, directionX, directionY, directionZ, a, fourA, hitMask);
+
+        const auto blockerMask = _mm256_and_ps(hitMask, _mm256_cmp_ps(t, maxT, _CMP_LT_OQ));
+        blocked = (static_cast<uint32>(_mm256_movemask_ps(blockerMask)) & getLaneMask(end - block, 8)) != 0;
+    }
+
+    _mm256_zeroupper();
+    return blocked;
+}
+
+#endif
+
+static SimdLevel detectSimdLevel()
+{
+#if defined(SPHERE_KERNELS_X86)
+#if defined(_MSC_VER)
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+
+    // AVX also needs the OS to preserve the upper halves of the registers (XCR0 bits 1 and 2)
+    const auto hasSSE2 = (cpuInfo[3] & (1 << 26)) != 0;
+    const auto hasOSXSAVE = (cpuInfo[2] & (1 << 27)) != 0;
+    const auto hasAVX = (cpuInfo[2] & (1 << 28)) != 0;
+    if (hasOSXSAVE && hasAVX && (_xgetbv(0) & 6) == 6) return SIMD_AVX;
+    if (hasSSE2) return SIMD_SSE;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) return SIMD_AVX;
+    if (__builtin_cpu_supports("sse2")) return SIMD_SSE;
+#endif
+#endif
+    return SIMD_SCALAR;
+}
+
+struct SphereKernels
+{
+    intersect_spheres_kernel intersectSpheres;
+    any_sphere_hit_kernel anySphereHit;
+};
+
+static const SphereKernels SPHERE_KERNELS[SIMD_LEVEL_COUNT] =
+{
+    { intersectSpheresScalar, anySphereHitScalar },
+#if defined(SPHERE_KERNELS_X86)
+    { intersectSpheresSSE, anySphereHitSSE },
+    { intersectSpheresAVX, anySphereHitAVX },
+#else
+    { intersectSpheresScalar, anySphereHitScalar },
+    { intersectSpheresScalar, anySphereHitScalar },
+#endif
+};
+
+static const SimdLevel supportedSimdLevel = detectSimdLevel();
+static SimdLevel activeSimdLevel = supportedSimdLevel;
+static const SphereKernels* activeKernels = &SPHERE_KERNELS[supportedSimdLevel];
+
+SimdLevel getSupportedSimdLevel()
+{
+    return supportedSimdLevel;
+}
+
+SimdLevel getSimdLevel()
+{
+    return activeSimdLevel;
+}
+
+SimdLevel setSimdLevel(const SimdLevel simdLevel)
+{
+    activeSimdLevel = simdLevel < supportedSimdLevel ? simdLevel : supportedSimdLevel;
+    activeKernels = &SPHERE_KERNELS[activeSimdLevel];
+    return activeSimdLevel;
+}
+
+const char* getSimdLevelName(const SimdLevel simdLevel)
+{
+    switch (simdLevel)
+    {
+        case SIMD_SSE: return "SSE";
+        case SIMD_AVX: return "AVX";
+        default: return "Scalar";
+    }
+}
+
+bool intersectSpheres(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, f32& closestT, uint32& closestSphere)
+{
+    return activeKernels->intersectSpheres(spheres, ray, first, count, closestT, closestSphere);
+}
+
+bool anySphereHit(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, const f32 tMax)
+{
+    return activeKernels->anySphereHit(spheres, ray, first, count, tMax);
+}
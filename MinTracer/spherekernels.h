@@ -0,0 +1,67 @@
+/**********************************************************************/
+/** spherekernels.h by Alex Koukoulas (C) 2017 All Rights Reserved   **/
+/** File Description: Interface to the (SIMD) Ray-sphere kernels     **/
+/** operating on the compiled, structure of arrays spheres           **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "renderscene.h"
+
+// Widest SIMD kernel, in spheres. The compiled sphere arrays are padded by
+// this many elements, so that blocks can always be loaded in full.
+const uint32 SPHERE_KERNEL_MAX_WIDTH = 8;
+
+// Marks the absence of a closest sphere
+const uint32 NO_SPHERE = 0xFFFFFFFF;
+
+enum SimdLevel
+{
+    SIMD_SCALAR, SIMD_SSE, SIMD_AVX, SIMD_LEVEL_COUNT
+};
+
+// Widest instruction set supported by both the CPU and the OS, detected once
+SimdLevel getSupportedSimdLevel();
+
+// Instruction set the kernels dispatch to, which is the supported one unless overridden
+SimdLevel getSimdLevel();
+
+// Overrides the instruction set the kernels dispatch to (e.g. to compare against the
+// scalar kernels), clamped to the supported one. Must not be called while rendering.
+SimdLevel setSimdLevel(const SimdLevel simdLevel);
+
+const char* getSimdLevelName(const SimdLevel simdLevel);
+
+// Distance along the ray to the nearest intersection with the sphere in front of its origin,
+// 0 on a miss. a is the squared length of the ray direction. Every kernel computes exactly this.
+inline f32 sphereDistance(const Ray& ray, const f32 a, const vec3<f32>& center, const f32 radiusSq)
+{
+    const auto toRay = ray.origin - center;
+
+    const auto b = 2.0f * dot(toRay, ray.direction);
+    const auto c = dot(toRay, toRay) - radiusSq;
+    const auto det = b * b - 4 * a * c;
+
+    if (det > 0.0f)
+    {
+        const auto minT = (-b - sqrtf(det)) / 2 * a;
+        const auto maxT = (-b + sqrtf(det)) / 2 * a;
+        return minT > 0.0f ? minT : (maxT > 0.0f ? maxT : 0.0f);
+    }
+
+    return 0.0f;
+}
+
+// Both queries test the BVH ordered spheres [first, first + count), either a BVH leaf or all of them.
+//
+// Updates closestT and closestSphere if a sphere is hit nearer than closestT, or exactly at
+// closestT with a lower scene index than closestSphere (NO_SPHERE while nothing has been hit).
+// Returns true if they were updated.
+bool intersectSpheres(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, f32& closestT, uint32& closestSphere);
+
+// Checks whether any of the spheres is hit before tMax
+bool anySphereHit(const RenderSpheres& spheres, const Ray& ray, const uint32 first, const uint32 count, const f32 tMax);
@@ -45,4 +45,31 @@ std::vector<std::string> strutils::split(const std::string& s, char delim)
     std::vector<std::string> elems;
     split(s, delim, elems);
     return elems;
+}
+
+std::string strutils::toJsonString(const std::string& s)
+{
+    static const char* HEX_DIGITS = "0123456789abcdef";
+
+    std::string result = "\"";
+    for (const auto c: s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            result += "\\u00";
+            result += HEX_DIGITS[(c >> 4) & 0xF];
+            result += HEX_DIGITS[c & 0xF];
+        }
+        else
+        {
+            result += c;
+        }
+    }
+    result += '"';
+    return result;
 }
\ No newline at end of file
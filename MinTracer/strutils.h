@@ -16,4 +16,7 @@ namespace strutils
     bool startsWith(const std::string& s, const std::string& pattern);
     void split(const std::string& s, char delim, std::vector<std::string>& elems);
     std::vector<std::string> split(const std::string& s, char delim);
+
+    // Quoted JSON string literal of s, with quotes, backslashes and control characters escaped
+    std::string toJsonString(const std::string& s);
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+/**********************************************************************/
+/** threadpool.cpp by Alex Koukoulas (C) 2017 All Rights Reserved    **/
+/** File Description: Implementation of the render thread pool       **/
+/**********************************************************************/
+
+// Local Headers
+#include "threadpool.h"
+#include "instrumentation.h"
+
+// Remote Headers
+#include <chrono>
+
+ThreadPool::ThreadPool(const uint32 threadCount)
+    : _jobGeneration(0)
+    , _activeWorkers(0)
+    , _shuttingDown(false)
+{
+    for (auto i = 0U; i < threadCount; ++i)
+    {
+        _threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobFinished.wait(lock, [this]() { return _activeWorkers == 0; });
+        _shuttingDown = true;
+    }
+    _jobAvailable.notify_all();
+
+    for (auto& thread: _threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::dispatch(job_type job)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobFinished.wait(lock, [this]() { return _activeWorkers == 0; });
+
+        _job = std::move(job);
+        _activeWorkers = getThreadCount();
+        _jobGeneration++;
+    }
+    _jobAvailable.notify_all();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _jobFinished.wait(lock, [this]() { return _activeWorkers == 0; });
+}
+
+bool ThreadPool::waitFor(const uint32 timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _jobFinished.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return _activeWorkers == 0; });
+}
+
+void ThreadPool::workerLoop(const uint32 workerIndex)
+{
+    INSTRUMENT_THREAD_NAME("Worker " + std::to_string(workerIndex));
+    auto lastJobGeneration = 0ULL;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _jobAvailable.wait(lock, [this, lastJobGeneration]() { return _shuttingDown || _jobGeneration != lastJobGeneration; });
+        if (_shuttingDown) return;
+
+        lastJobGeneration = _jobGeneration;
+
+        // The job can't be replaced before every worker is done with it,
+        // so it is safe to run it outside of the lock
+        lock.unlock();
+        _job(workerIndex);
+        lock.lock();
+
+        if (--_activeWorkers == 0)
+        {
+            _jobFinished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/**********************************************************************/
+/** threadpool.h by Alex Koukoulas (C) 2017 All Rights Reserved      **/
+/** File Description: Interface to the long-lived pool of render     **/
+/** worker threads, shared across all render passes                  **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// The pool is fed one job at a time, which runs on every one of its workers
+// (fork-join style). Workers sleep on a condition variable inbetween jobs,
+// so no threads are created or destroyed across render passes.
+class ThreadPool final
+{
+public:
+    using job_type = std::function<void(const uint32 workerIndex)>;
+
+    explicit ThreadPool(const uint32 threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    inline uint32 getThreadCount() const { return static_cast<uint32>(_threads.size()); }
+
+    // Starts the job on every worker and returns immediately. If the previous
+    // job is still running, blocks until it has finished first.
+    void dispatch(job_type job);
+
+    // Blocks until the last dispatched job has finished on every worker
+    void wait();
+
+    // Same as wait, but gives up after timeoutMs.
+    // Returns true if the job has finished on every worker.
+    bool waitFor(const uint32 timeoutMs);
+
+private:
+    void workerLoop(const uint32 workerIndex);
+
+private:
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _jobAvailable;
+    std::condition_variable _jobFinished;
+    job_type _job;
+    uint64 _jobGeneration;
+    uint32 _activeWorkers;
+    bool _shuttingDown;
+};
@@ -0,0 +1,182 @@
+/**********************************************************************/
+/** tilescheduler.cpp by Alex Koukoulas (C) 2017 All Rights Reserved **/
+/** File Description: Implementation of the work stealing scheduler  **/
+/**********************************************************************/
+
+// Local Headers
+#include "tilescheduler.h"
+
+// Remote Headers
+#include <algorithm>
+#include <utility>
+
+static inline uint64 packRange(const uint32 begin, const uint32 end) { return (static_cast<uint64>(end) << 32) | begin; }
+static inline uint32 rangeBegin(const uint64 range) { return static_cast<uint32>(range & 0xFFFFFFFFULL); }
+static inline uint32 rangeEnd(const uint64 range) { return static_cast<uint32>(range >> 32); }
+
+// Interleaves the bits of x and y, i.e. the position along the Z-order curve
+static uint32 mortonIndex(const uint32 x, const uint32 y)
+{
+    auto index = 0U;
+    for (auto bit = 0U; bit < 16U; ++bit)
+    {
+        index |= ((x >> bit) & 1U) << (2 * bit);
+        index |= ((y >> bit) & 1U) << (2 * bit + 1);
+    }
+    return index;
+}
+
+// Position along the Hilbert curve filling a size x size (power of two) square
+static uint32 hilbertIndex(const uint32 size, uint32 x, uint32 y)
+{
+    auto index = 0U;
+    for (auto s = size / 2; s > 0; s /= 2)
+    {
+        const auto rx = (x & s) > 0 ? 1U : 0U;
+        const auto ry = (y & s) > 0 ? 1U : 0U;
+        index += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant, so that the curve continues from where it left off
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+const char* getTileOrderName(const TileOrder tileOrder)
+{
+    switch (tileOrder)
+    {
+        case TILE_ORDER_SCANLINE: return "scanline";
+        case TILE_ORDER_MORTON: return "morton";
+        case TILE_ORDER_HILBERT: return "hilbert";
+        default: return "unknown";
+    }
+}
+
+std::vector<uint32> getTraversalOrder(const uint32 width, const uint32 height, const TileOrder tileOrder)
+{
+    std::vector<uint32> order(width * height);
+    for (auto i = 0U; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+
+    if (tileOrder == TILE_ORDER_SCANLINE || order.empty()) return order;
+
+    auto size = 1U;
+    while (size < width || size < height) size *= 2;
+
+    std::vector<std::pair<uint32, uint32>> keyedCells(order.size());
+    for (auto i = 0U; i < order.size(); ++i)
+    {
+        const auto x = i % width;
+        const auto y = i / width;
+        keyedCells[i] = std::make_pair(tileOrder == TILE_ORDER_MORTON ? mortonIndex(x, y) : hilbertIndex(size, x, y), i);
+    }
+
+    // Curve positions are unique, so the sort is deterministic
+    std::sort(keyedCells.begin(), keyedCells.end());
+    for (auto i = 0U; i < order.size(); ++i)
+    {
+        order[i] = keyedCells[i].second;
+    }
+    return order;
+}
+
+TileScheduler::TileScheduler(const sint32 width, const sint32 height, const uint32 tileSize, const uint32 workerCount, const TileOrder tileOrder)
+    : _width(width)
+    , _height(height)
+    , _tileSize(tileSize)
+    , _tilesPerRow((width + tileSize - 1) / tileSize)
+    , _tileCount(_tilesPerRow * ((height + tileSize - 1) / tileSize))
+    , _workerCount(workerCount)
+    , _tileOrder(getTraversalOrder(_tilesPerRow, (height + tileSize - 1) / tileSize, tileOrder))
+    , _workers(new WorkerRange[workerCount])
+{
+    // Initial split, with any outstanding tiles spread across the workers
+    for (auto i = 0U; i < _workerCount; ++i)
+    {
+        const auto begin = static_cast<uint32>((static_cast<uint64>(_tileCount) * i) / _workerCount);
+        const auto end = static_cast<uint32>((static_cast<uint64>(_tileCount) * (i + 1)) / _workerCount);
+        _workers[i].range = packRange(begin, end);
+        _workers[i].stealCount = 0;
+    }
+}
+
+bool TileScheduler::nextTile(const uint32 workerIndex, Tile& tile)
+{
+    uint32 tileIndex;
+    if (popTile(workerIndex, tileIndex) || stealTiles(workerIndex, tileIndex))
+    {
+        tile = getTile(tileIndex);
+        return true;
+    }
+
+    return false;
+}
+
+Tile TileScheduler::getTile(const uint32 orderIndex) const
+{
+    const auto tileIndex = _tileOrder[orderIndex];
+
+    Tile tile;
+    tile.x0 = static_cast<sint32>((tileIndex % _tilesPerRow) * _tileSize);
+    tile.y0 = static_cast<sint32>((tileIndex / _tilesPerRow) * _tileSize);
+    tile.x1 = tile.x0 + static_cast<sint32>(_tileSize) < _width ? tile.x0 + static_cast<sint32>(_tileSize) : _width;
+    tile.y1 = tile.y0 + static_cast<sint32>(_tileSize) < _height ? tile.y0 + static_cast<sint32>(_tileSize) : _height;
+    return tile;
+}
+
+bool TileScheduler::popTile(const uint32 workerIndex, uint32& tileIndex)
+{
+    auto& ownRange = _workers[workerIndex].range;
+    auto range = ownRange.load();
+
+    while (rangeBegin(range) < rangeEnd(range))
+    {
+        if (ownRange.compare_exchange_weak(range, packRange(rangeBegin(range) + 1, rangeEnd(range))))
+        {
+            tileIndex = rangeBegin(range);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool TileScheduler::stealTiles(const uint32 workerIndex, uint32& tileIndex)
+{
+    // Sweep over every other worker, starting from the next one
+    for (auto offset = 1U; offset < _workerCount; ++offset)
+    {
+        auto& victimRange = _workers[(workerIndex + offset) % _workerCount].range;
+        auto range = victimRange.load();
+
+        while (rangeBegin(range) < rangeEnd(range))
+        {
+            // Take the back half, leaving the victim the tiles it is about to work on
+            const auto remaining = rangeEnd(range) - rangeBegin(range);
+            const auto stolenBegin = rangeEnd(range) - (remaining + 1) / 2;
+
+            if (victimRange.compare_exchange_weak(range, packRange(rangeBegin(range), stolenBegin)))
+            {
+                // Our own range is empty at this point, and thieves never touch
+                // an empty range, so it can be safely republished with a store
+                tileIndex = stolenBegin;
+                _workers[workerIndex].range = packRange(stolenBegin + 1, rangeEnd(range));
+                _workers[workerIndex].stealCount++;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,81 @@
+/**********************************************************************/
+/** tilescheduler.h by Alex Koukoulas (C) 2017 All Rights Reserved   **/
+/** File Description: Interface to the work stealing tile scheduler  **/
+/** distributing image tiles amongst the Ray tracing workers         **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+
+// Remote Headers
+#include <atomic>
+#include <vector>
+#include <memory>
+
+const uint32 DEFAULT_TILE_SIZE = 16;
+
+// Order in which the tiles of an image, and the pixels of a tile, are traversed.
+// The space filling curves keep consecutive tiles (and hence the ranges handed to
+// each worker) compact, so the BVH nodes and spheres their rays touch are still
+// cached when the neighbouring tiles come up.
+enum TileOrder
+{
+    TILE_ORDER_SCANLINE, TILE_ORDER_MORTON, TILE_ORDER_HILBERT, TILE_ORDER_COUNT
+};
+
+const char* getTileOrderName(const TileOrder tileOrder);
+
+// Cells of a width x height grid, as y * width + x indices, in the given order.
+// The curves are laid over the smallest power of two square covering the grid,
+// skipping the cells that fall outside of it.
+std::vector<uint32> getTraversalOrder(const uint32 width, const uint32 height, const TileOrder tileOrder);
+
+// Half open pixel rectangle [x0, x1) x [y0, y1)
+struct Tile
+{
+    sint32 x0, y0;
+    sint32 x1, y1;
+};
+
+// Tiles are handed out in the given order. Each worker starts off owning a contiguous
+// range of tiles, which it consumes from the front. Once its range runs dry, it steals
+// the back half of another worker's remaining range. Ranges are packed [begin, end)
+// pairs in a single atomic, so that both popping and stealing are a single compare and swap.
+class TileScheduler final
+{
+public:
+    TileScheduler(const sint32 width, const sint32 height, const uint32 tileSize, const uint32 workerCount, const TileOrder tileOrder = TILE_ORDER_SCANLINE);
+
+    // Retrieves the next tile for the given worker.
+    // Returns false when there is no work left anywhere.
+    bool nextTile(const uint32 workerIndex, Tile& tile);
+
+    inline uint32 getTileCount() const { return _tileCount; }
+    inline uint32 getStealCount(const uint32 workerIndex) const { return _workers[workerIndex].stealCount; }
+
+private:
+    // Padded to a cache line, so that workers don't falsely share their ranges
+    struct WorkerRange
+    {
+        std::atomic<uint64> range;
+        uint32 stealCount;
+        uint8 padding[64 - sizeof(std::atomic<uint64>) - sizeof(uint32)];
+    };
+
+    // Tile at the given position of the traversal order
+    Tile getTile(const uint32 orderIndex) const;
+    bool popTile(const uint32 workerIndex, uint32& tileIndex);
+    bool stealTiles(const uint32 workerIndex, uint32& tileIndex);
+
+private:
+    const sint32 _width;
+    const sint32 _height;
+    const uint32 _tileSize;
+    const uint32 _tilesPerRow;
+    const uint32 _tileCount;
+    const uint32 _workerCount;
+    const std::vector<uint32> _tileOrder;
+    std::unique_ptr<WorkerRange[]> _workers;
+};
@@ -8,12 +8,12 @@
 using uint8 = unsigned char;   
 using uint16 = unsigned short; 
 using uint32 = unsigned int; 
-using uint64 = unsigned long; 
+using uint64 = unsigned long long; 
 
 using sint8 = signed char;
 using sint16 = signed short;
 using sint32 = signed int;
-using sint64 = signed long;
+using sint64 = signed long long;
 
 using f32 = float;
 using f64 = double;
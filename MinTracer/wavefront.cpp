@@ -0,0 +1,194 @@
+/**********************************************************************/
+/** wavefront.cpp by Alex Koukoulas (C) 2017 All Rights Reserved     **/
+/** File Description: Implementation of the wavefront Ray tracer     **/
+/**********************************************************************/
+
+// Local Headers
+#include "wavefront.h"
+#include "instrumentation.h"
+
+// Remote Headers
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+// Octant of the direction, i.e. the signs of its components
+static inline uint32 directionOctant(const vec3<f32>& direction)
+{
+    return (direction.x < 0.0f ? 1U : 0U) | (direction.y < 0.0f ? 2U : 0U) | (direction.z < 0.0f ? 4U : 0U);
+}
+
+// Stable counting sort of the queued paths by the octant their rays head to, so that rays
+// batched together mostly visit the same BVH nodes in the same order
+static void sortPaths(WavefrontQueues& queues)
+{
+    uint32 octantStart[9] = {};
+    for (const auto path: queues.paths)
+    {
+        octantStart[directionOctant(queues.rays[path].direction) + 1]++;
+    }
+
+    for (auto octant = 1U; octant < 9U; ++octant)
+    {
+        octantStart[octant] += octantStart[octant - 1];
+    }
+
+    queues.sortedPaths.resize(queues.paths.size());
+    for (const auto path: queues.paths)
+    {
+        queues.sortedPaths[octantStart[directionOctant(queues.rays[path].direction)]++] = path;
+    }
+
+    swap(queues.paths, queues.sortedPaths);
+}
+
+// Closest hit of the ray of every queued path
+static void intersectStage(const RenderScene& scene, WavefrontQueues& queues, const bool usePackets)
+{
+    const auto queueLength = static_cast<uint32>(queues.paths.size());
+    queues.queuedRays.resize(queueLength);
+    queues.queuedHitInfos.resize(queueLength);
+
+    for (auto i = 0U; i < queueLength; ++i)
+    {
+        queues.queuedRays[i] = queues.rays[queues.paths[i]];
+    }
+
+    intersectSceneBatch(scene, queues.queuedRays.data(), queueLength, queues.queuedHitInfos.data(), usePackets);
+
+    for (auto i = 0U; i < queueLength; ++i)
+    {
+        queues.hitInfos[queues.paths[i]] = queues.queuedHitInfos[i];
+    }
+}
+
+// Directly lit color of the hit of every queued path, as traceForEachLight computes it.
+// The shadow rays of all hits are queued and tested one light at a time, which keeps
+// the lights' contributions accumulating in the same order.
+static void shadeStage(const RenderScene& scene, WavefrontQueues& queues, const bool usePackets)
+{
+    auto& hitPaths = queues.sortedPaths;
+    hitPaths.clear();
+
+    for (const auto path: queues.paths)
+    {
+        const auto& hitInfo = queues.hitInfos[path];
+        queues.directColors[path] = hitInfo.hit ? scene.getMaterial(hitInfo.surfaceMatIndex).ambient : vec3<f32>();
+        if (hitInfo.hit) hitPaths.push_back(path);
+    }
+
+    const auto hitCount = static_cast<uint32>(hitPaths.size());
+    queues.queuedRays.resize(hitCount);
+    queues.queuedMaxT.resize(hitCount);
+    queues.queuedBlocked.resize(hitCount);
+
+    const auto* lights = scene.getLights();
+    const auto lightCount = scene.getLightCount();
+    for (auto light = 0U; light < lightCount && hitCount > 0; ++light)
+    {
+        for (auto i = 0U; i < hitCount; ++i)
+        {
+            queues.queuedRays[i] = getShadowRay(lights[light], queues.hitInfos[hitPaths[i]], queues.queuedMaxT[i]);
+        }
+
+        {
+            INSTRUMENT_TRACED_STAGE(STAGE_SHADOW_RAYS);
+            occludedBatch(scene, queues.queuedRays.data(), queues.queuedMaxT.data(), hitCount, queues.queuedBlocked.data(), usePackets);
+        }
+
+        for (auto i = 0U; i < hitCount; ++i)
+        {
+            const auto path = hitPaths[i];
+            queues.directColors[path] += queues.queuedBlocked[i] ? vec3<f32>() :
+                shadeUnoccluded(scene, queues.rays[path], lights[light], queues.hitInfos[path], queues.queuedRays[i]);
+        }
+    }
+}
+
+// Follows a reflection or refraction chain of every path from its primary hit, one
+// bounce at a time. bounce replaces a path's ray with the next one of its chain.
+template<typename Bounce>
+static void traceBounces(const RenderScene& scene, const Ray* primaryRays, const uint32 rayCount, const uint32 bounceCount, vec3<f32>* colors, WavefrontQueues& queues, const bool usePackets, Bounce bounce)
+{
+    queues.paths.resize(rayCount);
+    for (auto path = 0U; path < rayCount; ++path)
+    {
+        queues.paths[path] = path;
+        queues.rays[path] = primaryRays[path];
+        queues.hitInfos[path] = queues.primaryHitInfos[path];
+        queues.weights[path] = 1.0f;
+    }
+
+    for (auto i = 0U; i < bounceCount; ++i)
+    {
+        // Chains end at the first miss
+        queues.paths.erase(remove_if(queues.paths.begin(), queues.paths.end(), [&queues](const uint32 path)
+        {
+            return !queues.hitInfos[path].hit;
+        }), queues.paths.end());
+
+        if (queues.paths.empty()) break;
+
+        for (const auto path: queues.paths)
+        {
+            queues.rays[path] = bounce(path);
+        }
+
+        sortPaths(queues);
+        intersectStage(scene, queues, usePackets);
+        shadeStage(scene, queues, usePackets);
+
+        for (const auto path: queues.paths)
+        {
+            colors[path] += queues.contributions[path] * queues.directColors[path];
+        }
+    }
+}
+
+void traceWavefront(const RenderScene& scene, const Ray* rays, const uint32 rayCount, vec3<f32>* colors, WavefrontQueues& queues, const bool usePackets)
+{
+    queues.rays.resize(rayCount);
+    queues.hitInfos.resize(rayCount);
+    queues.primaryHitInfos.resize(rayCount);
+    queues.weights.resize(rayCount);
+    queues.contributions.resize(rayCount);
+    queues.directColors.resize(rayCount);
+
+    // Primary rays, which arrive in coherent order already
+    queues.paths.resize(rayCount);
+    for (auto path = 0U; path < rayCount; ++path)
+    {
+        queues.paths[path] = path;
+        queues.rays[path] = rays[path];
+    }
+
+    {
+        INSTRUMENT_TRACED_STAGE(STAGE_PRIMARY_INTERSECTION);
+        intersectStage(scene, queues, usePackets);
+    }
+    shadeStage(scene, queues, usePackets);
+
+    for (auto path = 0U; path < rayCount; ++path)
+    {
+        queues.primaryHitInfos[path] = queues.hitInfos[path];
+        colors[path] = queues.directColors[path];
+    }
+
+    // Every reflection bounce is added before any refraction one, exactly as trace does
+    {
+        INSTRUMENT_TRACED_STAGE(STAGE_REFLECTION);
+        traceBounces(scene, rays, rayCount, scene.getReflectionCount(), colors, queues, usePackets, [&scene, &queues, rays](const uint32 path)
+        {
+            return reflectRay(scene, rays[path], queues.rays[path], queues.hitInfos[path], queues.weights[path], queues.contributions[path]);
+        });
+    }
+
+    {
+        INSTRUMENT_TRACED_STAGE(STAGE_REFRACTION);
+        traceBounces(scene, rays, rayCount, scene.getRefractionCount(), colors, queues, usePackets, [&scene, &queues](const uint32 path)
+        {
+            return refractRay(scene, queues.rays[path], queues.hitInfos[path], queues.weights[path], queues.contributions[path]);
+        });
+    }
+}
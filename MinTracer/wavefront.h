@@ -0,0 +1,53 @@
+/**********************************************************************/
+/** wavefront.h by Alex Koukoulas (C) 2017 All Rights Reserved       **/
+/** File Description: Interface to the wavefront Ray tracer, which   **/
+/** traces whole tiles stage by stage through batched ray queues     **/
+/**********************************************************************/
+
+#pragma once
+
+// Local Headers
+#include "typedefs.h"
+#include "math.h"
+#include "scene.h"
+#include "renderscene.h"
+#include "raytracer.h"
+
+// Remote Headers
+#include <vector>
+
+// Per path state and stage queues of the wavefront tracer. Owned by a single
+// worker and reused from tile to tile, so they are only ever grown.
+struct WavefrontQueues
+{
+    // Path (i.e. pixel) state, indexed by path
+    std::vector<Ray> rays;
+    std::vector<HitInfo> hitInfos;
+    std::vector<HitInfo> primaryHitInfos;
+    std::vector<f32> weights;
+    std::vector<f32> contributions;
+    std::vector<vec3<f32>> directColors;
+
+    // The paths taking part in the current stage, sorted for coherence
+    std::vector<uint32> paths;
+    std::vector<uint32> sortedPaths;
+
+    // Rays of the current stage, gathered contiguously in queue order
+    std::vector<Ray> queuedRays;
+    std::vector<HitInfo> queuedHitInfos;
+    std::vector<f32> queuedMaxT;
+    std::vector<uint8> queuedBlocked;
+};
+
+// Traces the given primary rays (e.g. every pixel of a tile) as a wavefront, with identical
+// results and ray counts to calling trace on each of them. Rather than following every ray's
+// path to the end, each stage is run for all paths at once:
+//
+//  1. The primary rays are intersected in bulk
+//  2. A shadow ray per light is queued for every hit, and the queue is tested in bulk
+//  3. Every reflection bounce queues the next reflection ray of each path still going, which
+//     then go through the stages above. Refraction bounces follow in the same way.
+//
+// Queued rays are sorted by direction, and traced in packets of consecutive rays when usePackets
+// is set. Colors are accumulated per path in the same order as trace does, down to the last bit.
+void traceWavefront(const RenderScene& scene, const Ray* rays, const uint32 rayCount, vec3<f32>* colors, WavefrontQueues& queues, const bool usePackets);
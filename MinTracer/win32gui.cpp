@@ -79,7 +79,7 @@ void CreateMenus(HWND hwnd)
     const auto lightCount = Scene::get().getLightCount();
     for (auto i = 0U; i < lightCount; ++i)
     {
-        std::wstring lightEntryName = (Scene::get().getLight(i).getLightType() == Light::DIR_LIGHT ? L"&Light " : L"&PointLight ") + std::to_wstring(i);
+        std::wstring lightEntryName = (Scene::get().getLight(i)->getLightType() == Light::DIR_LIGHT ? L"&Light " : L"&PointLight ") + std::to_wstring(i);
         AppendMenuW(hLightsSubMenu, MF_STRING, win32::LIGHT_GUID_OFFSET + i, lightEntryName.c_str());
     }
 
@@ -107,6 +107,7 @@ void CreateMenus(HWND hwnd)
     // Render Menu
     AppendMenuW(hRenderMenu, MF_STRING, win32::GUID_REFL_REFR_COUNT_RENDER, L"&Reflection && Refraction");
     AppendMenuW(hRenderMenu, MF_STRING, win32::GUID_RESTART_RENDER, L"&Restart Rendering");    
+    AppendMenuW(hRenderMenu, MF_STRING | MF_UNCHECKED, win32::GUID_COST_HEATMAP_RENDER, L"Cost &Heatmap");
     AppendMenuW(hMenubar, MF_POPUP, (UINT_PTR)hRenderMenu, L"&Render");
 
     // Master Menu Bar
@@ -221,34 +222,43 @@ LRESULT CALLBACK PlanesEditWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
             {
                 if (lParam == (LPARAM)planeNormalXTrackbar)
                 {
-                    Scene::get().getPlane(currentPlaneIndex).normal.x = (hi - 50) / 50.0f;
-                    Scene::get().getPlane(currentPlaneIndex).normal = normalize(Scene::get().getPlane(currentPlaneIndex).normal);
+                    Scene::get().editPlane(currentPlaneIndex, [hi](Plane& plane)
+                    {
+                        plane.normal.x = (hi - 50) / 50.0f;
+                        plane.normal = normalize(plane.normal);
+                    });
                 }
                 else if (lParam == (LPARAM)planeNormalYTrackbar)
                 {
-                    Scene::get().getPlane(currentPlaneIndex).normal.y = (hi - 50) / 50.0f;
-                    Scene::get().getPlane(currentPlaneIndex).normal = normalize(Scene::get().getPlane(currentPlaneIndex).normal);
+                    Scene::get().editPlane(currentPlaneIndex, [hi](Plane& plane)
+                    {
+                        plane.normal.y = (hi - 50) / 50.0f;
+                        plane.normal = normalize(plane.normal);
+                    });
                 }
                 else if (lParam == (LPARAM)planeNormalZTrackbar)
                 {
-                    Scene::get().getPlane(currentPlaneIndex).normal.z = (hi - 50) / 50.0f;
-                    Scene::get().getPlane(currentPlaneIndex).normal = normalize(Scene::get().getPlane(currentPlaneIndex).normal);
+                    Scene::get().editPlane(currentPlaneIndex, [hi](Plane& plane)
+                    {
+                        plane.normal.z = (hi - 50) / 50.0f;
+                        plane.normal = normalize(plane.normal);
+                    });
                 }
                 else if (lParam == (LPARAM)planeDistanceTrackbar)
                 {
-                    Scene::get().getPlane(currentPlaneIndex).d = (hi - 50)/ 2.0f;
+                    Scene::get().editPlane(currentPlaneIndex, [hi](Plane& plane) { plane.d = (hi - 50)/ 2.0f; });
                 }
                 else if (lParam == (LPARAM)planeGlossinessTrackbar)
                 {
-                    Scene::get().getMaterial(Scene::get().getPlane(currentPlaneIndex).matIndex).glossiness = hi * 2.56f;
+                    Scene::get().editMaterial(Scene::get().getPlane(currentPlaneIndex).matIndex, [hi](Material& material) { material.glossiness = hi * 2.56f; });
                 }
                 else if (lParam == (LPARAM)planeReflectivityTrackbar)
                 {
-                    Scene::get().getMaterial(Scene::get().getPlane(currentPlaneIndex).matIndex).reflectivity = hi / 100.0f;
+                    Scene::get().editMaterial(Scene::get().getPlane(currentPlaneIndex).matIndex, [hi](Material& material) { material.reflectivity = hi / 100.0f; });
                 }
                 else if (lParam == (LPARAM)planeRefractivityTrackbar)
                 {
-                    Scene::get().getMaterial(Scene::get().getPlane(currentPlaneIndex).matIndex).refractivity = hi / 33.0f;
+                    Scene::get().editMaterial(Scene::get().getPlane(currentPlaneIndex).matIndex, [hi](Material& material) { material.refractivity = hi / 33.0f; });
                 }
 
                 PostMessage(GetParent(hwnd), WM_HSCROLL, wParam, lParam);
@@ -367,31 +377,31 @@ LRESULT CALLBACK SpheresEditWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM l
             {                
                 if (lParam == (LPARAM)sphereOffsetXTrackbar)
                 {
-                    Scene::get().getSphere(currentSphereIndex).center.x = (hi - 50) / 5.0f;
+                    Scene::get().editSphere(currentSphereIndex, [hi](Sphere& sphere) { sphere.center.x = (hi - 50) / 5.0f; });
                 }
                 else if (lParam == (LPARAM)sphereOffsetYTrackbar)
                 {
-                    Scene::get().getSphere(currentSphereIndex).center.y = (hi - 50) / 5.0f;
+                    Scene::get().editSphere(currentSphereIndex, [hi](Sphere& sphere) { sphere.center.y = (hi - 50) / 5.0f; });
                 }
                 else if (lParam == (LPARAM)sphereOffsetZTrackbar)
                 {
-                    Scene::get().getSphere(currentSphereIndex).center.z = (hi - 50) / 5.0f;
+                    Scene::get().editSphere(currentSphereIndex, [hi](Sphere& sphere) { sphere.center.z = (hi - 50) / 5.0f; });
                 }
                 else if (lParam == (LPARAM)sphereRadiusTrackbar)
                 {
-                    Scene::get().getSphere(currentSphereIndex).radius = hi / 10.0f;
+                    Scene::get().editSphere(currentSphereIndex, [hi](Sphere& sphere) { sphere.radius = hi / 10.0f; });
                 }
                 else if (lParam == (LPARAM)sphereGlossinessTrackbar)
                 {
-                    Scene::get().getMaterial(Scene::get().getSphere(currentSphereIndex).matIndex).glossiness = hi * 2.56f;
+                    Scene::get().editMaterial(Scene::get().getSphere(currentSphereIndex).matIndex, [hi](Material& material) { material.glossiness = hi * 2.56f; });
                 }                
                 else if (lParam == (LPARAM)sphereReflectivityTrackbar)
                 {
-                    Scene::get().getMaterial(Scene::get().getSphere(currentSphereIndex).matIndex).reflectivity = hi / 100.0f;
+                    Scene::get().editMaterial(Scene::get().getSphere(currentSphereIndex).matIndex, [hi](Material& material) { material.reflectivity = hi / 100.0f; });
                 }
                 else if (lParam == (LPARAM)sphereRefractivityTrackbar)
                 {
-                    Scene::get().getMaterial(Scene::get().getSphere(currentSphereIndex).matIndex).refractivity = hi / 33.0f;
+                    Scene::get().editMaterial(Scene::get().getSphere(currentSphereIndex).matIndex, [hi](Material& material) { material.refractivity = hi / 33.0f; });
                 }
 
                 PostMessage(GetParent(hwnd), WM_HSCROLL, wParam, lParam);
@@ -452,17 +462,17 @@ LRESULT CALLBACK LightEditWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
             CreateWindow("BUTTON", "OK", WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_DEFPUSHBUTTON, 116, 480, 100, 30, hwnd, (HMENU)BUTTON_ID, GetModuleHandle(NULL), NULL);
 
             // Light Position Trackbars
-            lightPositionXTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Light x", 70, 50, static_cast<uint32>(Scene::get().getLight(currentLightIndex).position.x * 2.5f + 50));
-            lightPositionYTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Light y", 70, 100, static_cast<uint32>(Scene::get().getLight(currentLightIndex).position.y * 2.5f + 50));
-            lightPositionZTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Light z", 70, 150, static_cast<uint32>(Scene::get().getLight(currentLightIndex).position.z * 2.5f + 50));
+            lightPositionXTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Light x", 70, 50, static_cast<uint32>(Scene::get().getLight(currentLightIndex)->position.x * 2.5f + 50));
+            lightPositionYTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Light y", 70, 100, static_cast<uint32>(Scene::get().getLight(currentLightIndex)->position.y * 2.5f + 50));
+            lightPositionZTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Light z", 70, 150, static_cast<uint32>(Scene::get().getLight(currentLightIndex)->position.z * 2.5f + 50));
 
             // Light Color Trackbars
-            lightColorXTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Color x", 70, 250, static_cast<uint32>(Scene::get().getLight(currentLightIndex).color.x * 100.0f));
-            lightColorYTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Color y", 70, 300, static_cast<uint32>(Scene::get().getLight(currentLightIndex).color.y * 100.0f));
-            lightColorZTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Color z", 70, 350, static_cast<uint32>(Scene::get().getLight(currentLightIndex).color.z * 100.0f));
+            lightColorXTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Color x", 70, 250, static_cast<uint32>(Scene::get().getLight(currentLightIndex)->color.x * 100.0f));
+            lightColorYTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Color y", 70, 300, static_cast<uint32>(Scene::get().getLight(currentLightIndex)->color.y * 100.0f));
+            lightColorZTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Color z", 70, 350, static_cast<uint32>(Scene::get().getLight(currentLightIndex)->color.z * 100.0f));
 
             // Point Light Radius
-            if (Scene::get().getLight(currentLightIndex).getLightType() == Light::POINT_LIGHT)
+            if (Scene::get().getLight(currentLightIndex)->getLightType() == Light::POINT_LIGHT)
             {
                 // Sphere Radius Labels
                 CreateWindow("STATIC", "Point Light Radius", WS_VISIBLE | WS_CHILD | SS_LEFT, 115, 400, 140, 30, hwnd, NULL, GetModuleHandle(NULL), NULL);
@@ -471,8 +481,8 @@ LRESULT CALLBACK LightEditWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
                 CreateWindow("STATIC", "10.0", WS_VISIBLE | WS_CHILD | SS_LEFT, 232, 422, 40, 20, hwnd, NULL, GetModuleHandle(NULL), NULL);
                 CreateWindow("STATIC", "Rad", WS_VISIBLE | WS_CHILD | SS_LEFT, 45, 435, 80, 30, hwnd, NULL, GetModuleHandle(NULL), NULL);
 
-                PointLight& pl = static_cast<PointLight&>(Scene::get().getLight(currentLightIndex));
-                pointLightRadiusTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Point Light Radius", 70, 440, static_cast<uint32>(pl.radius * 10.0f));
+                const auto pl = std::static_pointer_cast<const PointLight>(Scene::get().getLight(currentLightIndex));
+                pointLightRadiusTrackbar = CreateTrackbar(hwnd, GetModuleHandle(NULL), "Point Light Radius", 70, 440, static_cast<uint32>(pl->radius * 10.0f));
 
                 // Set Font to all children
                 EnumChildWindows(hwnd, EnumChildProc, lParam);
@@ -506,31 +516,31 @@ LRESULT CALLBACK LightEditWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
             {
                 if (lParam == (LPARAM)lightPositionXTrackbar)
                 {
-                    Scene::get().getLight(currentLightIndex).position.x = (hi - 50) / 2.5f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { light.position.x = (hi - 50) / 2.5f; });
                 }
                 else if (lParam == (LPARAM)lightPositionYTrackbar)
                 {
-                    Scene::get().getLight(currentLightIndex).position.y = (hi - 50) / 2.5f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { light.position.y = (hi - 50) / 2.5f; });
                 }
                 else if (lParam == (LPARAM)lightPositionZTrackbar)
                 {
-                    Scene::get().getLight(currentLightIndex).position.z = (hi - 50) / 2.5f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { light.position.z = (hi - 50) / 2.5f; });
                 }
                 else if (lParam == (LPARAM)lightColorXTrackbar)
                 {
-                    Scene::get().getLight(currentLightIndex).color.x = hi / 100.0f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { light.color.x = hi / 100.0f; });
                 }
                 else if (lParam == (LPARAM)lightColorYTrackbar)
                 {
-                    Scene::get().getLight(currentLightIndex).color.y = hi / 100.0f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { light.color.y = hi / 100.0f; });
                 }
                 else if (lParam == (LPARAM)lightColorZTrackbar)
                 {
-                    Scene::get().getLight(currentLightIndex).color.z = hi / 100.0f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { light.color.z = hi / 100.0f; });
                 }                
                 else if (lParam == (LPARAM)pointLightRadiusTrackbar)
                 {
-                    static_cast<PointLight&>(Scene::get().getLight(currentLightIndex)).radius = hi / 10.0f;
+                    Scene::get().editLight(currentLightIndex, [hi](Light& light) { static_cast<PointLight&>(light).radius = hi / 10.0f; });
                 }
 
                 PostMessage(GetParent(hwnd), WM_HSCROLL, wParam, lParam);
@@ -733,7 +743,7 @@ HWND WINAPI win32::CreateSpheresEditDialog(HWND hwnd, HINSTANCE hInstance, const
 HWND WINAPI win32::CreateLightsEditDialog(HWND hwnd, HINSTANCE hInstance, const uint32 lightIndex)
 {
     currentLightIndex = lightIndex;
-    return CreateEditDialog(hwnd, hInstance, LightEditWndProc, "EditLightWindowClas", "Edit Light", 330, Scene::get().getLight(lightIndex).getLightType() == Light::DIR_LIGHT ? 490 : 580);
+    return CreateEditDialog(hwnd, hInstance, LightEditWndProc, "EditLightWindowClas", "Edit Light", 330, Scene::get().getLight(lightIndex)->getLightType() == Light::DIR_LIGHT ? 490 : 580);
 }
 
 HWND WINAPI win32::CreateReflectionAndRefractionCountDialog(HWND hwnd, HINSTANCE hInstance)
@@ -787,14 +797,14 @@ HWND WINAPI win32::CreateMainWindow(HINSTANCE instance, const sint32 windowWidth
     return handle;
 }
 
-void WINAPI win32::CreateIODialog(HWND hwnd, HINSTANCE instance, const IO_DIALOG_TYPE ioDialogType, io_result_callback callbackOnIOCompletion)
+void WINAPI win32::CreateIODialog(HWND hwnd, HINSTANCE instance, const IO_DIALOG_TYPE ioDialogType, io::io_result_callback callbackOnIOCompletion)
 {
     OPENFILENAME ofn = {};
 
     CHAR szCurrentPath[MAX_PATH + 1];
     CHAR szFileFullPath[MAX_PATH + 1] = "";
     CHAR szFileTitle[MAX_PATH + 1] = "scene.scn";
-    CHAR szCustomFilter[MAX_PATH + 1] = "Scene Files (*.scn)\0*.scn\0";
+    CHAR szCustomFilter[MAX_PATH + 1] = "Scene Files (*.scn)\0*.scn\0Binary Scene Files (*.scnb)\0*.scnb\0";
     GetModuleFileName(NULL, szCurrentPath, MAX_PATH + 1);
 
     ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST | OFN_HIDEREADONLY;
@@ -9,6 +9,7 @@
 
 // Local Headers
 #include "typedefs.h"
+#include "iotypes.h"
 
 // Remote Headers
 #include <Windows.h>
@@ -23,18 +24,12 @@ namespace win32
         OPEN, SAVE_AS
     };
 
-    enum IO_DIALOG_RESULT_TYPE
-    {
-        SUCCESS, FAILURE
-    };
-
-    using io_result_callback = std::function<void(const IO_DIALOG_RESULT_TYPE)>;
-
     const uint32 GUID_OPEN_SCENE = 11;
     const uint32 GUID_SAVE_SCENE = 12;
     const uint32 GUID_QUIT_SCENE = 13;
     const uint32 GUID_REFL_REFR_COUNT_RENDER = 31;
     const uint32 GUID_RESTART_RENDER = 32;
+    const uint32 GUID_COST_HEATMAP_RENDER = 33;
     const uint32 LIGHT_GUID_OFFSET = 100;
     const uint32 SPHERE_GUID_OFFSET = 200;
     const uint32 PLANE_GUID_OFFSET = 300;
@@ -49,5 +44,5 @@ namespace win32
 
     HWND WINAPI CreateMainWindow(HINSTANCE instance, const sint32 windowWidth, const sint32 windowHeight, const std::string& title);
 
-    void WINAPI CreateIODialog(HWND hwnd, HINSTANCE instance, const IO_DIALOG_TYPE ioDialogType, io_result_callback callbackOnIOCompletion);
+    void WINAPI CreateIODialog(HWND hwnd, HINSTANCE instance, const IO_DIALOG_TYPE ioDialogType, io::io_result_callback callbackOnIOCompletion);
 }
\ No newline at end of file